@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "leptjson.h"
+
+/*
+ * leptjson_bench [repetitions] [corpus]
+ *
+ * Every corpus is generated from fixed seeds, so each run measures the same
+ * bytes. After one warm-up round, each repetition times lept_parse(),
+ * lept_stringify() and lept_free() separately over BENCH_ITERATIONS documents,
+ * then lept_tape_parse() into one reused tape as many times.
+ * The output is tab-separated, one line per corpus and phase: min, median and
+ * max time per document over the repetitions, then the median throughput.
+ * MB/s counts the output text for stringify, the input text for the others.
+ */
+
+#define BENCH_ITERATIONS    5
+#define BENCH_REPETITIONS   7
+#define BENCH_MAX_REPS      101
+
+typedef struct {
+    char* s;
+    size_t len, size;
+}bench_buffer;
+
+static void bench_puts(bench_buffer* b, const char* s) {
+    size_t len = strlen(s);
+    if (b->len + len + 1 > b->size) {
+        while (b->len + len + 1 > b->size)
+            b->size = b->size ? b->size * 2 : 4096;
+        b->s = (char*)realloc(b->s, b->size);
+    }
+    memcpy(b->s + b->len, s, len + 1);
+    b->len += len;
+}
+
+static void bench_indent(bench_buffer* b, int depth) {
+    bench_puts(b, "\n");
+    while (depth-- > 0)
+        bench_puts(b, "    ");
+}
+
+/* Pretty-printed records with 4-space indentation, as written by most JSON tools. */
+static void corpus_indented(bench_buffer* b, int records) {
+    char num[32];
+    int i, j;
+    bench_puts(b, "[");
+    for (i = 0; i < records; i++) {
+        bench_puts(b, i ? "," : "");
+        bench_indent(b, 1); bench_puts(b, "{");
+        bench_indent(b, 2); sprintf(num, "\"id\": %d,", i); bench_puts(b, num);
+        bench_indent(b, 2); bench_puts(b, "\"active\": true,");
+        bench_indent(b, 2); bench_puts(b, "\"tags\": [");
+        for (j = 0; j < 4; j++) {
+            bench_indent(b, 3); sprintf(num, "\"t%d\"%s", j, j < 3 ? "," : ""); bench_puts(b, num);
+        }
+        bench_indent(b, 2); bench_puts(b, "],");
+        bench_indent(b, 2); bench_puts(b, "\"pos\": {");
+        bench_indent(b, 3); sprintf(num, "\"x\": %d,", i * 3); bench_puts(b, num);
+        bench_indent(b, 3); sprintf(num, "\"y\": %d", i * 7); bench_puts(b, num);
+        bench_indent(b, 2); bench_puts(b, "}");
+        bench_indent(b, 1); bench_puts(b, "}");
+    }
+    bench_puts(b, "\n]\n");
+}
+
+/* The same records without whitespace. */
+static void corpus_minified(bench_buffer* b, int records) {
+    lept_value v;
+    char* json;
+    corpus_indented(b, records);
+    lept_init(&v);
+    if (lept_parse(&v, b->s) != LEPT_PARSE_OK) {
+        fprintf(stderr, "minified: parse error\n");
+        exit(1);
+    }
+    json = lept_stringify(&v, NULL);
+    b->len = 0;
+    bench_puts(b, json);
+    free(json);
+    lept_free(&v);
+}
+
+/* Mostly clean strings of 8-200 bytes; about one in eight carries an escape. */
+static void corpus_strings(bench_buffer* b, int count) {
+    char s[256];
+    int i, j, len;
+    unsigned seed = 1;
+    bench_puts(b, "[");
+    for (i = 0; i < count; i++) {
+        seed = seed * 1103515245u + 12345u;
+        len = 8 + (int)((seed >> 16) % 193);
+        for (j = 0; j < len; j++)
+            s[j] = (char)('a' + (i + j) % 26);
+        if (i % 8 == 0)
+            s[len / 2] = '\\', s[len / 2 + 1] = 'n';
+        s[len] = '\0';
+        bench_puts(b, i ? ",\"" : "\"");
+        bench_puts(b, s);
+        bench_puts(b, "\"");
+    }
+    bench_puts(b, "]");
+}
+
+/* Telemetry-style arrays: integers, short decimals and full-precision doubles. */
+static void corpus_numbers(bench_buffer* b, int count) {
+    char num[32];
+    int i;
+    unsigned seed = 7;
+    bench_puts(b, "[");
+    for (i = 0; i < count; i++) {
+        seed = seed * 1103515245u + 12345u;
+        switch (i % 3) {
+            case 0: sprintf(num, "%u", seed >> 12); break;
+            case 1: sprintf(num, "%.3f", (seed >> 8) / 1000.0 - 5000.0); break;
+            default: sprintf(num, "%.17g", (seed >> 4) * 1.2345678901234e-7); break;
+        }
+        bench_puts(b, i ? "," : "");
+        bench_puts(b, num);
+    }
+    bench_puts(b, "]");
+}
+
+/* Chains of alternating objects and arrays, each depth levels deep. */
+static void corpus_nested(bench_buffer* b, int chains, int depth) {
+    int i, j;
+    bench_puts(b, "[");
+    for (i = 0; i < chains; i++) {
+        bench_puts(b, i ? "," : "");
+        for (j = 0; j < depth; j++)
+            bench_puts(b, j % 2 ? "[1," : "{\"n\":");
+        bench_puts(b, "null");
+        for (j = depth - 1; j >= 0; j--)
+            bench_puts(b, j % 2 ? "]" : "}");
+    }
+    bench_puts(b, "]");
+}
+
+/* One object with many distinct keys, like a large map keyed by id. */
+static void corpus_wide(bench_buffer* b, int keys) {
+    char member[48];
+    int i;
+    unsigned seed = 3;
+    bench_puts(b, "{");
+    for (i = 0; i < keys; i++) {
+        seed = seed * 1103515245u + 12345u;
+        sprintf(member, "%s\"user_%08x\":%u", i ? "," : "", seed, seed >> 20);
+        bench_puts(b, member);
+    }
+    bench_puts(b, "}");
+}
+
+enum { BENCH_PARSE, BENCH_STRINGIFY, BENCH_FREE, BENCH_TAPE, BENCH_PHASES };
+
+static const char* bench_phase_names[BENCH_PHASES] = { "parse", "stringify", "free", "tape" };
+
+static int bench_compare(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Parses, stringifies and frees BENCH_ITERATIONS documents, timing each phase in seconds. */
+static void bench_round(const char* name, const bench_buffer* b, lept_tape* t, double seconds[], size_t* out_len) {
+    lept_value v[BENCH_ITERATIONS];
+    clock_t start;
+    int i;
+    start = clock();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        lept_init(&v[i]);
+        if (lept_parse(&v[i], b->s) != LEPT_PARSE_OK) {
+            fprintf(stderr, "%s: parse error\n", name);
+            exit(1);
+        }
+    }
+    seconds[BENCH_PARSE] = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+        free(lept_stringify(&v[i], out_len));
+    seconds[BENCH_STRINGIFY] = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+        lept_free(&v[i]);
+    seconds[BENCH_FREE] = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (i = 0; i < BENCH_ITERATIONS; i++)
+        if (lept_tape_parse(t, b->s, b->len) != LEPT_PARSE_OK) {
+            fprintf(stderr, "%s: tape parse error\n", name);
+            exit(1);
+        }
+    seconds[BENCH_TAPE] = (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench_corpus(const char* name, const bench_buffer* b, int reps) {
+    double samples[BENCH_PHASES][BENCH_MAX_REPS], seconds[BENCH_PHASES];
+    double median, bytes;
+    size_t out_len = 0;
+    lept_tape* t = lept_tape_new(NULL);
+    int r, p;
+    bench_round(name, b, t, seconds, &out_len); /* warm-up: caches, allocator, CPU dispatch */
+    for (r = 0; r < reps; r++) {
+        bench_round(name, b, t, seconds, &out_len);
+        for (p = 0; p < BENCH_PHASES; p++)
+            samples[p][r] = seconds[p] / BENCH_ITERATIONS;
+    }
+    for (p = 0; p < BENCH_PHASES; p++) {
+        qsort(samples[p], (size_t)reps, sizeof(double), bench_compare);
+        median = samples[p][reps / 2];
+        bytes = (double)(p == BENCH_STRINGIFY ? out_len : b->len);
+        printf("%s\t%s\t%lu\t%d\t%.3f\t%.3f\t%.3f\t%.1f\t%.1f\n", name, bench_phase_names[p],
+            (unsigned long)bytes, reps, samples[p][0] * 1e3, median * 1e3, samples[p][reps - 1] * 1e3,
+            median > 0 ? bytes / (1024.0 * 1024.0) / median : 0.0, median > 0 ? 1.0 / median : 0.0);
+    }
+    lept_tape_free(t);
+}
+
+#define BENCH_CORPUS(name, generate)\
+    do {\
+        if (only == NULL || strcmp(only, name) == 0) {\
+            b.len = 0;\
+            generate;\
+            bench_corpus(name, &b, reps);\
+        }\
+    } while(0)
+
+int main(int argc, char* argv[]) {
+    bench_buffer b = { NULL, 0, 0 };
+    const char* only = argc > 2 ? argv[2] : NULL;
+    int reps = argc > 1 ? atoi(argv[1]) : BENCH_REPETITIONS;
+    if (reps < 1 || reps > BENCH_MAX_REPS) {
+        fprintf(stderr, "usage: %s [repetitions 1-%d] [corpus]\n", argv[0], BENCH_MAX_REPS);
+        return 1;
+    }
+    printf("corpus\tphase\tbytes\treps\tmin_ms\tmedian_ms\tmax_ms\tMB/s\tdocs/s\n");
+    BENCH_CORPUS("numbers", corpus_numbers(&b, 300000));
+    BENCH_CORPUS("strings", corpus_strings(&b, 50000));
+    BENCH_CORPUS("indented", corpus_indented(&b, 20000));
+    BENCH_CORPUS("minified", corpus_minified(&b, 20000));
+    BENCH_CORPUS("nested", corpus_nested(&b, 2000, 500));
+    BENCH_CORPUS("wide", corpus_wide(&b, 100000));
+    free(b.s);
+    return 0;
+}
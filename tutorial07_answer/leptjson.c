@@ -4,11 +4,48 @@
 #endif
 #include "leptjson.h"
 #include <assert.h>  /* assert() */
-#include <errno.h>   /* errno, ERANGE */
 #include <math.h>    /* HUGE_VAL */
 #include <stdio.h>   /* sprintf() */
-#include <stdlib.h>  /* NULL, malloc(), realloc(), free(), strtod() */
-#include <string.h>  /* memcpy() */
+#include <stdlib.h>  /* NULL, malloc(), realloc(), free() */
+#include <string.h>  /* memcpy(), strlen() */
+#include <errno.h>   /* EINTR */
+#if LEPT_STATS
+#include <time.h>    /* clock() */
+#endif
+#ifdef _WIN32
+#include <io.h>      /* _write() */
+#else
+#include <unistd.h>  /* write() */
+#endif
+
+/* LEPT_PARSE_SIMD=0 forces the portable scalar loops */
+#ifndef LEPT_PARSE_SIMD
+#define LEPT_PARSE_SIMD 1
+#endif
+
+#if LEPT_PARSE_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define LEPT_SIMD_SSE2 1
+#include <emmintrin.h> /* SSE2 */
+#endif
+#if defined(LEPT_SIMD_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEPT_SIMD_AVX2 1
+#include <immintrin.h> /* AVX2, selected at runtime */
+#endif
+
+#if defined(__GNUC__)
+#define LEPT_CTZ(x) __builtin_ctz(x)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+static unsigned lept_ctz(unsigned x) { unsigned long i; _BitScanForward(&i, x); return (unsigned)i; }
+#define LEPT_CTZ(x) lept_ctz(x)
+#endif
+
+/* Aligned SIMD loads may read past the end of input, but never across a page boundary */
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define LEPT_NO_SANITIZE __attribute__((no_sanitize_address))
+#else
+#define LEPT_NO_SANITIZE
+#endif
 
 #ifndef LEPT_PARSE_STACK_INIT_SIZE
 #define LEPT_PARSE_STACK_INIT_SIZE 256
@@ -18,18 +55,225 @@
 #define LEPT_PARSE_STRINGIFY_INIT_SIZE 256
 #endif
 
+/* nesting limit for arrays and objects; deeper input fails with LEPT_PARSE_TOO_DEEP */
+#ifndef LEPT_PARSE_MAX_DEPTH
+#define LEPT_PARSE_MAX_DEPTH 1024
+#endif
+
+/* buffer size of lept_stringify_file() and lept_stringify_fd() */
+#ifndef LEPT_STRINGIFY_CHUNK_SIZE
+#define LEPT_STRINGIFY_CHUNK_SIZE 65536
+#endif
+
+#ifndef LEPT_PARSER_TRIM_INTERVAL
+#define LEPT_PARSER_TRIM_INTERVAL 64
+#endif
+
+/* objects with at least this many members get a hash index on their first lookup by key */
+#ifndef LEPT_OBJECT_INDEX_THRESHOLD
+#define LEPT_OBJECT_INDEX_THRESHOLD 32
+#endif
+
+#ifndef LEPT_ARENA_BLOCK_SIZE
+#define LEPT_ARENA_BLOCK_SIZE 8192
+#endif
+
 #define EXPECT(c, ch)       do { assert(*c->json == (ch)); c->json++; } while(0)
+#define CHAR_AT(p, end)     ((p) < (end) ? *(p) : '\0')   /* '\0' doubles as the end of input */
+#define PEEK(c)             CHAR_AT((c)->json, (c)->end)
 #define ISDIGIT(ch)         ((ch) >= '0' && (ch) <= '9')
 #define ISDIGIT1TO9(ch)     ((ch) >= '1' && (ch) <= '9')
+#define ISWHITESPACE(ch)    ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
 #define PUTC(c, ch)         do { *(char*)lept_context_push(c, sizeof(char)) = (ch); } while(0)
 #define PUTS(c, s, len)     memcpy(lept_context_push(c, len), s, len)
+#define LEPT_MALLOC(a, size)        ((a)->malloc_fn((a)->user, (size)))
+#define LEPT_REALLOC(a, ptr, size)  ((a)->realloc_fn((a)->user, (ptr), (size)))
+#define LEPT_FREE(a, ptr)           ((a)->free_fn((a)->user, (ptr)))
+
+static void* lept_default_malloc(void* user, size_t size) { (void)user; return malloc(size); }
+static void* lept_default_realloc(void* user, void* ptr, size_t size) { (void)user; return realloc(ptr, size); }
+static void lept_default_free(void* user, void* ptr) { (void)user; free(ptr); }
+
+static const lept_allocator lept_default_allocator = {
+    lept_default_malloc, lept_default_realloc, lept_default_free, NULL
+};
+
+#define LEPT_ALLOCATOR(a)   ((a) != NULL ? (a) : &lept_default_allocator)
 
 typedef struct {
     const char* json;
+    const char* end;            /* one past the last input byte; nothing at or after it is parsed */
     char* stack;
-    size_t size, top;
+    size_t size, top, peak;
+    const lept_allocator* alloc;
+    lept_arena_block** arena;   /* non-NULL: nodes, keys and strings go to this arena */
+    size_t max_depth;           /* deepest array/object nesting accepted */
+    int insitu;                 /* strings and keys are decoded in place and borrowed from json */
+    int validate;               /* strings, keys and numbers are only checked, and reported empty or 0 */
+    lept_intern_pool* intern;   /* non-NULL: keys are shared from this pool */
+    lept_write_fn write_fn;     /* stringify: receives each full chunk; NULL keeps the whole text */
+    void* write_user;
+    size_t chunk;               /* stringify: flush once this many bytes are buffered */
+    int status;                 /* stringify: first non-zero result of write_fn */
+#if LEPT_STATS
+    lept_stats* stats;          /* non-NULL: counters to add to */
+#endif
 }lept_context;
 
+#if LEPT_STATS
+#define LEPT_STAT(c, expr) do { if ((c)->stats) (c)->stats->expr; } while(0)
+#define LEPT_STAT_MAX(c, field, n)\
+    do { if ((c)->stats && (c)->stats->field < (n)) (c)->stats->field = (n); } while(0)
+#else
+#define LEPT_STAT(c, expr) do { } while(0)
+#define LEPT_STAT_MAX(c, field, n) do { } while(0)
+#endif
+
+/* lept_value.flags: the string, or an object's keys, point into an in-situ buffer and are not freed */
+#define LEPT_BORROWED 1
+/* lept_value.flags: the string is stored in u itself, its length in the bits above LEPT_LAZY */
+#define LEPT_INLINE 2
+/* lept_value.flags: not decoded yet; u.s holds the value's text (see lept_parse_lazy()) */
+#define LEPT_LAZY 4
+#define LEPT_INLINE_SHIFT 3
+#define LEPT_INLINE_MAX (sizeof(((lept_value*)0)->u) - 1)
+
+#define LEPT_STRING_PTR(v) ((v)->flags & LEPT_INLINE ? (char*)&(v)->u : (v)->u.s.s)
+#define LEPT_STRING_LEN(v) ((v)->flags & LEPT_INLINE ? (size_t)((v)->flags >> LEPT_INLINE_SHIFT) : (size_t)(v)->u.s.len)
+
+/* Tags in lept_member.klen: the key is stored in the bytes of k itself, or k is owned by an intern pool. */
+#define LEPT_KEY_INLINE     ((lept_length)1 << (sizeof(lept_length) * 8 - 1))
+#define LEPT_KEY_SHARED     ((lept_length)1 << (sizeof(lept_length) * 8 - 2))
+#define LEPT_KEY_INLINE_MAX (sizeof(char*) - 1)
+
+#define LEPT_KEY_PTR(m) ((m)->klen & LEPT_KEY_INLINE ? (char*)&(m)->k : (m)->k)
+#define LEPT_KEY_LEN(m) ((size_t)((m)->klen & ~(LEPT_KEY_INLINE | LEPT_KEY_SHARED)))
+
+struct lept_arena_block {
+    lept_arena_block* next;
+    size_t size, used;
+};
+
+/* Every allocation is rounded up to this alignment, so nodes are always properly aligned. */
+typedef union { double d; void* p; size_t s; } lept_arena_align;
+
+#define LEPT_ARENA_ALIGN(n) (((n) + sizeof(lept_arena_align) - 1) & ~(sizeof(lept_arena_align) - 1))
+#define LEPT_ARENA_HEADER   LEPT_ARENA_ALIGN(sizeof(lept_arena_block))
+
+static void* lept_arena_alloc(lept_arena_block** head, const lept_allocator* a, size_t size) {
+    lept_arena_block* b = *head;
+    size = LEPT_ARENA_ALIGN(size);
+    if (b == NULL || b->used + size > b->size) {
+        size_t bsize = size > LEPT_ARENA_BLOCK_SIZE / 2 ? size : LEPT_ARENA_BLOCK_SIZE;
+        lept_arena_block* nb = (lept_arena_block*)LEPT_MALLOC(a, LEPT_ARENA_HEADER + bsize);
+        nb->size = bsize;
+        nb->used = 0;
+        if (b != NULL && bsize != LEPT_ARENA_BLOCK_SIZE) {
+            /* oversized: link behind the current block so it keeps serving small requests */
+            nb->next = b->next;
+            b->next = nb;
+        }
+        else {
+            nb->next = b;
+            *head = nb;
+        }
+        b = nb;
+    }
+    b->used += size;
+    return (char*)b + LEPT_ARENA_HEADER + b->used - size;
+}
+
+/* As lept_arena_alloc(), from the arena that block b belongs to. New blocks are linked behind b,
+ * so the arena's head, wherever its owner keeps it, stays valid. */
+static void* lept_arena_alloc_behind(lept_arena_block* b, const lept_allocator* a, size_t size) {
+    lept_arena_block* head = b;
+    void* p = lept_arena_alloc(&head, a, size);
+    if (head != b) {
+        head->next = b->next;
+        b->next = head;
+    }
+    return p;
+}
+
+static void* lept_context_alloc(lept_context* c, size_t size) {
+    LEPT_STAT(c, mallocs++);
+    LEPT_STAT(c, malloc_bytes += size);
+    return c->arena ? lept_arena_alloc(c->arena, c->alloc, size) : LEPT_MALLOC(c->alloc, size);
+}
+
+static char* lept_context_strdup(lept_context* c, const char* s, size_t len) {
+    char* p = (char*)lept_context_alloc(c, len + 1);
+    if (len)
+        memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+/* Stores a short string in the node itself, saving an allocation; returns 0 if it does not fit. */
+static int lept_string_inline(lept_value* v, const char* s, size_t len) {
+    char* p = (char*)&v->u;
+    if (len > LEPT_INLINE_MAX)
+        return 0;
+    if (len)
+        memcpy(p, s, len);
+    p[len] = '\0';
+    v->flags = (unsigned)(LEPT_INLINE | len << LEPT_INLINE_SHIFT);
+    return 1;
+}
+
+/* The same for a key, in the pointer slot k of a member or parse frame. */
+static int lept_key_inline(char* k, lept_length* klen, const char* s, size_t len) {
+    if (len > LEPT_KEY_INLINE_MAX)
+        return 0;
+    if (len)
+        memcpy(k, s, len);
+    k[len] = '\0';
+    *klen = (lept_length)len | LEPT_KEY_INLINE;
+    return 1;
+}
+
+/*
+ * Large objects carry this header just before their member array, so the
+ * key index can be attached later without growing every lept_value.
+ */
+typedef struct {
+    size_t mask;        /* capacity - 1, a power of two minus one */
+    size_t slots[1];    /* member index + 1, 0 for an empty slot */
+}lept_object_index;
+
+typedef struct {
+    lept_object_index* index;   /* NULL until the first lookup */
+    lept_allocator alloc;       /* a copy: the caller's struct may be gone by the first lookup */
+    lept_arena_block* arena;    /* a block of that arena (never its head pointer, which may move) */
+}lept_object_header;
+
+#define LEPT_OBJECT_HEADER(v) ((lept_object_header*)(v)->u.o.m - 1)
+
+static lept_member* lept_context_alloc_members(lept_context* c, size_t size) {
+    lept_object_header* h;
+    if (size < LEPT_OBJECT_INDEX_THRESHOLD)
+        return (lept_member*)lept_context_alloc(c, size * sizeof(lept_member));
+    h = (lept_object_header*)lept_context_alloc(c, sizeof(lept_object_header) + size * sizeof(lept_member));
+    h->index = NULL;
+    h->alloc = *c->alloc;
+    h->arena = c->arena ? *c->arena : NULL;
+    return (lept_member*)(h + 1);
+}
+
+/* Releases a key of a partially parsed object. */
+static void lept_context_free_key(lept_context* c, char* k, lept_length klen) {
+    if (!c->arena && !c->insitu && !(klen & (LEPT_KEY_INLINE | LEPT_KEY_SHARED)))
+        LEPT_FREE(c->alloc, k);
+}
+
+/* Releases a partially parsed value; arena memory is reclaimed with the whole document. */
+static void lept_context_free(lept_context* c, lept_value* v) {
+    if (c->arena)
+        v->type = LEPT_NULL;
+    else
+        lept_free_ex(v, c->alloc);
+}
+
 static void* lept_context_push(lept_context* c, size_t size) {
     void* ret;
     assert(size > 0);
@@ -38,10 +282,13 @@ static void* lept_context_push(lept_context* c, size_t size) {
             c->size = LEPT_PARSE_STACK_INIT_SIZE;
         while (c->top + size >= c->size)
             c->size += c->size >> 1;  /* c->size * 1.5 */
-        c->stack = (char*)realloc(c->stack, c->size);
+        c->stack = (char*)LEPT_REALLOC(c->alloc, c->stack, c->size);
+        LEPT_STAT(c, stack_reallocs++);
     }
     ret = c->stack + c->top;
     c->top += size;
+    if (c->top > c->peak)
+        c->peak = c->top;
     return ret;
 }
 
@@ -50,300 +297,3387 @@ static void* lept_context_pop(lept_context* c, size_t size) {
     return c->stack + (c->top -= size);
 }
 
+/* A string byte that lept_parse_string_raw() cannot copy verbatim. */
+#define ISSTRINGSTOP(ch)    ((ch) == '\"' || (ch) == '\\' || (unsigned char)(ch) < 0x20)
+
+#ifndef LEPT_SIMD_SSE2
+static const char* lept_skip_whitespace_scalar(const char* p, const char* end) {
+    while (p < end && ISWHITESPACE(*p))
+        p++;
+    return p;
+}
+
+static const char* lept_scan_string_scalar(const char* p, const char* end) {
+    while (p < end && !ISSTRINGSTOP(*p))
+        p++;
+    return p;
+}
+#else
+static LEPT_NO_SANITIZE const char* lept_skip_whitespace_sse2(const char* p, const char* end) {
+    const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    unsigned off = (unsigned)((size_t)p & 15);
+    const char* b = p - off;
+    unsigned mask = 0xFFFFu << off; /* ignore bytes before p in the first block */
+    if (p >= end)
+        return end;
+    for (;;) {
+        __m128i x = _mm_load_si128((const __m128i*)b);
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, sp), _mm_cmpeq_epi8(x, tab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(x, lf), _mm_cmpeq_epi8(x, cr)));
+        mask &= ~(unsigned)_mm_movemask_epi8(ws);
+        if (mask)
+            return b + LEPT_CTZ(mask) < end ? b + LEPT_CTZ(mask) : end;
+        if ((b += 16) >= end)
+            return end;
+        mask = 0xFFFFu;
+    }
+}
+
+static LEPT_NO_SANITIZE const char* lept_scan_string_sse2(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('\"'), bslash = _mm_set1_epi8('\\'), ctrl = _mm_set1_epi8(0x1F);
+    unsigned off = (unsigned)((size_t)p & 15);
+    const char* b = p - off;
+    unsigned mask = 0xFFFFu << off;
+    if (p >= end)
+        return end;
+    for (;;) {
+        __m128i x = _mm_load_si128((const __m128i*)b);
+        __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, bslash)),
+                                    _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl)); /* x <= 0x1F */
+        mask &= (unsigned)_mm_movemask_epi8(stop);
+        if (mask)
+            return b + LEPT_CTZ(mask) < end ? b + LEPT_CTZ(mask) : end;
+        if ((b += 16) >= end)
+            return end;
+        mask = 0xFFFFu;
+    }
+}
+#endif
+
+#ifdef LEPT_SIMD_AVX2
+__attribute__((target("avx2")))
+static LEPT_NO_SANITIZE const char* lept_skip_whitespace_avx2(const char* p, const char* end) {
+    const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+    unsigned off = (unsigned)((size_t)p & 31);
+    const char* b = p - off;
+    unsigned mask = 0xFFFFFFFFu << off;
+    if (p >= end)
+        return end;
+    for (;;) {
+        __m256i x = _mm256_load_si256((const __m256i*)b);
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, sp), _mm256_cmpeq_epi8(x, tab)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(x, lf), _mm256_cmpeq_epi8(x, cr)));
+        mask &= ~(unsigned)_mm256_movemask_epi8(ws);
+        if (mask)
+            return b + LEPT_CTZ(mask) < end ? b + LEPT_CTZ(mask) : end;
+        if ((b += 32) >= end)
+            return end;
+        mask = 0xFFFFFFFFu;
+    }
+}
+
+__attribute__((target("avx2")))
+static LEPT_NO_SANITIZE const char* lept_scan_string_avx2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('\"'), bslash = _mm256_set1_epi8('\\'), ctrl = _mm256_set1_epi8(0x1F);
+    unsigned off = (unsigned)((size_t)p & 31);
+    const char* b = p - off;
+    unsigned mask = 0xFFFFFFFFu << off;
+    if (p >= end)
+        return end;
+    for (;;) {
+        __m256i x = _mm256_load_si256((const __m256i*)b);
+        __m256i stop = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, quote), _mm256_cmpeq_epi8(x, bslash)),
+                                       _mm256_cmpeq_epi8(_mm256_max_epu8(x, ctrl), ctrl));
+        mask &= (unsigned)_mm256_movemask_epi8(stop);
+        if (mask)
+            return b + LEPT_CTZ(mask) < end ? b + LEPT_CTZ(mask) : end;
+        if ((b += 32) >= end)
+            return end;
+        mask = 0xFFFFFFFFu;
+    }
+}
+
+static const char* lept_skip_whitespace_dispatch(const char* p, const char* end);
+static const char* lept_scan_string_dispatch(const char* p, const char* end);
+static const char* (*lept_skip_whitespace_run)(const char* p, const char* end) = lept_skip_whitespace_dispatch;
+static const char* (*lept_scan_string_run)(const char* p, const char* end) = lept_scan_string_dispatch;
+
+/* First call picks the widest implementations the CPU supports. */
+static void lept_simd_select(void) {
+    int avx2;
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2");
+    lept_skip_whitespace_run = avx2 ? lept_skip_whitespace_avx2 : lept_skip_whitespace_sse2;
+    lept_scan_string_run = avx2 ? lept_scan_string_avx2 : lept_scan_string_sse2;
+}
+
+static const char* lept_skip_whitespace_dispatch(const char* p, const char* end) {
+    lept_simd_select();
+    return lept_skip_whitespace_run(p, end);
+}
+
+static const char* lept_scan_string_dispatch(const char* p, const char* end) {
+    lept_simd_select();
+    return lept_scan_string_run(p, end);
+}
+#define lept_skip_whitespace(p, end) lept_skip_whitespace_run(p, end)
+#define lept_scan_string(p, end)     lept_scan_string_run(p, end)
+#elif defined(LEPT_SIMD_SSE2)
+#define lept_skip_whitespace(p, end) lept_skip_whitespace_sse2(p, end)
+#define lept_scan_string(p, end)     lept_scan_string_sse2(p, end)
+#else
+#define lept_skip_whitespace(p, end) lept_skip_whitespace_scalar(p, end)
+#define lept_scan_string(p, end)     lept_scan_string_scalar(p, end)
+#endif
+
 static void lept_parse_whitespace(lept_context* c) {
-    const char *p = c->json;
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+    const char *p = c->json, *end = c->end;
+    if (ISWHITESPACE(CHAR_AT(p, end))) {
         p++;
-    c->json = p;
+        if (ISWHITESPACE(CHAR_AT(p, end))) /* a run such as indentation: worth a vector scan */
+            p = lept_skip_whitespace(p + 1, end);
+        c->json = p;
+    }
 }
 
 static int lept_parse_literal(lept_context* c, lept_value* v, const char* literal, lept_type type) {
     size_t i;
     EXPECT(c, literal[0]);
     for (i = 0; literal[i + 1]; i++)
-        if (c->json[i] != literal[i + 1])
+        if (CHAR_AT(c->json + i, c->end) != literal[i + 1])
             return LEPT_PARSE_INVALID_VALUE;
     c->json += i;
     v->type = type;
     return LEPT_PARSE_OK;
 }
 
+/* 64-bit integers for the decimal-to-double conversion (C89 has none of its own) */
+#if defined(_MSC_VER)
+typedef unsigned __int64 lept_u64;
+#define LEPT_EXTENSION
+#define LEPT_U64(x) x##ui64
+#else
+__extension__ typedef unsigned long long lept_u64;
+#define LEPT_EXTENSION __extension__
+#define LEPT_U64(x) (__extension__ x##ULL)
+#endif
+
+static int lept_clz64(lept_u64 x) {
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while (!(x & (LEPT_U64(1) << 63))) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/* 128-bit product of two 64-bit integers */
+static lept_u64 lept_mul64(lept_u64 a, lept_u64 b, lept_u64* lo) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ unsigned __int128 r = (unsigned __int128)a * b;
+    *lo = (lept_u64)r;
+    return (lept_u64)(r >> 64);
+#else
+    lept_u64 a0 = a & 0xFFFFFFFFu, a1 = a >> 32, b0 = b & 0xFFFFFFFFu, b1 = b >> 32;
+    lept_u64 p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    lept_u64 mid = (p00 >> 32) + (p01 & 0xFFFFFFFFu) + (p10 & 0xFFFFFFFFu);
+    *lo = (mid << 32) | (p00 & 0xFFFFFFFFu);
+    return p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+}
+
+static double lept_double_from_bits(lept_u64 bits) {
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+#define LEPT_POW10_MIN (-342)
+#define LEPT_POW10_MAX 308
+
+/* 128-bit normalized mantissas of 10^LEPT_POW10_MIN .. 10^LEPT_POW10_MAX, rounded down: { high, low } */
+LEPT_EXTENSION static const lept_u64 lept_pow10_128[LEPT_POW10_MAX - LEPT_POW10_MIN + 1][2] = {
+    { 0xEEF453D6923BD65AULL, 0x113FAA2906A13B3FULL }, { 0x9558B4661B6565F8ULL, 0x4AC7CA59A424C507ULL },
+    { 0xBAAEE17FA23EBF76ULL, 0x5D79BCF00D2DF649ULL }, { 0xE95A99DF8ACE6F53ULL, 0xF4D82C2C107973DCULL },
+    { 0x91D8A02BB6C10594ULL, 0x79071B9B8A4BE869ULL }, { 0xB64EC836A47146F9ULL, 0x9748E2826CDEE284ULL },
+    { 0xE3E27A444D8D98B7ULL, 0xFD1B1B2308169B25ULL }, { 0x8E6D8C6AB0787F72ULL, 0xFE30F0F5E50E20F7ULL },
+    { 0xB208EF855C969F4FULL, 0xBDBD2D335E51A935ULL }, { 0xDE8B2B66B3BC4723ULL, 0xAD2C788035E61382ULL },
+    { 0x8B16FB203055AC76ULL, 0x4C3BCB5021AFCC31ULL }, { 0xADDCB9E83C6B1793ULL, 0xDF4ABE242A1BBF3DULL },
+    { 0xD953E8624B85DD78ULL, 0xD71D6DAD34A2AF0DULL }, { 0x87D4713D6F33AA6BULL, 0x8672648C40E5AD68ULL },
+    { 0xA9C98D8CCB009506ULL, 0x680EFDAF511F18C2ULL }, { 0xD43BF0EFFDC0BA48ULL, 0x0212BD1B2566DEF2ULL },
+    { 0x84A57695FE98746DULL, 0x014BB630F7604B57ULL }, { 0xA5CED43B7E3E9188ULL, 0x419EA3BD35385E2DULL },
+    { 0xCF42894A5DCE35EAULL, 0x52064CAC828675B9ULL }, { 0x818995CE7AA0E1B2ULL, 0x7343EFEBD1940993ULL },
+    { 0xA1EBFB4219491A1FULL, 0x1014EBE6C5F90BF8ULL }, { 0xCA66FA129F9B60A6ULL, 0xD41A26E077774EF6ULL },
+    { 0xFD00B897478238D0ULL, 0x8920B098955522B4ULL }, { 0x9E20735E8CB16382ULL, 0x55B46E5F5D5535B0ULL },
+    { 0xC5A890362FDDBC62ULL, 0xEB2189F734AA831DULL }, { 0xF712B443BBD52B7BULL, 0xA5E9EC7501D523E4ULL },
+    { 0x9A6BB0AA55653B2DULL, 0x47B233C92125366EULL }, { 0xC1069CD4EABE89F8ULL, 0x999EC0BB696E840AULL },
+    { 0xF148440A256E2C76ULL, 0xC00670EA43CA250DULL }, { 0x96CD2A865764DBCAULL, 0x380406926A5E5728ULL },
+    { 0xBC807527ED3E12BCULL, 0xC605083704F5ECF2ULL }, { 0xEBA09271E88D976BULL, 0xF7864A44C633682EULL },
+    { 0x93445B8731587EA3ULL, 0x7AB3EE6AFBE0211DULL }, { 0xB8157268FDAE9E4CULL, 0x5960EA05BAD82964ULL },
+    { 0xE61ACF033D1A45DFULL, 0x6FB92487298E33BDULL }, { 0x8FD0C16206306BABULL, 0xA5D3B6D479F8E056ULL },
+    { 0xB3C4F1BA87BC8696ULL, 0x8F48A4899877186CULL }, { 0xE0B62E2929ABA83CULL, 0x331ACDABFE94DE87ULL },
+    { 0x8C71DCD9BA0B4925ULL, 0x9FF0C08B7F1D0B14ULL }, { 0xAF8E5410288E1B6FULL, 0x07ECF0AE5EE44DD9ULL },
+    { 0xDB71E91432B1A24AULL, 0xC9E82CD9F69D6150ULL }, { 0x892731AC9FAF056EULL, 0xBE311C083A225CD2ULL },
+    { 0xAB70FE17C79AC6CAULL, 0x6DBD630A48AAF406ULL }, { 0xD64D3D9DB981787DULL, 0x092CBBCCDAD5B108ULL },
+    { 0x85F0468293F0EB4EULL, 0x25BBF56008C58EA5ULL }, { 0xA76C582338ED2621ULL, 0xAF2AF2B80AF6F24EULL },
+    { 0xD1476E2C07286FAAULL, 0x1AF5AF660DB4AEE1ULL }, { 0x82CCA4DB847945CAULL, 0x50D98D9FC890ED4DULL },
+    { 0xA37FCE126597973CULL, 0xE50FF107BAB528A0ULL }, { 0xCC5FC196FEFD7D0CULL, 0x1E53ED49A96272C8ULL },
+    { 0xFF77B1FCBEBCDC4FULL, 0x25E8E89C13BB0F7AULL }, { 0x9FAACF3DF73609B1ULL, 0x77B191618C54E9ACULL },
+    { 0xC795830D75038C1DULL, 0xD59DF5B9EF6A2417ULL }, { 0xF97AE3D0D2446F25ULL, 0x4B0573286B44AD1DULL },
+    { 0x9BECCE62836AC577ULL, 0x4EE367F9430AEC32ULL }, { 0xC2E801FB244576D5ULL, 0x229C41F793CDA73FULL },
+    { 0xF3A20279ED56D48AULL, 0x6B43527578C1110FULL }, { 0x9845418C345644D6ULL, 0x830A13896B78AAA9ULL },
+    { 0xBE5691EF416BD60CULL, 0x23CC986BC656D553ULL }, { 0xEDEC366B11C6CB8FULL, 0x2CBFBE86B7EC8AA8ULL },
+    { 0x94B3A202EB1C3F39ULL, 0x7BF7D71432F3D6A9ULL }, { 0xB9E08A83A5E34F07ULL, 0xDAF5CCD93FB0CC53ULL },
+    { 0xE858AD248F5C22C9ULL, 0xD1B3400F8F9CFF68ULL }, { 0x91376C36D99995BEULL, 0x23100809B9C21FA1ULL },
+    { 0xB58547448FFFFB2DULL, 0xABD40A0C2832A78AULL }, { 0xE2E69915B3FFF9F9ULL, 0x16C90C8F323F516CULL },
+    { 0x8DD01FAD907FFC3BULL, 0xAE3DA7D97F6792E3ULL }, { 0xB1442798F49FFB4AULL, 0x99CD11CFDF41779CULL },
+    { 0xDD95317F31C7FA1DULL, 0x40405643D711D583ULL }, { 0x8A7D3EEF7F1CFC52ULL, 0x482835EA666B2572ULL },
+    { 0xAD1C8EAB5EE43B66ULL, 0xDA3243650005EECFULL }, { 0xD863B256369D4A40ULL, 0x90BED43E40076A82ULL },
+    { 0x873E4F75E2224E68ULL, 0x5A7744A6E804A291ULL }, { 0xA90DE3535AAAE202ULL, 0x711515D0A205CB36ULL },
+    { 0xD3515C2831559A83ULL, 0x0D5A5B44CA873E03ULL }, { 0x8412D9991ED58091ULL, 0xE858790AFE9486C2ULL },
+    { 0xA5178FFF668AE0B6ULL, 0x626E974DBE39A872ULL }, { 0xCE5D73FF402D98E3ULL, 0xFB0A3D212DC8128FULL },
+    { 0x80FA687F881C7F8EULL, 0x7CE66634BC9D0B99ULL }, { 0xA139029F6A239F72ULL, 0x1C1FFFC1EBC44E80ULL },
+    { 0xC987434744AC874EULL, 0xA327FFB266B56220ULL }, { 0xFBE9141915D7A922ULL, 0x4BF1FF9F0062BAA8ULL },
+    { 0x9D71AC8FADA6C9B5ULL, 0x6F773FC3603DB4A9ULL }, { 0xC4CE17B399107C22ULL, 0xCB550FB4384D21D3ULL },
+    { 0xF6019DA07F549B2BULL, 0x7E2A53A146606A48ULL }, { 0x99C102844F94E0FBULL, 0x2EDA7444CBFC426DULL },
+    { 0xC0314325637A1939ULL, 0xFA911155FEFB5308ULL }, { 0xF03D93EEBC589F88ULL, 0x793555AB7EBA27CAULL },
+    { 0x96267C7535B763B5ULL, 0x4BC1558B2F3458DEULL }, { 0xBBB01B9283253CA2ULL, 0x9EB1AAEDFB016F16ULL },
+    { 0xEA9C227723EE8BCBULL, 0x465E15A979C1CADCULL }, { 0x92A1958A7675175FULL, 0x0BFACD89EC191EC9ULL },
+    { 0xB749FAED14125D36ULL, 0xCEF980EC671F667BULL }, { 0xE51C79A85916F484ULL, 0x82B7E12780E7401AULL },
+    { 0x8F31CC0937AE58D2ULL, 0xD1B2ECB8B0908810ULL }, { 0xB2FE3F0B8599EF07ULL, 0x861FA7E6DCB4AA15ULL },
+    { 0xDFBDCECE67006AC9ULL, 0x67A791E093E1D49AULL }, { 0x8BD6A141006042BDULL, 0xE0C8BB2C5C6D24E0ULL },
+    { 0xAECC49914078536DULL, 0x58FAE9F773886E18ULL }, { 0xDA7F5BF590966848ULL, 0xAF39A475506A899EULL },
+    { 0x888F99797A5E012DULL, 0x6D8406C952429603ULL }, { 0xAAB37FD7D8F58178ULL, 0xC8E5087BA6D33B83ULL },
+    { 0xD5605FCDCF32E1D6ULL, 0xFB1E4A9A90880A64ULL }, { 0x855C3BE0A17FCD26ULL, 0x5CF2EEA09A55067FULL },
+    { 0xA6B34AD8C9DFC06FULL, 0xF42FAA48C0EA481EULL }, { 0xD0601D8EFC57B08BULL, 0xF13B94DAF124DA26ULL },
+    { 0x823C12795DB6CE57ULL, 0x76C53D08D6B70858ULL }, { 0xA2CB1717B52481EDULL, 0x54768C4B0C64CA6EULL },
+    { 0xCB7DDCDDA26DA268ULL, 0xA9942F5DCF7DFD09ULL }, { 0xFE5D54150B090B02ULL, 0xD3F93B35435D7C4CULL },
+    { 0x9EFA548D26E5A6E1ULL, 0xC47BC5014A1A6DAFULL }, { 0xC6B8E9B0709F109AULL, 0x359AB6419CA1091BULL },
+    { 0xF867241C8CC6D4C0ULL, 0xC30163D203C94B62ULL }, { 0x9B407691D7FC44F8ULL, 0x79E0DE63425DCF1DULL },
+    { 0xC21094364DFB5636ULL, 0x985915FC12F542E4ULL }, { 0xF294B943E17A2BC4ULL, 0x3E6F5B7B17B2939DULL },
+    { 0x979CF3CA6CEC5B5AULL, 0xA705992CEECF9C42ULL }, { 0xBD8430BD08277231ULL, 0x50C6FF782A838353ULL },
+    { 0xECE53CEC4A314EBDULL, 0xA4F8BF5635246428ULL }, { 0x940F4613AE5ED136ULL, 0x871B7795E136BE99ULL },
+    { 0xB913179899F68584ULL, 0x28E2557B59846E3FULL }, { 0xE757DD7EC07426E5ULL, 0x331AEADA2FE589CFULL },
+    { 0x9096EA6F3848984FULL, 0x3FF0D2C85DEF7621ULL }, { 0xB4BCA50B065ABE63ULL, 0x0FED077A756B53A9ULL },
+    { 0xE1EBCE4DC7F16DFBULL, 0xD3E8495912C62894ULL }, { 0x8D3360F09CF6E4BDULL, 0x64712DD7ABBBD95CULL },
+    { 0xB080392CC4349DECULL, 0xBD8D794D96AACFB3ULL }, { 0xDCA04777F541C567ULL, 0xECF0D7A0FC5583A0ULL },
+    { 0x89E42CAAF9491B60ULL, 0xF41686C49DB57244ULL }, { 0xAC5D37D5B79B6239ULL, 0x311C2875C522CED5ULL },
+    { 0xD77485CB25823AC7ULL, 0x7D633293366B828BULL }, { 0x86A8D39EF77164BCULL, 0xAE5DFF9C02033197ULL },
+    { 0xA8530886B54DBDEBULL, 0xD9F57F830283FDFCULL }, { 0xD267CAA862A12D66ULL, 0xD072DF63C324FD7BULL },
+    { 0x8380DEA93DA4BC60ULL, 0x4247CB9E59F71E6DULL }, { 0xA46116538D0DEB78ULL, 0x52D9BE85F074E608ULL },
+    { 0xCD795BE870516656ULL, 0x67902E276C921F8BULL }, { 0x806BD9714632DFF6ULL, 0x00BA1CD8A3DB53B6ULL },
+    { 0xA086CFCD97BF97F3ULL, 0x80E8A40ECCD228A4ULL }, { 0xC8A883C0FDAF7DF0ULL, 0x6122CD128006B2CDULL },
+    { 0xFAD2A4B13D1B5D6CULL, 0x796B805720085F81ULL }, { 0x9CC3A6EEC6311A63ULL, 0xCBE3303674053BB0ULL },
+    { 0xC3F490AA77BD60FCULL, 0xBEDBFC4411068A9CULL }, { 0xF4F1B4D515ACB93BULL, 0xEE92FB5515482D44ULL },
+    { 0x991711052D8BF3C5ULL, 0x751BDD152D4D1C4AULL }, { 0xBF5CD54678EEF0B6ULL, 0xD262D45A78A0635DULL },
+    { 0xEF340A98172AACE4ULL, 0x86FB897116C87C34ULL }, { 0x9580869F0E7AAC0EULL, 0xD45D35E6AE3D4DA0ULL },
+    { 0xBAE0A846D2195712ULL, 0x8974836059CCA109ULL }, { 0xE998D258869FACD7ULL, 0x2BD1A438703FC94BULL },
+    { 0x91FF83775423CC06ULL, 0x7B6306A34627DDCFULL }, { 0xB67F6455292CBF08ULL, 0x1A3BC84C17B1D542ULL },
+    { 0xE41F3D6A7377EECAULL, 0x20CABA5F1D9E4A93ULL }, { 0x8E938662882AF53EULL, 0x547EB47B7282EE9CULL },
+    { 0xB23867FB2A35B28DULL, 0xE99E619A4F23AA43ULL }, { 0xDEC681F9F4C31F31ULL, 0x6405FA00E2EC94D4ULL },
+    { 0x8B3C113C38F9F37EULL, 0xDE83BC408DD3DD04ULL }, { 0xAE0B158B4738705EULL, 0x9624AB50B148D445ULL },
+    { 0xD98DDAEE19068C76ULL, 0x3BADD624DD9B0957ULL }, { 0x87F8A8D4CFA417C9ULL, 0xE54CA5D70A80E5D6ULL },
+    { 0xA9F6D30A038D1DBCULL, 0x5E9FCF4CCD211F4CULL }, { 0xD47487CC8470652BULL, 0x7647C3200069671FULL },
+    { 0x84C8D4DFD2C63F3BULL, 0x29ECD9F40041E073ULL }, { 0xA5FB0A17C777CF09ULL, 0xF468107100525890ULL },
+    { 0xCF79CC9DB955C2CCULL, 0x7182148D4066EEB4ULL }, { 0x81AC1FE293D599BFULL, 0xC6F14CD848405530ULL },
+    { 0xA21727DB38CB002FULL, 0xB8ADA00E5A506A7CULL }, { 0xCA9CF1D206FDC03BULL, 0xA6D90811F0E4851CULL },
+    { 0xFD442E4688BD304AULL, 0x908F4A166D1DA663ULL }, { 0x9E4A9CEC15763E2EULL, 0x9A598E4E043287FEULL },
+    { 0xC5DD44271AD3CDBAULL, 0x40EFF1E1853F29FDULL }, { 0xF7549530E188C128ULL, 0xD12BEE59E68EF47CULL },
+    { 0x9A94DD3E8CF578B9ULL, 0x82BB74F8301958CEULL }, { 0xC13A148E3032D6E7ULL, 0xE36A52363C1FAF01ULL },
+    { 0xF18899B1BC3F8CA1ULL, 0xDC44E6C3CB279AC1ULL }, { 0x96F5600F15A7B7E5ULL, 0x29AB103A5EF8C0B9ULL },
+    { 0xBCB2B812DB11A5DEULL, 0x7415D448F6B6F0E7ULL }, { 0xEBDF661791D60F56ULL, 0x111B495B3464AD21ULL },
+    { 0x936B9FCEBB25C995ULL, 0xCAB10DD900BEEC34ULL }, { 0xB84687C269EF3BFBULL, 0x3D5D514F40EEA742ULL },
+    { 0xE65829B3046B0AFAULL, 0x0CB4A5A3112A5112ULL }, { 0x8FF71A0FE2C2E6DCULL, 0x47F0E785EABA72ABULL },
+    { 0xB3F4E093DB73A093ULL, 0x59ED216765690F56ULL }, { 0xE0F218B8D25088B8ULL, 0x306869C13EC3532CULL },
+    { 0x8C974F7383725573ULL, 0x1E414218C73A13FBULL }, { 0xAFBD2350644EEACFULL, 0xE5D1929EF90898FAULL },
+    { 0xDBAC6C247D62A583ULL, 0xDF45F746B74ABF39ULL }, { 0x894BC396CE5DA772ULL, 0x6B8BBA8C328EB783ULL },
+    { 0xAB9EB47C81F5114FULL, 0x066EA92F3F326564ULL }, { 0xD686619BA27255A2ULL, 0xC80A537B0EFEFEBDULL },
+    { 0x8613FD0145877585ULL, 0xBD06742CE95F5F36ULL }, { 0xA798FC4196E952E7ULL, 0x2C48113823B73704ULL },
+    { 0xD17F3B51FCA3A7A0ULL, 0xF75A15862CA504C5ULL }, { 0x82EF85133DE648C4ULL, 0x9A984D73DBE722FBULL },
+    { 0xA3AB66580D5FDAF5ULL, 0xC13E60D0D2E0EBBAULL }, { 0xCC963FEE10B7D1B3ULL, 0x318DF905079926A8ULL },
+    { 0xFFBBCFE994E5C61FULL, 0xFDF17746497F7052ULL }, { 0x9FD561F1FD0F9BD3ULL, 0xFEB6EA8BEDEFA633ULL },
+    { 0xC7CABA6E7C5382C8ULL, 0xFE64A52EE96B8FC0ULL }, { 0xF9BD690A1B68637BULL, 0x3DFDCE7AA3C673B0ULL },
+    { 0x9C1661A651213E2DULL, 0x06BEA10CA65C084EULL }, { 0xC31BFA0FE5698DB8ULL, 0x486E494FCFF30A62ULL },
+    { 0xF3E2F893DEC3F126ULL, 0x5A89DBA3C3EFCCFAULL }, { 0x986DDB5C6B3A76B7ULL, 0xF89629465A75E01CULL },
+    { 0xBE89523386091465ULL, 0xF6BBB397F1135823ULL }, { 0xEE2BA6C0678B597FULL, 0x746AA07DED582E2CULL },
+    { 0x94DB483840B717EFULL, 0xA8C2A44EB4571CDCULL }, { 0xBA121A4650E4DDEBULL, 0x92F34D62616CE413ULL },
+    { 0xE896A0D7E51E1566ULL, 0x77B020BAF9C81D17ULL }, { 0x915E2486EF32CD60ULL, 0x0ACE1474DC1D122EULL },
+    { 0xB5B5ADA8AAFF80B8ULL, 0x0D819992132456BAULL }, { 0xE3231912D5BF60E6ULL, 0x10E1FFF697ED6C69ULL },
+    { 0x8DF5EFABC5979C8FULL, 0xCA8D3FFA1EF463C1ULL }, { 0xB1736B96B6FD83B3ULL, 0xBD308FF8A6B17CB2ULL },
+    { 0xDDD0467C64BCE4A0ULL, 0xAC7CB3F6D05DDBDEULL }, { 0x8AA22C0DBEF60EE4ULL, 0x6BCDF07A423AA96BULL },
+    { 0xAD4AB7112EB3929DULL, 0x86C16C98D2C953C6ULL }, { 0xD89D64D57A607744ULL, 0xE871C7BF077BA8B7ULL },
+    { 0x87625F056C7C4A8BULL, 0x11471CD764AD4972ULL }, { 0xA93AF6C6C79B5D2DULL, 0xD598E40D3DD89BCFULL },
+    { 0xD389B47879823479ULL, 0x4AFF1D108D4EC2C3ULL }, { 0x843610CB4BF160CBULL, 0xCEDF722A585139BAULL },
+    { 0xA54394FE1EEDB8FEULL, 0xC2974EB4EE658828ULL }, { 0xCE947A3DA6A9273EULL, 0x733D226229FEEA32ULL },
+    { 0x811CCC668829B887ULL, 0x0806357D5A3F525FULL }, { 0xA163FF802A3426A8ULL, 0xCA07C2DCB0CF26F7ULL },
+    { 0xC9BCFF6034C13052ULL, 0xFC89B393DD02F0B5ULL }, { 0xFC2C3F3841F17C67ULL, 0xBBAC2078D443ACE2ULL },
+    { 0x9D9BA7832936EDC0ULL, 0xD54B944B84AA4C0DULL }, { 0xC5029163F384A931ULL, 0x0A9E795E65D4DF11ULL },
+    { 0xF64335BCF065D37DULL, 0x4D4617B5FF4A16D5ULL }, { 0x99EA0196163FA42EULL, 0x504BCED1BF8E4E45ULL },
+    { 0xC06481FB9BCF8D39ULL, 0xE45EC2862F71E1D6ULL }, { 0xF07DA27A82C37088ULL, 0x5D767327BB4E5A4CULL },
+    { 0x964E858C91BA2655ULL, 0x3A6A07F8D510F86FULL }, { 0xBBE226EFB628AFEAULL, 0x890489F70A55368BULL },
+    { 0xEADAB0ABA3B2DBE5ULL, 0x2B45AC74CCEA842EULL }, { 0x92C8AE6B464FC96FULL, 0x3B0B8BC90012929DULL },
+    { 0xB77ADA0617E3BBCBULL, 0x09CE6EBB40173744ULL }, { 0xE55990879DDCAABDULL, 0xCC420A6A101D0515ULL },
+    { 0x8F57FA54C2A9EAB6ULL, 0x9FA946824A12232DULL }, { 0xB32DF8E9F3546564ULL, 0x47939822DC96ABF9ULL },
+    { 0xDFF9772470297EBDULL, 0x59787E2B93BC56F7ULL }, { 0x8BFBEA76C619EF36ULL, 0x57EB4EDB3C55B65AULL },
+    { 0xAEFAE51477A06B03ULL, 0xEDE622920B6B23F1ULL }, { 0xDAB99E59958885C4ULL, 0xE95FAB368E45ECEDULL },
+    { 0x88B402F7FD75539BULL, 0x11DBCB0218EBB414ULL }, { 0xAAE103B5FCD2A881ULL, 0xD652BDC29F26A119ULL },
+    { 0xD59944A37C0752A2ULL, 0x4BE76D3346F0495FULL }, { 0x857FCAE62D8493A5ULL, 0x6F70A4400C562DDBULL },
+    { 0xA6DFBD9FB8E5B88EULL, 0xCB4CCD500F6BB952ULL }, { 0xD097AD07A71F26B2ULL, 0x7E2000A41346A7A7ULL },
+    { 0x825ECC24C873782FULL, 0x8ED400668C0C28C8ULL }, { 0xA2F67F2DFA90563BULL, 0x728900802F0F32FAULL },
+    { 0xCBB41EF979346BCAULL, 0x4F2B40A03AD2FFB9ULL }, { 0xFEA126B7D78186BCULL, 0xE2F610C84987BFA8ULL },
+    { 0x9F24B832E6B0F436ULL, 0x0DD9CA7D2DF4D7C9ULL }, { 0xC6EDE63FA05D3143ULL, 0x91503D1C79720DBBULL },
+    { 0xF8A95FCF88747D94ULL, 0x75A44C6397CE912AULL }, { 0x9B69DBE1B548CE7CULL, 0xC986AFBE3EE11ABAULL },
+    { 0xC24452DA229B021BULL, 0xFBE85BADCE996168ULL }, { 0xF2D56790AB41C2A2ULL, 0xFAE27299423FB9C3ULL },
+    { 0x97C560BA6B0919A5ULL, 0xDCCD879FC967D41AULL }, { 0xBDB6B8E905CB600FULL, 0x5400E987BBC1C920ULL },
+    { 0xED246723473E3813ULL, 0x290123E9AAB23B68ULL }, { 0x9436C0760C86E30BULL, 0xF9A0B6720AAF6521ULL },
+    { 0xB94470938FA89BCEULL, 0xF808E40E8D5B3E69ULL }, { 0xE7958CB87392C2C2ULL, 0xB60B1D1230B20E04ULL },
+    { 0x90BD77F3483BB9B9ULL, 0xB1C6F22B5E6F48C2ULL }, { 0xB4ECD5F01A4AA828ULL, 0x1E38AEB6360B1AF3ULL },
+    { 0xE2280B6C20DD5232ULL, 0x25C6DA63C38DE1B0ULL }, { 0x8D590723948A535FULL, 0x579C487E5A38AD0EULL },
+    { 0xB0AF48EC79ACE837ULL, 0x2D835A9DF0C6D851ULL }, { 0xDCDB1B2798182244ULL, 0xF8E431456CF88E65ULL },
+    { 0x8A08F0F8BF0F156BULL, 0x1B8E9ECB641B58FFULL }, { 0xAC8B2D36EED2DAC5ULL, 0xE272467E3D222F3FULL },
+    { 0xD7ADF884AA879177ULL, 0x5B0ED81DCC6ABB0FULL }, { 0x86CCBB52EA94BAEAULL, 0x98E947129FC2B4E9ULL },
+    { 0xA87FEA27A539E9A5ULL, 0x3F2398D747B36224ULL }, { 0xD29FE4B18E88640EULL, 0x8EEC7F0D19A03AADULL },
+    { 0x83A3EEEEF9153E89ULL, 0x1953CF68300424ACULL }, { 0xA48CEAAAB75A8E2BULL, 0x5FA8C3423C052DD7ULL },
+    { 0xCDB02555653131B6ULL, 0x3792F412CB06794DULL }, { 0x808E17555F3EBF11ULL, 0xE2BBD88BBEE40BD0ULL },
+    { 0xA0B19D2AB70E6ED6ULL, 0x5B6ACEAEAE9D0EC4ULL }, { 0xC8DE047564D20A8BULL, 0xF245825A5A445275ULL },
+    { 0xFB158592BE068D2EULL, 0xEED6E2F0F0D56712ULL }, { 0x9CED737BB6C4183DULL, 0x55464DD69685606BULL },
+    { 0xC428D05AA4751E4CULL, 0xAA97E14C3C26B886ULL }, { 0xF53304714D9265DFULL, 0xD53DD99F4B3066A8ULL },
+    { 0x993FE2C6D07B7FABULL, 0xE546A8038EFE4029ULL }, { 0xBF8FDB78849A5F96ULL, 0xDE98520472BDD033ULL },
+    { 0xEF73D256A5C0F77CULL, 0x963E66858F6D4440ULL }, { 0x95A8637627989AADULL, 0xDDE7001379A44AA8ULL },
+    { 0xBB127C53B17EC159ULL, 0x5560C018580D5D52ULL }, { 0xE9D71B689DDE71AFULL, 0xAAB8F01E6E10B4A6ULL },
+    { 0x9226712162AB070DULL, 0xCAB3961304CA70E8ULL }, { 0xB6B00D69BB55C8D1ULL, 0x3D607B97C5FD0D22ULL },
+    { 0xE45C10C42A2B3B05ULL, 0x8CB89A7DB77C506AULL }, { 0x8EB98A7A9A5B04E3ULL, 0x77F3608E92ADB242ULL },
+    { 0xB267ED1940F1C61CULL, 0x55F038B237591ED3ULL }, { 0xDF01E85F912E37A3ULL, 0x6B6C46DEC52F6688ULL },
+    { 0x8B61313BBABCE2C6ULL, 0x2323AC4B3B3DA015ULL }, { 0xAE397D8AA96C1B77ULL, 0xABEC975E0A0D081AULL },
+    { 0xD9C7DCED53C72255ULL, 0x96E7BD358C904A21ULL }, { 0x881CEA14545C7575ULL, 0x7E50D64177DA2E54ULL },
+    { 0xAA242499697392D2ULL, 0xDDE50BD1D5D0B9E9ULL }, { 0xD4AD2DBFC3D07787ULL, 0x955E4EC64B44E864ULL },
+    { 0x84EC3C97DA624AB4ULL, 0xBD5AF13BEF0B113EULL }, { 0xA6274BBDD0FADD61ULL, 0xECB1AD8AEACDD58EULL },
+    { 0xCFB11EAD453994BAULL, 0x67DE18EDA5814AF2ULL }, { 0x81CEB32C4B43FCF4ULL, 0x80EACF948770CED7ULL },
+    { 0xA2425FF75E14FC31ULL, 0xA1258379A94D028DULL }, { 0xCAD2F7F5359A3B3EULL, 0x096EE45813A04330ULL },
+    { 0xFD87B5F28300CA0DULL, 0x8BCA9D6E188853FCULL }, { 0x9E74D1B791E07E48ULL, 0x775EA264CF55347DULL },
+    { 0xC612062576589DDAULL, 0x95364AFE032A819DULL }, { 0xF79687AED3EEC551ULL, 0x3A83DDBD83F52204ULL },
+    { 0x9ABE14CD44753B52ULL, 0xC4926A9672793542ULL }, { 0xC16D9A0095928A27ULL, 0x75B7053C0F178293ULL },
+    { 0xF1C90080BAF72CB1ULL, 0x5324C68B12DD6338ULL }, { 0x971DA05074DA7BEEULL, 0xD3F6FC16EBCA5E03ULL },
+    { 0xBCE5086492111AEAULL, 0x88F4BB1CA6BCF584ULL }, { 0xEC1E4A7DB69561A5ULL, 0x2B31E9E3D06C32E5ULL },
+    { 0x9392EE8E921D5D07ULL, 0x3AFF322E62439FCFULL }, { 0xB877AA3236A4B449ULL, 0x09BEFEB9FAD487C2ULL },
+    { 0xE69594BEC44DE15BULL, 0x4C2EBE687989A9B3ULL }, { 0x901D7CF73AB0ACD9ULL, 0x0F9D37014BF60A10ULL },
+    { 0xB424DC35095CD80FULL, 0x538484C19EF38C94ULL }, { 0xE12E13424BB40E13ULL, 0x2865A5F206B06FB9ULL },
+    { 0x8CBCCC096F5088CBULL, 0xF93F87B7442E45D3ULL }, { 0xAFEBFF0BCB24AAFEULL, 0xF78F69A51539D748ULL },
+    { 0xDBE6FECEBDEDD5BEULL, 0xB573440E5A884D1BULL }, { 0x89705F4136B4A597ULL, 0x31680A88F8953030ULL },
+    { 0xABCC77118461CEFCULL, 0xFDC20D2B36BA7C3DULL }, { 0xD6BF94D5E57A42BCULL, 0x3D32907604691B4CULL },
+    { 0x8637BD05AF6C69B5ULL, 0xA63F9A49C2C1B10FULL }, { 0xA7C5AC471B478423ULL, 0x0FCF80DC33721D53ULL },
+    { 0xD1B71758E219652BULL, 0xD3C36113404EA4A8ULL }, { 0x83126E978D4FDF3BULL, 0x645A1CAC083126E9ULL },
+    { 0xA3D70A3D70A3D70AULL, 0x3D70A3D70A3D70A3ULL }, { 0xCCCCCCCCCCCCCCCCULL, 0xCCCCCCCCCCCCCCCCULL },
+    { 0x8000000000000000ULL, 0x0000000000000000ULL }, { 0xA000000000000000ULL, 0x0000000000000000ULL },
+    { 0xC800000000000000ULL, 0x0000000000000000ULL }, { 0xFA00000000000000ULL, 0x0000000000000000ULL },
+    { 0x9C40000000000000ULL, 0x0000000000000000ULL }, { 0xC350000000000000ULL, 0x0000000000000000ULL },
+    { 0xF424000000000000ULL, 0x0000000000000000ULL }, { 0x9896800000000000ULL, 0x0000000000000000ULL },
+    { 0xBEBC200000000000ULL, 0x0000000000000000ULL }, { 0xEE6B280000000000ULL, 0x0000000000000000ULL },
+    { 0x9502F90000000000ULL, 0x0000000000000000ULL }, { 0xBA43B74000000000ULL, 0x0000000000000000ULL },
+    { 0xE8D4A51000000000ULL, 0x0000000000000000ULL }, { 0x9184E72A00000000ULL, 0x0000000000000000ULL },
+    { 0xB5E620F480000000ULL, 0x0000000000000000ULL }, { 0xE35FA931A0000000ULL, 0x0000000000000000ULL },
+    { 0x8E1BC9BF04000000ULL, 0x0000000000000000ULL }, { 0xB1A2BC2EC5000000ULL, 0x0000000000000000ULL },
+    { 0xDE0B6B3A76400000ULL, 0x0000000000000000ULL }, { 0x8AC7230489E80000ULL, 0x0000000000000000ULL },
+    { 0xAD78EBC5AC620000ULL, 0x0000000000000000ULL }, { 0xD8D726B7177A8000ULL, 0x0000000000000000ULL },
+    { 0x878678326EAC9000ULL, 0x0000000000000000ULL }, { 0xA968163F0A57B400ULL, 0x0000000000000000ULL },
+    { 0xD3C21BCECCEDA100ULL, 0x0000000000000000ULL }, { 0x84595161401484A0ULL, 0x0000000000000000ULL },
+    { 0xA56FA5B99019A5C8ULL, 0x0000000000000000ULL }, { 0xCECB8F27F4200F3AULL, 0x0000000000000000ULL },
+    { 0x813F3978F8940984ULL, 0x4000000000000000ULL }, { 0xA18F07D736B90BE5ULL, 0x5000000000000000ULL },
+    { 0xC9F2C9CD04674EDEULL, 0xA400000000000000ULL }, { 0xFC6F7C4045812296ULL, 0x4D00000000000000ULL },
+    { 0x9DC5ADA82B70B59DULL, 0xF020000000000000ULL }, { 0xC5371912364CE305ULL, 0x6C28000000000000ULL },
+    { 0xF684DF56C3E01BC6ULL, 0xC732000000000000ULL }, { 0x9A130B963A6C115CULL, 0x3C7F400000000000ULL },
+    { 0xC097CE7BC90715B3ULL, 0x4B9F100000000000ULL }, { 0xF0BDC21ABB48DB20ULL, 0x1E86D40000000000ULL },
+    { 0x96769950B50D88F4ULL, 0x1314448000000000ULL }, { 0xBC143FA4E250EB31ULL, 0x17D955A000000000ULL },
+    { 0xEB194F8E1AE525FDULL, 0x5DCFAB0800000000ULL }, { 0x92EFD1B8D0CF37BEULL, 0x5AA1CAE500000000ULL },
+    { 0xB7ABC627050305ADULL, 0xF14A3D9E40000000ULL }, { 0xE596B7B0C643C719ULL, 0x6D9CCD05D0000000ULL },
+    { 0x8F7E32CE7BEA5C6FULL, 0xE4820023A2000000ULL }, { 0xB35DBF821AE4F38BULL, 0xDDA2802C8A800000ULL },
+    { 0xE0352F62A19E306EULL, 0xD50B2037AD200000ULL }, { 0x8C213D9DA502DE45ULL, 0x4526F422CC340000ULL },
+    { 0xAF298D050E4395D6ULL, 0x9670B12B7F410000ULL }, { 0xDAF3F04651D47B4CULL, 0x3C0CDD765F114000ULL },
+    { 0x88D8762BF324CD0FULL, 0xA5880A69FB6AC800ULL }, { 0xAB0E93B6EFEE0053ULL, 0x8EEA0D047A457A00ULL },
+    { 0xD5D238A4ABE98068ULL, 0x72A4904598D6D880ULL }, { 0x85A36366EB71F041ULL, 0x47A6DA2B7F864750ULL },
+    { 0xA70C3C40A64E6C51ULL, 0x999090B65F67D924ULL }, { 0xD0CF4B50CFE20765ULL, 0xFFF4B4E3F741CF6DULL },
+    { 0x82818F1281ED449FULL, 0xBFF8F10E7A8921A4ULL }, { 0xA321F2D7226895C7ULL, 0xAFF72D52192B6A0DULL },
+    { 0xCBEA6F8CEB02BB39ULL, 0x9BF4F8A69F764490ULL }, { 0xFEE50B7025C36A08ULL, 0x02F236D04753D5B4ULL },
+    { 0x9F4F2726179A2245ULL, 0x01D762422C946590ULL }, { 0xC722F0EF9D80AAD6ULL, 0x424D3AD2B7B97EF5ULL },
+    { 0xF8EBAD2B84E0D58BULL, 0xD2E0898765A7DEB2ULL }, { 0x9B934C3B330C8577ULL, 0x63CC55F49F88EB2FULL },
+    { 0xC2781F49FFCFA6D5ULL, 0x3CBF6B71C76B25FBULL }, { 0xF316271C7FC3908AULL, 0x8BEF464E3945EF7AULL },
+    { 0x97EDD871CFDA3A56ULL, 0x97758BF0E3CBB5ACULL }, { 0xBDE94E8E43D0C8ECULL, 0x3D52EEED1CBEA317ULL },
+    { 0xED63A231D4C4FB27ULL, 0x4CA7AAA863EE4BDDULL }, { 0x945E455F24FB1CF8ULL, 0x8FE8CAA93E74EF6AULL },
+    { 0xB975D6B6EE39E436ULL, 0xB3E2FD538E122B44ULL }, { 0xE7D34C64A9C85D44ULL, 0x60DBBCA87196B616ULL },
+    { 0x90E40FBEEA1D3A4AULL, 0xBC8955E946FE31CDULL }, { 0xB51D13AEA4A488DDULL, 0x6BABAB6398BDBE41ULL },
+    { 0xE264589A4DCDAB14ULL, 0xC696963C7EED2DD1ULL }, { 0x8D7EB76070A08AECULL, 0xFC1E1DE5CF543CA2ULL },
+    { 0xB0DE65388CC8ADA8ULL, 0x3B25A55F43294BCBULL }, { 0xDD15FE86AFFAD912ULL, 0x49EF0EB713F39EBEULL },
+    { 0x8A2DBF142DFCC7ABULL, 0x6E3569326C784337ULL }, { 0xACB92ED9397BF996ULL, 0x49C2C37F07965404ULL },
+    { 0xD7E77A8F87DAF7FBULL, 0xDC33745EC97BE906ULL }, { 0x86F0AC99B4E8DAFDULL, 0x69A028BB3DED71A3ULL },
+    { 0xA8ACD7C0222311BCULL, 0xC40832EA0D68CE0CULL }, { 0xD2D80DB02AABD62BULL, 0xF50A3FA490C30190ULL },
+    { 0x83C7088E1AAB65DBULL, 0x792667C6DA79E0FAULL }, { 0xA4B8CAB1A1563F52ULL, 0x577001B891185938ULL },
+    { 0xCDE6FD5E09ABCF26ULL, 0xED4C0226B55E6F86ULL }, { 0x80B05E5AC60B6178ULL, 0x544F8158315B05B4ULL },
+    { 0xA0DC75F1778E39D6ULL, 0x696361AE3DB1C721ULL }, { 0xC913936DD571C84CULL, 0x03BC3A19CD1E38E9ULL },
+    { 0xFB5878494ACE3A5FULL, 0x04AB48A04065C723ULL }, { 0x9D174B2DCEC0E47BULL, 0x62EB0D64283F9C76ULL },
+    { 0xC45D1DF942711D9AULL, 0x3BA5D0BD324F8394ULL }, { 0xF5746577930D6500ULL, 0xCA8F44EC7EE36479ULL },
+    { 0x9968BF6ABBE85F20ULL, 0x7E998B13CF4E1ECBULL }, { 0xBFC2EF456AE276E8ULL, 0x9E3FEDD8C321A67EULL },
+    { 0xEFB3AB16C59B14A2ULL, 0xC5CFE94EF3EA101EULL }, { 0x95D04AEE3B80ECE5ULL, 0xBBA1F1D158724A12ULL },
+    { 0xBB445DA9CA61281FULL, 0x2A8A6E45AE8EDC97ULL }, { 0xEA1575143CF97226ULL, 0xF52D09D71A3293BDULL },
+    { 0x924D692CA61BE758ULL, 0x593C2626705F9C56ULL }, { 0xB6E0C377CFA2E12EULL, 0x6F8B2FB00C77836CULL },
+    { 0xE498F455C38B997AULL, 0x0B6DFB9C0F956447ULL }, { 0x8EDF98B59A373FECULL, 0x4724BD4189BD5EACULL },
+    { 0xB2977EE300C50FE7ULL, 0x58EDEC91EC2CB657ULL }, { 0xDF3D5E9BC0F653E1ULL, 0x2F2967B66737E3EDULL },
+    { 0x8B865B215899F46CULL, 0xBD79E0D20082EE74ULL }, { 0xAE67F1E9AEC07187ULL, 0xECD8590680A3AA11ULL },
+    { 0xDA01EE641A708DE9ULL, 0xE80E6F4820CC9495ULL }, { 0x884134FE908658B2ULL, 0x3109058D147FDCDDULL },
+    { 0xAA51823E34A7EEDEULL, 0xBD4B46F0599FD415ULL }, { 0xD4E5E2CDC1D1EA96ULL, 0x6C9E18AC7007C91AULL },
+    { 0x850FADC09923329EULL, 0x03E2CF6BC604DDB0ULL }, { 0xA6539930BF6BFF45ULL, 0x84DB8346B786151CULL },
+    { 0xCFE87F7CEF46FF16ULL, 0xE612641865679A63ULL }, { 0x81F14FAE158C5F6EULL, 0x4FCB7E8F3F60C07EULL },
+    { 0xA26DA3999AEF7749ULL, 0xE3BE5E330F38F09DULL }, { 0xCB090C8001AB551CULL, 0x5CADF5BFD3072CC5ULL },
+    { 0xFDCB4FA002162A63ULL, 0x73D9732FC7C8F7F6ULL }, { 0x9E9F11C4014DDA7EULL, 0x2867E7FDDCDD9AFAULL },
+    { 0xC646D63501A1511DULL, 0xB281E1FD541501B8ULL }, { 0xF7D88BC24209A565ULL, 0x1F225A7CA91A4226ULL },
+    { 0x9AE757596946075FULL, 0x3375788DE9B06958ULL }, { 0xC1A12D2FC3978937ULL, 0x0052D6B1641C83AEULL },
+    { 0xF209787BB47D6B84ULL, 0xC0678C5DBD23A49AULL }, { 0x9745EB4D50CE6332ULL, 0xF840B7BA963646E0ULL },
+    { 0xBD176620A501FBFFULL, 0xB650E5A93BC3D898ULL }, { 0xEC5D3FA8CE427AFFULL, 0xA3E51F138AB4CEBEULL },
+    { 0x93BA47C980E98CDFULL, 0xC66F336C36B10137ULL }, { 0xB8A8D9BBE123F017ULL, 0xB80B0047445D4184ULL },
+    { 0xE6D3102AD96CEC1DULL, 0xA60DC059157491E5ULL }, { 0x9043EA1AC7E41392ULL, 0x87C89837AD68DB2FULL },
+    { 0xB454E4A179DD1877ULL, 0x29BABE4598C311FBULL }, { 0xE16A1DC9D8545E94ULL, 0xF4296DD6FEF3D67AULL },
+    { 0x8CE2529E2734BB1DULL, 0x1899E4A65F58660CULL }, { 0xB01AE745B101E9E4ULL, 0x5EC05DCFF72E7F8FULL },
+    { 0xDC21A1171D42645DULL, 0x76707543F4FA1F73ULL }, { 0x899504AE72497EBAULL, 0x6A06494A791C53A8ULL },
+    { 0xABFA45DA0EDBDE69ULL, 0x0487DB9D17636892ULL }, { 0xD6F8D7509292D603ULL, 0x45A9D2845D3C42B6ULL },
+    { 0x865B86925B9BC5C2ULL, 0x0B8A2392BA45A9B2ULL }, { 0xA7F26836F282B732ULL, 0x8E6CAC7768D7141EULL },
+    { 0xD1EF0244AF2364FFULL, 0x3207D795430CD926ULL }, { 0x8335616AED761F1FULL, 0x7F44E6BD49E807B8ULL },
+    { 0xA402B9C5A8D3A6E7ULL, 0x5F16206C9C6209A6ULL }, { 0xCD036837130890A1ULL, 0x36DBA887C37A8C0FULL },
+    { 0x802221226BE55A64ULL, 0xC2494954DA2C9789ULL }, { 0xA02AA96B06DEB0FDULL, 0xF2DB9BAA10B7BD6CULL },
+    { 0xC83553C5C8965D3DULL, 0x6F92829494E5ACC7ULL }, { 0xFA42A8B73ABBF48CULL, 0xCB772339BA1F17F9ULL },
+    { 0x9C69A97284B578D7ULL, 0xFF2A760414536EFBULL }, { 0xC38413CF25E2D70DULL, 0xFEF5138519684ABAULL },
+    { 0xF46518C2EF5B8CD1ULL, 0x7EB258665FC25D69ULL }, { 0x98BF2F79D5993802ULL, 0xEF2F773FFBD97A61ULL },
+    { 0xBEEEFB584AFF8603ULL, 0xAAFB550FFACFD8FAULL }, { 0xEEAABA2E5DBF6784ULL, 0x95BA2A53F983CF38ULL },
+    { 0x952AB45CFA97A0B2ULL, 0xDD945A747BF26183ULL }, { 0xBA756174393D88DFULL, 0x94F971119AEEF9E4ULL },
+    { 0xE912B9D1478CEB17ULL, 0x7A37CD5601AAB85DULL }, { 0x91ABB422CCB812EEULL, 0xAC62E055C10AB33AULL },
+    { 0xB616A12B7FE617AAULL, 0x577B986B314D6009ULL }, { 0xE39C49765FDF9D94ULL, 0xED5A7E85FDA0B80BULL },
+    { 0x8E41ADE9FBEBC27DULL, 0x14588F13BE847307ULL }, { 0xB1D219647AE6B31CULL, 0x596EB2D8AE258FC8ULL },
+    { 0xDE469FBD99A05FE3ULL, 0x6FCA5F8ED9AEF3BBULL }, { 0x8AEC23D680043BEEULL, 0x25DE7BB9480D5854ULL },
+    { 0xADA72CCC20054AE9ULL, 0xAF561AA79A10AE6AULL }, { 0xD910F7FF28069DA4ULL, 0x1B2BA1518094DA04ULL },
+    { 0x87AA9AFF79042286ULL, 0x90FB44D2F05D0842ULL }, { 0xA99541BF57452B28ULL, 0x353A1607AC744A53ULL },
+    { 0xD3FA922F2D1675F2ULL, 0x42889B8997915CE8ULL }, { 0x847C9B5D7C2E09B7ULL, 0x69956135FEBADA11ULL },
+    { 0xA59BC234DB398C25ULL, 0x43FAB9837E699095ULL }, { 0xCF02B2C21207EF2EULL, 0x94F967E45E03F4BBULL },
+    { 0x8161AFB94B44F57DULL, 0x1D1BE0EEBAC278F5ULL }, { 0xA1BA1BA79E1632DCULL, 0x6462D92A69731732ULL },
+    { 0xCA28A291859BBF93ULL, 0x7D7B8F7503CFDCFEULL }, { 0xFCB2CB35E702AF78ULL, 0x5CDA735244C3D43EULL },
+    { 0x9DEFBF01B061ADABULL, 0x3A0888136AFA64A7ULL }, { 0xC56BAEC21C7A1916ULL, 0x088AAA1845B8FDD0ULL },
+    { 0xF6C69A72A3989F5BULL, 0x8AAD549E57273D45ULL }, { 0x9A3C2087A63F6399ULL, 0x36AC54E2F678864BULL },
+    { 0xC0CB28A98FCF3C7FULL, 0x84576A1BB416A7DDULL }, { 0xF0FDF2D3F3C30B9FULL, 0x656D44A2A11C51D5ULL },
+    { 0x969EB7C47859E743ULL, 0x9F644AE5A4B1B325ULL }, { 0xBC4665B596706114ULL, 0x873D5D9F0DDE1FEEULL },
+    { 0xEB57FF22FC0C7959ULL, 0xA90CB506D155A7EAULL }, { 0x9316FF75DD87CBD8ULL, 0x09A7F12442D588F2ULL },
+    { 0xB7DCBF5354E9BECEULL, 0x0C11ED6D538AEB2FULL }, { 0xE5D3EF282A242E81ULL, 0x8F1668C8A86DA5FAULL },
+    { 0x8FA475791A569D10ULL, 0xF96E017D694487BCULL }, { 0xB38D92D760EC4455ULL, 0x37C981DCC395A9ACULL },
+    { 0xE070F78D3927556AULL, 0x85BBE253F47B1417ULL }, { 0x8C469AB843B89562ULL, 0x93956D7478CCEC8EULL },
+    { 0xAF58416654A6BABBULL, 0x387AC8D1970027B2ULL }, { 0xDB2E51BFE9D0696AULL, 0x06997B05FCC0319EULL },
+    { 0x88FCF317F22241E2ULL, 0x441FECE3BDF81F03ULL }, { 0xAB3C2FDDEEAAD25AULL, 0xD527E81CAD7626C3ULL },
+    { 0xD60B3BD56A5586F1ULL, 0x8A71E223D8D3B074ULL }, { 0x85C7056562757456ULL, 0xF6872D5667844E49ULL },
+    { 0xA738C6BEBB12D16CULL, 0xB428F8AC016561DBULL }, { 0xD106F86E69D785C7ULL, 0xE13336D701BEBA52ULL },
+    { 0x82A45B450226B39CULL, 0xECC0024661173473ULL }, { 0xA34D721642B06084ULL, 0x27F002D7F95D0190ULL },
+    { 0xCC20CE9BD35C78A5ULL, 0x31EC038DF7B441F4ULL }, { 0xFF290242C83396CEULL, 0x7E67047175A15271ULL },
+    { 0x9F79A169BD203E41ULL, 0x0F0062C6E984D386ULL }, { 0xC75809C42C684DD1ULL, 0x52C07B78A3E60868ULL },
+    { 0xF92E0C3537826145ULL, 0xA7709A56CCDF8A82ULL }, { 0x9BBCC7A142B17CCBULL, 0x88A66076400BB691ULL },
+    { 0xC2ABF989935DDBFEULL, 0x6ACFF893D00EA435ULL }, { 0xF356F7EBF83552FEULL, 0x0583F6B8C4124D43ULL },
+    { 0x98165AF37B2153DEULL, 0xC3727A337A8B704AULL }, { 0xBE1BF1B059E9A8D6ULL, 0x744F18C0592E4C5CULL },
+    { 0xEDA2EE1C7064130CULL, 0x1162DEF06F79DF73ULL }, { 0x9485D4D1C63E8BE7ULL, 0x8ADDCB5645AC2BA8ULL },
+    { 0xB9A74A0637CE2EE1ULL, 0x6D953E2BD7173692ULL }, { 0xE8111C87C5C1BA99ULL, 0xC8FA8DB6CCDD0437ULL },
+    { 0x910AB1D4DB9914A0ULL, 0x1D9C9892400A22A2ULL }, { 0xB54D5E4A127F59C8ULL, 0x2503BEB6D00CAB4BULL },
+    { 0xE2A0B5DC971F303AULL, 0x2E44AE64840FD61DULL }, { 0x8DA471A9DE737E24ULL, 0x5CEAECFED289E5D2ULL },
+    { 0xB10D8E1456105DADULL, 0x7425A83E872C5F47ULL }, { 0xDD50F1996B947518ULL, 0xD12F124E28F77719ULL },
+    { 0x8A5296FFE33CC92FULL, 0x82BD6B70D99AAA6FULL }, { 0xACE73CBFDC0BFB7BULL, 0x636CC64D1001550BULL },
+    { 0xD8210BEFD30EFA5AULL, 0x3C47F7E05401AA4EULL }, { 0x8714A775E3E95C78ULL, 0x65ACFAEC34810A71ULL },
+    { 0xA8D9D1535CE3B396ULL, 0x7F1839A741A14D0DULL }, { 0xD31045A8341CA07CULL, 0x1EDE48111209A050ULL },
+    { 0x83EA2B892091E44DULL, 0x934AED0AAB460432ULL }, { 0xA4E4B66B68B65D60ULL, 0xF81DA84D5617853FULL },
+    { 0xCE1DE40642E3F4B9ULL, 0x36251260AB9D668EULL }, { 0x80D2AE83E9CE78F3ULL, 0xC1D72B7C6B426019ULL },
+    { 0xA1075A24E4421730ULL, 0xB24CF65B8612F81FULL }, { 0xC94930AE1D529CFCULL, 0xDEE033F26797B627ULL },
+    { 0xFB9B7CD9A4A7443CULL, 0x169840EF017DA3B1ULL }, { 0x9D412E0806E88AA5ULL, 0x8E1F289560EE864EULL },
+    { 0xC491798A08A2AD4EULL, 0xF1A6F2BAB92A27E2ULL }, { 0xF5B5D7EC8ACB58A2ULL, 0xAE10AF696774B1DBULL },
+    { 0x9991A6F3D6BF1765ULL, 0xACCA6DA1E0A8EF29ULL }, { 0xBFF610B0CC6EDD3FULL, 0x17FD090A58D32AF3ULL },
+    { 0xEFF394DCFF8A948EULL, 0xDDFC4B4CEF07F5B0ULL }, { 0x95F83D0A1FB69CD9ULL, 0x4ABDAF101564F98EULL },
+    { 0xBB764C4CA7A4440FULL, 0x9D6D1AD41ABE37F1ULL }, { 0xEA53DF5FD18D5513ULL, 0x84C86189216DC5EDULL },
+    { 0x92746B9BE2F8552CULL, 0x32FD3CF5B4E49BB4ULL }, { 0xB7118682DBB66A77ULL, 0x3FBC8C33221DC2A1ULL },
+    { 0xE4D5E82392A40515ULL, 0x0FABAF3FEAA5334AULL }, { 0x8F05B1163BA6832DULL, 0x29CB4D87F2A7400EULL },
+    { 0xB2C71D5BCA9023F8ULL, 0x743E20E9EF511012ULL }, { 0xDF78E4B2BD342CF6ULL, 0x914DA9246B255416ULL },
+    { 0x8BAB8EEFB6409C1AULL, 0x1AD089B6C2F7548EULL }, { 0xAE9672ABA3D0C320ULL, 0xA184AC2473B529B1ULL },
+    { 0xDA3C0F568CC4F3E8ULL, 0xC9E5D72D90A2741EULL }, { 0x8865899617FB1871ULL, 0x7E2FA67C7A658892ULL },
+    { 0xAA7EEBFB9DF9DE8DULL, 0xDDBB901B98FEEAB7ULL }, { 0xD51EA6FA85785631ULL, 0x552A74227F3EA565ULL },
+    { 0x8533285C936B35DEULL, 0xD53A88958F87275FULL }, { 0xA67FF273B8460356ULL, 0x8A892ABAF368F137ULL },
+    { 0xD01FEF10A657842CULL, 0x2D2B7569B0432D85ULL }, { 0x8213F56A67F6B29BULL, 0x9C3B29620E29FC73ULL },
+    { 0xA298F2C501F45F42ULL, 0x8349F3BA91B47B8FULL }, { 0xCB3F2F7642717713ULL, 0x241C70A936219A73ULL },
+    { 0xFE0EFB53D30DD4D7ULL, 0xED238CD383AA0110ULL }, { 0x9EC95D1463E8A506ULL, 0xF4363804324A40AAULL },
+    { 0xC67BB4597CE2CE48ULL, 0xB143C6053EDCD0D5ULL }, { 0xF81AA16FDC1B81DAULL, 0xDD94B7868E94050AULL },
+    { 0x9B10A4E5E9913128ULL, 0xCA7CF2B4191C8326ULL }, { 0xC1D4CE1F63F57D72ULL, 0xFD1C2F611F63A3F0ULL },
+    { 0xF24A01A73CF2DCCFULL, 0xBC633B39673C8CECULL }, { 0x976E41088617CA01ULL, 0xD5BE0503E085D813ULL },
+    { 0xBD49D14AA79DBC82ULL, 0x4B2D8644D8A74E18ULL }, { 0xEC9C459D51852BA2ULL, 0xDDF8E7D60ED1219EULL },
+    { 0x93E1AB8252F33B45ULL, 0xCABB90E5C942B503ULL }, { 0xB8DA1662E7B00A17ULL, 0x3D6A751F3B936243ULL },
+    { 0xE7109BFBA19C0C9DULL, 0x0CC512670A783AD4ULL }, { 0x906A617D450187E2ULL, 0x27FB2B80668B24C5ULL },
+    { 0xB484F9DC9641E9DAULL, 0xB1F9F660802DEDF6ULL }, { 0xE1A63853BBD26451ULL, 0x5E7873F8A0396973ULL },
+    { 0x8D07E33455637EB2ULL, 0xDB0B487B6423E1E8ULL }, { 0xB049DC016ABC5E5FULL, 0x91CE1A9A3D2CDA62ULL },
+    { 0xDC5C5301C56B75F7ULL, 0x7641A140CC7810FBULL }, { 0x89B9B3E11B6329BAULL, 0xA9E904C87FCB0A9DULL },
+    { 0xAC2820D9623BF429ULL, 0x546345FA9FBDCD44ULL }, { 0xD732290FBACAF133ULL, 0xA97C177947AD4095ULL },
+    { 0x867F59A9D4BED6C0ULL, 0x49ED8EABCCCC485DULL }, { 0xA81F301449EE8C70ULL, 0x5C68F256BFFF5A74ULL },
+    { 0xD226FC195C6A2F8CULL, 0x73832EEC6FFF3111ULL }, { 0x83585D8FD9C25DB7ULL, 0xC831FD53C5FF7EABULL },
+    { 0xA42E74F3D032F525ULL, 0xBA3E7CA8B77F5E55ULL }, { 0xCD3A1230C43FB26FULL, 0x28CE1BD2E55F35EBULL },
+    { 0x80444B5E7AA7CF85ULL, 0x7980D163CF5B81B3ULL }, { 0xA0555E361951C366ULL, 0xD7E105BCC332621FULL },
+    { 0xC86AB5C39FA63440ULL, 0x8DD9472BF3FEFAA7ULL }, { 0xFA856334878FC150ULL, 0xB14F98F6F0FEB951ULL },
+    { 0x9C935E00D4B9D8D2ULL, 0x6ED1BF9A569F33D3ULL }, { 0xC3B8358109E84F07ULL, 0x0A862F80EC4700C8ULL },
+    { 0xF4A642E14C6262C8ULL, 0xCD27BB612758C0FAULL }, { 0x98E7E9CCCFBD7DBDULL, 0x8038D51CB897789CULL },
+    { 0xBF21E44003ACDD2CULL, 0xE0470A63E6BD56C3ULL }, { 0xEEEA5D5004981478ULL, 0x1858CCFCE06CAC74ULL },
+    { 0x95527A5202DF0CCBULL, 0x0F37801E0C43EBC8ULL }, { 0xBAA718E68396CFFDULL, 0xD30560258F54E6BAULL },
+    { 0xE950DF20247C83FDULL, 0x47C6B82EF32A2069ULL }, { 0x91D28B7416CDD27EULL, 0x4CDC331D57FA5441ULL },
+    { 0xB6472E511C81471DULL, 0xE0133FE4ADF8E952ULL }, { 0xE3D8F9E563A198E5ULL, 0x58180FDDD97723A6ULL },
+    { 0x8E679C2F5E44FF8FULL, 0x570F09EAA7EA7648ULL }
+};
+
+/*
+ * Eisel-Lemire: w * 10^exp10 correctly rounded, or 0 if the 128-bit
+ * approximation cannot decide (near a halfway point, subnormal, overflow).
+ */
+static int lept_eisel_lemire(lept_u64 w, int exp10, int neg, lept_u64* bits) {
+    lept_u64 hi, lo, yhi, ylo, mantissa, exp2, msb;
+    int clz;
+    const lept_u64* pow10;
+    if (exp10 < LEPT_POW10_MIN || exp10 > LEPT_POW10_MAX)
+        return 0;
+    pow10 = lept_pow10_128[exp10 - LEPT_POW10_MIN];
+    clz = lept_clz64(w);
+    w <<= clz;
+    /* floor(log2(10^exp10)) is 217706 * exp10 >> 16; offset keeps the shift on non-negative values */
+    exp2 = (lept_u64)((217706L * exp10 + 65536L * 1200) >> 16) - 1200 + 64 + 1023 - clz;
+    hi = lept_mul64(w, pow10[0], &lo);
+    if ((hi & 0x1FF) == 0x1FF && lo + w < w) {
+        /* the truncated product might carry: widen with the low half of the power */
+        yhi = lept_mul64(w, pow10[1], &ylo);
+        if (lo + yhi < lo)
+            hi++;
+        lo += yhi;
+        if ((hi & 0x1FF) == 0x1FF && lo + 1 == 0 && ylo + w < w)
+            return 0;
+    }
+    msb = hi >> 63;
+    mantissa = hi >> (msb + 9);
+    exp2 -= 1 ^ msb;
+    if (lo == 0 && (hi & 0x1FF) == 0 && (mantissa & 3) == 1)
+        return 0; /* exactly halfway between two doubles */
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >> 53) {
+        mantissa >>= 1;
+        exp2++;
+    }
+    if (exp2 - 1 >= 0x7FF - 1)
+        return 0;
+    *bits = exp2 << 52 | (mantissa & ((LEPT_U64(1) << 52) - 1));
+    if (neg)
+        *bits |= LEPT_U64(1) << 63;
+    return 1;
+}
+
+/*
+ * Slow but exact fallback: the digits as an arbitrary-precision decimal,
+ * scaled by powers of two into [0.5, 1) and rounded (after Go's strconv).
+ */
+#define LEPT_DECIMAL_DIGITS 800
+#define LEPT_DECIMAL_MAX_SHIFT 60
+
+typedef struct {
+    char d[LEPT_DECIMAL_DIGITS];    /* digits, most significant first, as '0'..'9' */
+    int nd, dp;                     /* number of digits, position of the decimal point */
+    int trunc;                      /* nonzero digits were dropped beyond d[nd - 1] */
+}lept_decimal;
+
+static void lept_decimal_trim(lept_decimal* a) {
+    while (a->nd > 0 && a->d[a->nd - 1] == '0')
+        a->nd--;
+    if (a->nd == 0)
+        a->dp = 0;
+}
+
+static void lept_decimal_right_shift(lept_decimal* a, unsigned k) {
+    int r = 0, w = 0;
+    lept_u64 n = 0, mask = (LEPT_U64(1) << k) - 1;
+    for (; (n >> k) == 0; r++) {
+        if (r >= a->nd) {
+            if (n == 0) {
+                a->nd = 0;
+                return;
+            }
+            while ((n >> k) == 0) {
+                n *= 10;
+                r++;
+            }
+            break;
+        }
+        n = n * 10 + (lept_u64)(a->d[r] - '0');
+    }
+    a->dp -= r - 1;
+    for (; r < a->nd; r++) {
+        char ch = a->d[r];
+        a->d[w++] = (char)('0' + (int)(n >> k));
+        n &= mask;
+        n = n * 10 + (lept_u64)(ch - '0');
+    }
+    while (n > 0) {
+        int dig = (int)(n >> k);
+        n &= mask;
+        if (w < LEPT_DECIMAL_DIGITS)
+            a->d[w++] = (char)('0' + dig);
+        else if (dig > 0)
+            a->trunc = 1;
+        n *= 10;
+    }
+    a->nd = w;
+    lept_decimal_trim(a);
+}
+
+/* Shifting left by k adds delta digits, one fewer if the digits compare below 5^k. */
+static const struct { int delta; const char* cutoff; } lept_decimal_left_cheats[LEPT_DECIMAL_MAX_SHIFT + 1] = {
+    { 0, "" },
+    { 1, "5" },
+    { 1, "25" },
+    { 1, "125" },
+    { 2, "625" },
+    { 2, "3125" },
+    { 2, "15625" },
+    { 3, "78125" },
+    { 3, "390625" },
+    { 3, "1953125" },
+    { 4, "9765625" },
+    { 4, "48828125" },
+    { 4, "244140625" },
+    { 4, "1220703125" },
+    { 5, "6103515625" },
+    { 5, "30517578125" },
+    { 5, "152587890625" },
+    { 6, "762939453125" },
+    { 6, "3814697265625" },
+    { 6, "19073486328125" },
+    { 7, "95367431640625" },
+    { 7, "476837158203125" },
+    { 7, "2384185791015625" },
+    { 7, "11920928955078125" },
+    { 8, "59604644775390625" },
+    { 8, "298023223876953125" },
+    { 8, "1490116119384765625" },
+    { 9, "7450580596923828125" },
+    { 9, "37252902984619140625" },
+    { 9, "186264514923095703125" },
+    { 10, "931322574615478515625" },
+    { 10, "4656612873077392578125" },
+    { 10, "23283064365386962890625" },
+    { 10, "116415321826934814453125" },
+    { 11, "582076609134674072265625" },
+    { 11, "2910383045673370361328125" },
+    { 11, "14551915228366851806640625" },
+    { 12, "72759576141834259033203125" },
+    { 12, "363797880709171295166015625" },
+    { 12, "1818989403545856475830078125" },
+    { 13, "9094947017729282379150390625" },
+    { 13, "45474735088646411895751953125" },
+    { 13, "227373675443232059478759765625" },
+    { 13, "1136868377216160297393798828125" },
+    { 14, "5684341886080801486968994140625" },
+    { 14, "28421709430404007434844970703125" },
+    { 14, "142108547152020037174224853515625" },
+    { 15, "710542735760100185871124267578125" },
+    { 15, "3552713678800500929355621337890625" },
+    { 15, "17763568394002504646778106689453125" },
+    { 16, "88817841970012523233890533447265625" },
+    { 16, "444089209850062616169452667236328125" },
+    { 16, "2220446049250313080847263336181640625" },
+    { 16, "11102230246251565404236316680908203125" },
+    { 17, "55511151231257827021181583404541015625" },
+    { 17, "277555756156289135105907917022705078125" },
+    { 17, "1387778780781445675529539585113525390625" },
+    { 18, "6938893903907228377647697925567626953125" },
+    { 18, "34694469519536141888238489627838134765625" },
+    { 18, "173472347597680709441192448139190673828125" },
+    { 19, "867361737988403547205962240695953369140625" }
+};
+
+static void lept_decimal_left_shift(lept_decimal* a, unsigned k) {
+    const char* cutoff = lept_decimal_left_cheats[k].cutoff;
+    int i, r, w, delta = lept_decimal_left_cheats[k].delta;
+    lept_u64 n = 0;
+    for (i = 0; cutoff[i]; i++) {
+        if (i >= a->nd || a->d[i] != cutoff[i]) {
+            if (i >= a->nd || a->d[i] < cutoff[i])
+                delta--;
+            break;
+        }
+    }
+    w = a->nd + delta;
+    for (r = a->nd - 1; r >= 0; r--) {
+        n += (lept_u64)(a->d[r] - '0') << k;
+        if (--w < LEPT_DECIMAL_DIGITS)
+            a->d[w] = (char)('0' + (int)(n % 10));
+        else if (n % 10 != 0)
+            a->trunc = 1;
+        n /= 10;
+    }
+    while (n > 0) {
+        if (--w < LEPT_DECIMAL_DIGITS)
+            a->d[w] = (char)('0' + (int)(n % 10));
+        else if (n % 10 != 0)
+            a->trunc = 1;
+        n /= 10;
+    }
+    a->nd += delta;
+    if (a->nd >= LEPT_DECIMAL_DIGITS)
+        a->nd = LEPT_DECIMAL_DIGITS;
+    a->dp += delta;
+    lept_decimal_trim(a);
+}
+
+static void lept_decimal_shift(lept_decimal* a, int k) {
+    if (a->nd == 0)
+        return;
+    for (; k > LEPT_DECIMAL_MAX_SHIFT; k -= LEPT_DECIMAL_MAX_SHIFT)
+        lept_decimal_left_shift(a, LEPT_DECIMAL_MAX_SHIFT);
+    for (; k < -LEPT_DECIMAL_MAX_SHIFT; k += LEPT_DECIMAL_MAX_SHIFT)
+        lept_decimal_right_shift(a, LEPT_DECIMAL_MAX_SHIFT);
+    if (k > 0)
+        lept_decimal_left_shift(a, (unsigned)k);
+    else if (k < 0)
+        lept_decimal_right_shift(a, (unsigned)-k);
+}
+
+static lept_u64 lept_decimal_rounded_integer(const lept_decimal* a) {
+    int i, up;
+    lept_u64 n = 0;
+    if (a->dp > 20)
+        return ~(lept_u64)0;
+    for (i = 0; i < a->dp && i < a->nd; i++)
+        n = n * 10 + (lept_u64)(a->d[i] - '0');
+    for (; i < a->dp; i++)
+        n *= 10;
+    if (a->dp < 0 || a->dp >= a->nd)
+        up = 0;
+    else if (a->d[a->dp] == '5' && a->dp + 1 == a->nd) /* exactly halfway: round to even */
+        up = a->trunc || (a->dp > 0 && (a->d[a->dp - 1] - '0') % 2 == 1);
+    else
+        up = a->d[a->dp] >= '5';
+    return n + up;
+}
+
+/* Bits of the double nearest to the JSON number text [p, end), already validated. */
+static lept_u64 lept_decimal_to_bits(const char* p, const char* end) {
+    static const int powtab[] = { 1, 3, 6, 9, 13, 16, 19, 23, 26 };
+    lept_decimal a;
+    lept_u64 mantissa, sign = 0;
+    int exp2 = 0, e = 0, eneg = 0, n, sawdot = 0;
+    a.nd = a.dp = a.trunc = 0;
+    if (*p == '-') {
+        sign = LEPT_U64(1) << 63;
+        p++;
+    }
+    for (; p < end && (ISDIGIT(*p) || *p == '.'); p++) {
+        if (*p == '.') {
+            sawdot = 1;
+            a.dp = a.nd;
+        }
+        else if (*p == '0' && a.nd == 0) /* leading zeros only move the decimal point */
+            a.dp--;
+        else if (a.nd < LEPT_DECIMAL_DIGITS)
+            a.d[a.nd++] = *p;
+        else if (*p != '0')
+            a.trunc = 1;
+    }
+    if (!sawdot)
+        a.dp = a.nd;
+    if (p < end) { /* exponent */
+        p++;
+        if (*p == '+' || *p == '-')
+            eneg = *p++ == '-';
+        for (; p < end; p++)
+            if (e < 10000)
+                e = e * 10 + (*p - '0');
+        a.dp += eneg ? -e : e;
+    }
+
+    if (a.nd == 0 || a.dp < -330)
+        return sign; /* zero, or underflows to zero */
+    if (a.dp > 310)
+        return sign | (LEPT_U64(0x7FF) << 52); /* overflows to infinity */
+    /* scale by powers of two into [0.5, 1) */
+    while (a.dp > 0) {
+        n = a.dp >= 9 ? 27 : powtab[a.dp];
+        lept_decimal_shift(&a, -n);
+        exp2 += n;
+    }
+    while (a.dp < 0 || (a.dp == 0 && a.d[0] < '5')) {
+        n = -a.dp >= 9 ? 27 : powtab[-a.dp];
+        lept_decimal_shift(&a, n);
+        exp2 -= n;
+    }
+    exp2--; /* [0.5, 1) is [1, 2) * 2^-1 */
+    if (exp2 < -1022) { /* subnormal: denormalize */
+        lept_decimal_shift(&a, exp2 + 1022);
+        exp2 = -1022;
+    }
+    if (exp2 > 1023)
+        return sign | (LEPT_U64(0x7FF) << 52);
+    lept_decimal_shift(&a, 53);
+    mantissa = lept_decimal_rounded_integer(&a);
+    if (mantissa == LEPT_U64(1) << 53) { /* rounding carried into a new bit */
+        mantissa >>= 1;
+        if (++exp2 > 1023)
+            return sign | (LEPT_U64(0x7FF) << 52);
+    }
+    if (!(mantissa & (LEPT_U64(1) << 52)))
+        exp2 = -1023; /* subnormal */
+    return sign | ((lept_u64)(exp2 + 1023) << 52) | (mantissa & ((LEPT_U64(1) << 52) - 1));
+}
+
+static const double lept_exact_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * w * 10^exp10 (w holding the first 19 significant digits of [p, end),
+ * trunc set if nonzero digits followed), correctly rounded.
+ */
+static double lept_number_to_double(const char* p, const char* end, lept_u64 w, int exp10, int neg, int trunc) {
+    lept_u64 bits, bits2;
+    if (w == 0)
+        return neg ? -0.0 : 0.0;
+#if !defined(__FLT_EVAL_METHOD__) || __FLT_EVAL_METHOD__ == 0
+    /* Clinger's fast path: both operands exact, so one IEEE operation rounds correctly */
+    if (!trunc && w <= (LEPT_U64(1) << 53) && exp10 >= -22 && exp10 <= 22) {
+        double d = (double)w;
+        d = exp10 < 0 ? d / lept_exact_pow10[-exp10] : d * lept_exact_pow10[exp10];
+        return neg ? -d : d;
+    }
+#endif
+    if (lept_eisel_lemire(w, exp10, neg, &bits)) {
+        /* with dropped digits the value lies in [w, w + 1) * 10^exp10: both ends must agree */
+        if (!trunc || (lept_eisel_lemire(w + 1, exp10, neg, &bits2) && bits == bits2))
+            return lept_double_from_bits(bits);
+    }
+    return lept_double_from_bits(lept_decimal_to_bits(p, end));
+}
+
+/* Validates the number grammar while collecting the first 19 significant digits into w. */
 static int lept_parse_number(lept_context* c, lept_value* v) {
-    const char* p = c->json;
-    if (*p == '-') p++;
-    if (*p == '0') p++;
+    const char *p = c->json, *end = c->end;
+    lept_u64 w = 0;
+    int digits = 0, exp10 = 0, neg = 0, trunc = 0;
+    if (CHAR_AT(p, end) == '-') {
+        neg = 1;
+        p++;
+    }
+    if (CHAR_AT(p, end) == '0') p++;
     else {
-        if (!ISDIGIT1TO9(*p)) return LEPT_PARSE_INVALID_VALUE;
-        for (p++; ISDIGIT(*p); p++);
+        if (!ISDIGIT1TO9(CHAR_AT(p, end))) return LEPT_PARSE_INVALID_VALUE;
+        for (; ISDIGIT(CHAR_AT(p, end)); p++) {
+            if (digits < 19) {
+                w = w * 10 + (unsigned)(*p - '0');
+                digits++;
+            }
+            else {
+                exp10++;
+                trunc |= *p != '0';
+            }
+        }
     }
-    if (*p == '.') {
+    if (CHAR_AT(p, end) == '.') {
         p++;
-        if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
-        for (p++; ISDIGIT(*p); p++);
+        if (!ISDIGIT(CHAR_AT(p, end))) return LEPT_PARSE_INVALID_VALUE;
+        for (; ISDIGIT(CHAR_AT(p, end)); p++) {
+            if (digits < 19) {
+                if (w == 0 && *p == '0') { /* leading zeros of 0.00ddd */
+                    exp10--;
+                    continue;
+                }
+                w = w * 10 + (unsigned)(*p - '0');
+                digits++;
+                exp10--;
+            }
+            else
+                trunc |= *p != '0';
+        }
     }
-    if (*p == 'e' || *p == 'E') {
+    if (CHAR_AT(p, end) == 'e' || CHAR_AT(p, end) == 'E') {
+        int e = 0, eneg = 0;
         p++;
-        if (*p == '+' || *p == '-') p++;
-        if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
-        for (p++; ISDIGIT(*p); p++);
+        if (CHAR_AT(p, end) == '+' || CHAR_AT(p, end) == '-')
+            eneg = *p++ == '-';
+        if (!ISDIGIT(CHAR_AT(p, end))) return LEPT_PARSE_INVALID_VALUE;
+        for (; ISDIGIT(CHAR_AT(p, end)); p++)
+            if (e < 100000) /* far beyond any double; avoids overflow */
+                e = e * 10 + (*p - '0');
+        exp10 += eneg ? -e : e;
+    }
+    /* the value lies in [10^(digits - 1), 10^digits) * 10^exp10: only near DBL_MAX is conversion needed to tell */
+    if (c->validate && (w == 0 || digits + exp10 != 309)) {
+        if (w != 0 && digits + exp10 > 309)
+            return LEPT_PARSE_NUMBER_TOO_BIG;
+        v->u.n = 0.0;
+        v->type = LEPT_NUMBER;
+        c->json = p;
+        return LEPT_PARSE_OK;
     }
-    errno = 0;
-    v->u.n = strtod(c->json, NULL);
-    if (errno == ERANGE && (v->u.n == HUGE_VAL || v->u.n == -HUGE_VAL))
+    v->u.n = lept_number_to_double(c->json, p, w, exp10, neg, trunc);
+    if (v->u.n == HUGE_VAL || v->u.n == -HUGE_VAL)
         return LEPT_PARSE_NUMBER_TOO_BIG;
     v->type = LEPT_NUMBER;
     c->json = p;
     return LEPT_PARSE_OK;
 }
 
-static const char* lept_parse_hex4(const char* p, unsigned* u) {
-    int i;
-    *u = 0;
-    for (i = 0; i < 4; i++) {
-        char ch = *p++;
-        *u <<= 4;
-        if      (ch >= '0' && ch <= '9')  *u |= ch - '0';
-        else if (ch >= 'A' && ch <= 'F')  *u |= ch - ('A' - 10);
-        else if (ch >= 'a' && ch <= 'f')  *u |= ch - ('a' - 10);
-        else return NULL;
-    }
-    return p;
+static const char* lept_parse_hex4(const char* p, const char* end, unsigned* u) {
+    int i;
+    *u = 0;
+    if (end - p < 4)
+        return NULL;
+    for (i = 0; i < 4; i++) {
+        char ch = *p++;
+        *u <<= 4;
+        if      (ch >= '0' && ch <= '9')  *u |= ch - '0';
+        else if (ch >= 'A' && ch <= 'F')  *u |= ch - ('A' - 10);
+        else if (ch >= 'a' && ch <= 'f')  *u |= ch - ('a' - 10);
+        else return NULL;
+    }
+    return p;
+}
+
+/* Writes u as 1 to 4 UTF-8 bytes and returns the count. */
+static size_t lept_encode_utf8(char* out, unsigned u) {
+    if (u <= 0x7F) {
+        out[0] = (char)(u & 0xFF);
+        return 1;
+    }
+    else if (u <= 0x7FF) {
+        out[0] = (char)(0xC0 | ((u >> 6) & 0xFF));
+        out[1] = (char)(0x80 | ( u       & 0x3F));
+        return 2;
+    }
+    else if (u <= 0xFFFF) {
+        out[0] = (char)(0xE0 | ((u >> 12) & 0xFF));
+        out[1] = (char)(0x80 | ((u >>  6) & 0x3F));
+        out[2] = (char)(0x80 | ( u        & 0x3F));
+        return 3;
+    }
+    else {
+        assert(u <= 0x10FFFF);
+        out[0] = (char)(0xF0 | ((u >> 18) & 0xFF));
+        out[1] = (char)(0x80 | ((u >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((u >>  6) & 0x3F));
+        out[3] = (char)(0x80 | ( u        & 0x3F));
+        return 4;
+    }
+}
+
+/*
+ * Decodes the escape following a backslash at *p into out (at most 4 bytes)
+ * and advances *p past it. The output is never longer than the escape, and
+ * out is only written after the whole escape has been read, so out may
+ * trail *p inside the same buffer.
+ */
+static int lept_parse_escape(const char** p, const char* end, char* out, size_t* len) {
+    const char* q = *p;
+    unsigned u, u2;
+    *len = 1;
+    if (q == end)
+        return LEPT_PARSE_INVALID_STRING_ESCAPE;
+    switch (*q++) {
+        case '\"': *out = '\"'; break;
+        case '\\': *out = '\\'; break;
+        case '/':  *out = '/' ; break;
+        case 'b':  *out = '\b'; break;
+        case 'f':  *out = '\f'; break;
+        case 'n':  *out = '\n'; break;
+        case 'r':  *out = '\r'; break;
+        case 't':  *out = '\t'; break;
+        case 'u':
+            if (!(q = lept_parse_hex4(q, end, &u)))
+                return LEPT_PARSE_INVALID_UNICODE_HEX;
+            if (u >= 0xD800 && u <= 0xDBFF) { /* surrogate pair */
+                if (end - q < 2 || *q++ != '\\')
+                    return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                if (*q++ != 'u')
+                    return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                if (!(q = lept_parse_hex4(q, end, &u2)))
+                    return LEPT_PARSE_INVALID_UNICODE_HEX;
+                if (u2 < 0xDC00 || u2 > 0xDFFF)
+                    return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
+            }
+            *len = lept_encode_utf8(out, u);
+            break;
+        default:
+            return LEPT_PARSE_INVALID_STRING_ESCAPE;
+    }
+    *p = q;
+    return LEPT_PARSE_OK;
+}
+
+#define STRING_ERROR(ret) do { c->top = head; return ret; } while(0)
+
+static int lept_parse_string_raw(lept_context* c, char** str, size_t* len) {
+    size_t head = c->top, n;
+    const char* p;
+    char buf[4];
+    int ret;
+    EXPECT(c, '\"');
+    p = c->json;
+    for (;;) {
+        char ch;
+        const char* q = lept_scan_string(p, c->end); /* copy the clean run up to the next '"', '\\' or control byte at once */
+        if (q != p) {
+            PUTS(c, p, (size_t)(q - p));
+            p = q;
+        }
+        if (p == c->end)
+            STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
+        switch (ch = *p++) {
+            case '\"':
+                *len = c->top - head;
+                *str = lept_context_pop(c, *len);
+                c->json = p;
+                return LEPT_PARSE_OK;
+            case '\\':
+                if ((ret = lept_parse_escape(&p, c->end, buf, &n)) != LEPT_PARSE_OK)
+                    STRING_ERROR(ret);
+                LEPT_STAT(c, escapes_in++);
+                PUTS(c, buf, n);
+                break;
+            default: /* lept_scan_string() stops on nothing else */
+                assert((unsigned char)ch < 0x20);
+                STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
+        }
+    }
+}
+
+/* As lept_parse_string_raw(), but decodes into the (mutable) input itself and terminates the result there. */
+static int lept_parse_string_insitu(lept_context* c, char** str, size_t* len) {
+    char *head, *w;
+    const char* p;
+    size_t n;
+    int ret;
+    EXPECT(c, '\"');
+    p = c->json;
+    head = w = (char*)p;
+    for (;;) {
+        char ch;
+        const char* q = lept_scan_string(p, c->end);
+        if (q != p) {
+            if (w != p)
+                memmove(w, p, (size_t)(q - p));
+            w += q - p;
+            p = q;
+        }
+        if (p == c->end)
+            return LEPT_PARSE_MISS_QUOTATION_MARK;
+        switch (ch = *p++) {
+            case '\"':
+                *w = '\0';
+                *len = (size_t)(w - head);
+                *str = head;
+                c->json = p;
+                return LEPT_PARSE_OK;
+            case '\\':
+                if ((ret = lept_parse_escape(&p, c->end, w, &n)) != LEPT_PARSE_OK)
+                    return ret;
+                LEPT_STAT(c, escapes_in++);
+                w += n;
+                break;
+            default:
+                assert((unsigned char)ch < 0x20);
+                return LEPT_PARSE_INVALID_STRING_CHAR;
+        }
+    }
+}
+
+/* As lept_parse_string_raw(), but decodes nothing: for lept_parse_lazy(), which reads strings again later. */
+static int lept_parse_string_validate(lept_context* c, char** str, size_t* len) {
+    const char* p;
+    char buf[4];
+    size_t n;
+    int ret;
+    EXPECT(c, '\"');
+    for (p = c->json;; ) {
+        p = lept_scan_string(p, c->end);
+        if (p == c->end)
+            return LEPT_PARSE_MISS_QUOTATION_MARK;
+        switch (*p++) {
+            case '\"':
+                *str = NULL;
+                *len = 0;
+                c->json = p;
+                return LEPT_PARSE_OK;
+            case '\\':
+                if ((ret = lept_parse_escape(&p, c->end, buf, &n)) != LEPT_PARSE_OK)
+                    return ret;
+                break;
+            default:
+                return LEPT_PARSE_INVALID_STRING_CHAR;
+        }
+    }
+}
+
+static int lept_parse_string(lept_context* c, char** str, size_t* len) {
+    if (c->validate)
+        return lept_parse_string_validate(c, str, len);
+    return c->insitu ? lept_parse_string_insitu(c, str, len) : lept_parse_string_raw(c, str, len);
+}
+
+#define LEPT_NEST_BITS  (sizeof(unsigned long) * 8)
+#define LEPT_EVENT(h, fn, args) \
+    do { if ((h)->fn && !(h)->fn args) return LEPT_PARSE_STOPPED; } while(0)
+
+/*
+ * The grammar, as a loop that reports what it reads to h. Open containers
+ * are one bit each (set: object), so nesting needs no C recursion and no
+ * allocation; lept_context_init() keeps max_depth within LEPT_PARSE_MAX_DEPTH.
+ */
+static int lept_parse_events(lept_context* c, const lept_handler* h, void* user) {
+    unsigned long nest[(LEPT_PARSE_MAX_DEPTH + LEPT_NEST_BITS - 1) / LEPT_NEST_BITS + 1];
+    size_t depth = 0, len;
+    lept_value e;
+    char* str;
+    int ret, object;
+
+value:
+    switch (PEEK(c)) {
+        case 't':
+            if ((ret = lept_parse_literal(c, &e, "true", LEPT_TRUE)) != LEPT_PARSE_OK)
+                return ret;
+            LEPT_EVENT(h, on_bool, (user, 1));
+            break;
+        case 'f':
+            if ((ret = lept_parse_literal(c, &e, "false", LEPT_FALSE)) != LEPT_PARSE_OK)
+                return ret;
+            LEPT_EVENT(h, on_bool, (user, 0));
+            break;
+        case 'n':
+            if ((ret = lept_parse_literal(c, &e, "null", LEPT_NULL)) != LEPT_PARSE_OK)
+                return ret;
+            LEPT_EVENT(h, on_null, (user));
+            break;
+        default:
+            if ((ret = lept_parse_number(c, &e)) != LEPT_PARSE_OK)
+                return ret;
+            LEPT_EVENT(h, on_number, (user, e.u.n));
+            break;
+        case '"':
+            if ((ret = lept_parse_string(c, &str, &len)) != LEPT_PARSE_OK)
+                return ret;
+            LEPT_EVENT(h, on_string, (user, str, len));
+            break;
+        case '\0':
+            return c->json == c->end ? LEPT_PARSE_EXPECT_VALUE : LEPT_PARSE_INVALID_VALUE;
+        case '[':
+        case '{':
+            if (depth == c->max_depth)
+                return LEPT_PARSE_TOO_DEEP;
+            if ((object = *c->json++ == '{') != 0) {
+                nest[depth / LEPT_NEST_BITS] |= 1UL << depth % LEPT_NEST_BITS;
+                LEPT_EVENT(h, on_start_object, (user));
+            }
+            else {
+                nest[depth / LEPT_NEST_BITS] &= ~(1UL << depth % LEPT_NEST_BITS);
+                LEPT_EVENT(h, on_start_array, (user));
+            }
+            depth++;
+            lept_parse_whitespace(c);
+            if (PEEK(c) == (object ? '}' : ']')) {
+                c->json++;
+                goto close;
+            }
+            if (object)
+                goto key;
+            goto value;
+    }
+
+next: /* a value is complete: what follows depends on the innermost container */
+    if (depth == 0)
+        return LEPT_PARSE_OK;
+    object = (nest[(depth - 1) / LEPT_NEST_BITS] >> (depth - 1) % LEPT_NEST_BITS) & 1;
+    lept_parse_whitespace(c);
+    if (PEEK(c) == ',') {
+        c->json++;
+        lept_parse_whitespace(c);
+        if (object)
+            goto key;
+        goto value;
+    }
+    if (PEEK(c) == (object ? '}' : ']')) {
+        c->json++;
+        goto close;
+    }
+    return object ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+
+key:
+    if (PEEK(c) != '"')
+        return LEPT_PARSE_MISS_KEY;
+    if ((ret = lept_parse_string(c, &str, &len)) != LEPT_PARSE_OK)
+        return ret;
+    LEPT_EVENT(h, on_key, (user, str, len));
+    lept_parse_whitespace(c);
+    if (PEEK(c) != ':')
+        return LEPT_PARSE_MISS_COLON;
+    c->json++;
+    lept_parse_whitespace(c);
+    goto value;
+
+close:
+    depth--;
+    if ((nest[depth / LEPT_NEST_BITS] >> depth % LEPT_NEST_BITS) & 1)
+        LEPT_EVENT(h, on_end_object, (user));
+    else
+        LEPT_EVENT(h, on_end_array, (user));
+    goto next;
+}
+
+static size_t lept_hash_key(const char* key, size_t klen) {
+    size_t i, h = 2166136261u; /* FNV-1a */
+    for (i = 0; i < klen; i++)
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    return h;
+}
+
+/*
+ * Intern pool: an open-addressing table of keys whose bytes live in an arena,
+ * so they never move and are released only with the pool.
+ */
+typedef struct {
+    const char* k;
+    size_t klen;
+}lept_intern_slot;
+
+struct lept_intern_pool {
+    lept_intern_slot* slots;
+    size_t mask, count, max_keys;   /* capacity - 1, keys held, limit on keys held */
+    lept_arena_block* arena;
+    lept_lock lock;
+    const lept_allocator* alloc;
+};
+
+#define LEPT_INTERN_INIT_SIZE 64
+
+lept_intern_pool* lept_intern_pool_new(size_t max_keys, const lept_lock* lock, const lept_allocator* a) {
+    lept_intern_pool* p;
+    a = LEPT_ALLOCATOR(a);
+    p = (lept_intern_pool*)LEPT_MALLOC(a, sizeof(lept_intern_pool));
+    p->slots = (lept_intern_slot*)LEPT_MALLOC(a, LEPT_INTERN_INIT_SIZE * sizeof(lept_intern_slot));
+    memset(p->slots, 0, LEPT_INTERN_INIT_SIZE * sizeof(lept_intern_slot));
+    p->mask = LEPT_INTERN_INIT_SIZE - 1;
+    p->count = 0;
+    p->max_keys = max_keys;
+    p->arena = NULL;
+    if (lock)
+        p->lock = *lock;
+    else
+        p->lock.lock_fn = p->lock.unlock_fn = NULL;
+    p->alloc = a;
+    return p;
+}
+
+static void lept_intern_grow(lept_intern_pool* p) {
+    size_t i, j, capacity = (p->mask + 1) * 2;
+    lept_intern_slot* slots = (lept_intern_slot*)LEPT_MALLOC(p->alloc, capacity * sizeof(lept_intern_slot));
+    memset(slots, 0, capacity * sizeof(lept_intern_slot));
+    for (i = 0; i <= p->mask; i++)
+        if (p->slots[i].k) {
+            for (j = lept_hash_key(p->slots[i].k, p->slots[i].klen) & (capacity - 1); slots[j].k; j = (j + 1) & (capacity - 1))
+                ;
+            slots[j] = p->slots[i];
+        }
+    LEPT_FREE(p->alloc, p->slots);
+    p->slots = slots;
+    p->mask = capacity - 1;
+}
+
+const char* lept_intern(lept_intern_pool* p, const char* key, size_t klen) {
+    const char* k = NULL;
+    size_t i;
+    assert(p != NULL && (key != NULL || klen == 0));
+    if (p->lock.lock_fn)
+        p->lock.lock_fn(p->lock.user);
+    for (i = lept_hash_key(key, klen) & p->mask; p->slots[i].k; i = (i + 1) & p->mask)
+        if (p->slots[i].klen == klen && memcmp(p->slots[i].k, key, klen) == 0) {
+            k = p->slots[i].k;
+            break;
+        }
+    if (!k && p->count < p->max_keys) {
+        char* copy = (char*)lept_arena_alloc(&p->arena, p->alloc, klen + 1);
+        if (klen)
+            memcpy(copy, key, klen);
+        copy[klen] = '\0';
+        p->slots[i].k = k = copy;
+        p->slots[i].klen = klen;
+        if (++p->count * 2 > p->mask)
+            lept_intern_grow(p);
+    }
+    if (p->lock.unlock_fn)
+        p->lock.unlock_fn(p->lock.user);
+    return k;
+}
+
+size_t lept_intern_pool_size(lept_intern_pool* p) {
+    size_t count;
+    assert(p != NULL);
+    if (p->lock.lock_fn)
+        p->lock.lock_fn(p->lock.user);
+    count = p->count;
+    if (p->lock.unlock_fn)
+        p->lock.unlock_fn(p->lock.user);
+    return count;
+}
+
+void lept_intern_pool_free(lept_intern_pool* p) {
+    lept_arena_block* b;
+    assert(p != NULL);
+    while ((b = p->arena) != NULL) {
+        p->arena = b->next;
+        LEPT_FREE(p->alloc, b);
+    }
+    LEPT_FREE(p->alloc, p->slots);
+    LEPT_FREE(p->alloc, p);
+}
+
+/*
+ * lept_parse() is lept_parse_events() with this handler. An open array or
+ * object is a frame on the parse stack, directly below the elements or
+ * members parsed so far; closing it moves them into a value of their own.
+ */
+#if LEPT_COMPACT
+#pragma pack(push, 4) /* frames follow 28-byte members on the stack */
+#endif
+typedef struct {
+    size_t parent;          /* stack offset of the enclosing frame */
+    char* k; lept_length klen;  /* object: key of the member whose value is being parsed, if k or klen */
+    lept_type type;
+}lept_frame;
+#if LEPT_COMPACT
+#pragma pack(pop)
+#endif
+
+typedef struct {
+    lept_context* c;
+    lept_value* root;
+    size_t frame, depth;    /* innermost open frame, number of open frames */
+}lept_builder;
+
+#define LEPT_FRAME(c, offset) ((lept_frame*)((c)->stack + (offset)))
+
+static void lept_frame_free(lept_context* c, size_t frame) {
+    lept_frame* f = LEPT_FRAME(c, frame);
+    size_t i = frame + sizeof(lept_frame);
+    if (f->type == LEPT_ARRAY)
+        for (; i < c->top; i += sizeof(lept_value))
+            lept_context_free(c, (lept_value*)(c->stack + i));
+    else {
+        if (f->k || f->klen)
+            lept_context_free_key(c, f->k, f->klen);
+        for (; i < c->top; i += sizeof(lept_member)) {
+            lept_member* m = (lept_member*)(c->stack + i);
+            lept_context_free_key(c, m->k, m->klen);
+            lept_context_free(c, &m->v);
+        }
+    }
+}
+
+/* Hands a complete value to the innermost open container, or makes it the root. */
+static int lept_build_value(lept_builder* b, const lept_value* e) {
+    lept_context* c = b->c;
+    lept_frame* f;
+    LEPT_STAT(c, nodes[e->type]++);
+    if (b->depth == 0) {
+        *b->root = *e;
+        return 1;
+    }
+    f = LEPT_FRAME(c, b->frame);
+    if (f->type == LEPT_ARRAY)
+        memcpy(lept_context_push(c, sizeof(lept_value)), e, sizeof(lept_value));
+    else {
+        lept_member* m = (lept_member*)lept_context_push(c, sizeof(lept_member));
+        f = LEPT_FRAME(c, b->frame); /* the push may have moved the stack */
+        memcpy(&m->k, &f->k, sizeof(m->k)); /* a pointer or an inline key */
+        m->klen = f->klen;
+        m->v = *e;
+        f->k = NULL; /* ownership is transferred to member on stack */
+        f->klen = 0;
+    }
+    return 1;
+}
+
+static int lept_build_null(void* user) {
+    lept_value e;
+    lept_init(&e);
+    return lept_build_value((lept_builder*)user, &e);
+}
+
+static int lept_build_bool(void* user, int b) {
+    lept_value e;
+    lept_init(&e);
+    e.type = b ? LEPT_TRUE : LEPT_FALSE;
+    return lept_build_value((lept_builder*)user, &e);
+}
+
+static int lept_build_number(void* user, double n) {
+    lept_value e;
+    lept_init(&e);
+    e.u.n = n;
+    e.type = LEPT_NUMBER;
+    return lept_build_value((lept_builder*)user, &e);
+}
+
+/* s is NUL-terminated inside the input when parsing in situ */
+static char* lept_build_string_copy(lept_context* c, const char* s, size_t len) {
+    return c->insitu ? (char*)s : lept_context_strdup(c, s, len);
+}
+
+static int lept_build_string(void* user, const char* s, size_t len) {
+    lept_builder* b = (lept_builder*)user;
+    lept_value e;
+    e.type = LEPT_STRING;
+    if (b->c->insitu || !lept_string_inline(&e, s, len)) {
+        e.u.s.s = lept_build_string_copy(b->c, s, len);
+        e.u.s.len = len;
+        e.flags = b->c->insitu ? LEPT_BORROWED : 0;
+    }
+    return lept_build_value(b, &e);
+}
+
+static int lept_build_start(lept_builder* b, lept_type type) {
+    lept_frame* f;
+    size_t frame = b->c->top;
+    f = (lept_frame*)lept_context_push(b->c, sizeof(lept_frame));
+    f->parent = b->frame;
+    f->k = NULL;
+    f->klen = 0;
+    f->type = type;
+    b->frame = frame;
+    b->depth++;
+    LEPT_STAT_MAX(b->c, max_depth, b->depth);
+    return 1;
+}
+
+static int lept_build_start_array(void* user) {
+    return lept_build_start((lept_builder*)user, LEPT_ARRAY);
+}
+
+static int lept_build_start_object(void* user) {
+    return lept_build_start((lept_builder*)user, LEPT_OBJECT);
+}
+
+static int lept_build_key(void* user, const char* k, size_t klen) {
+    lept_builder* b = (lept_builder*)user;
+    lept_frame* f = LEPT_FRAME(b->c, b->frame);
+    if (b->c->intern && !b->c->insitu && (f->k = (char*)lept_intern(b->c->intern, k, klen)) != NULL)
+        f->klen = (lept_length)klen | LEPT_KEY_SHARED;
+    else if (b->c->insitu || !lept_key_inline((char*)&f->k, &f->klen, k, klen)) {
+        f->k = lept_build_string_copy(b->c, k, klen);
+        f->klen = klen;
+    }
+    return 1;
+}
+
+/* Moves the children of the innermost frame into a value of their own. */
+static int lept_build_end(void* user) {
+    lept_builder* b = (lept_builder*)user;
+    lept_context* c = b->c;
+    lept_frame* f = LEPT_FRAME(c, b->frame);
+    size_t n = c->top - b->frame - sizeof(lept_frame);
+    lept_value e;
+    e.type = f->type;
+    e.flags = 0;
+    if (f->type == LEPT_ARRAY) {
+        e.u.a.size = n / sizeof(lept_value);
+        e.u.a.e = n ? (lept_value*)lept_context_alloc(c, n) : NULL;
+        if (n)
+            memcpy(e.u.a.e, f + 1, n);
+    }
+    else {
+        e.u.o.size = n / sizeof(lept_member);
+        e.u.o.m = n ? lept_context_alloc_members(c, e.u.o.size) : NULL;
+        if (n)
+            memcpy(e.u.o.m, f + 1, n);
+        if (c->insitu)
+            e.flags = LEPT_BORROWED; /* keys */
+    }
+    c->top = b->frame;
+    b->frame = f->parent;
+    b->depth--;
+    return lept_build_value(b, &e);
+}
+
+/* Pops and frees every open container after an error. */
+static void lept_builder_unwind(lept_builder* b) {
+    for (; b->depth > 0; b->depth--) {
+        size_t parent = LEPT_FRAME(b->c, b->frame)->parent;
+        lept_frame_free(b->c, b->frame);
+        b->c->top = b->frame;
+        b->frame = parent;
+    }
+}
+
+static const lept_handler lept_builder_handler = {
+    lept_build_null, lept_build_bool, lept_build_number, lept_build_string,
+    lept_build_start_object, lept_build_key, lept_build_end,
+    lept_build_start_array, lept_build_end
+};
+
+static int lept_parse_root(lept_context* c, lept_value* v) {
+    lept_builder b;
+    int ret;
+    lept_init(v);
+    b.c = c;
+    b.root = v;
+    b.frame = b.depth = 0;
+    lept_parse_whitespace(c);
+    if ((ret = lept_parse_events(c, &lept_builder_handler, &b)) == LEPT_PARSE_OK) {
+        lept_parse_whitespace(c);
+        if (c->json != c->end) {
+            lept_context_free(c, v);
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+        }
+    }
+    else
+        lept_builder_unwind(&b);
+    assert(c->top == 0);
+    return ret;
+}
+
+static void lept_context_init(lept_context* c, const char* json, size_t len, const lept_allocator* a) {
+    c->json = json;
+    c->end = json + len;
+    c->stack = NULL;
+    c->size = c->top = c->peak = 0;
+    c->alloc = LEPT_ALLOCATOR(a);
+    c->arena = NULL;
+    c->max_depth = LEPT_PARSE_MAX_DEPTH;
+    c->insitu = c->validate = 0;
+    c->intern = NULL;
+    c->write_fn = NULL;
+    c->write_user = NULL;
+    c->chunk = 0;
+    c->status = 0;
+#if LEPT_STATS
+    c->stats = NULL;
+#endif
+}
+
+static int lept_parse_once(lept_context* c, lept_value* v) {
+    int ret = lept_parse_root(c, v);
+    if (c->stack)
+        LEPT_FREE(c->alloc, c->stack);
+    return ret;
+}
+
+int lept_parse(lept_value* v, const char* json) {
+    return lept_parse_ex(v, json, NULL);
+}
+
+#if LEPT_STATS
+int lept_parse_stats(lept_value* v, const char* json, lept_stats* s) {
+    lept_context c;
+    clock_t start = clock();
+    int ret;
+    assert(v != NULL && json != NULL && s != NULL);
+    lept_context_init(&c, json, strlen(json), NULL);
+    c.stats = s;
+    ret = lept_parse_once(&c, v);
+    s->parse_seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+    s->bytes_in += (size_t)(c.json - json);
+    LEPT_STAT_MAX(&c, stack_peak, c.peak);
+    return ret;
+}
+#endif
+
+int lept_parse_ex(lept_value* v, const char* json, const lept_allocator* a) {
+    assert(json != NULL);
+    return lept_parse_n_ex(v, json, strlen(json), a);
+}
+
+int lept_parse_n(lept_value* v, const char* json, size_t len) {
+    return lept_parse_n_ex(v, json, len, NULL);
+}
+
+int lept_parse_n_ex(lept_value* v, const char* json, size_t len, const lept_allocator* a) {
+    lept_context c;
+    assert(v != NULL && json != NULL);
+    lept_context_init(&c, json, len, a);
+    return lept_parse_once(&c, v);
+}
+
+int lept_parse_sax(const char* json, size_t len, const lept_handler* h, void* user) {
+    return lept_parse_sax_ex(json, len, h, user, NULL);
+}
+
+int lept_parse_sax_ex(const char* json, size_t len, const lept_handler* h, void* user, const lept_allocator* a) {
+    lept_context c;
+    int ret;
+    assert(json != NULL && h != NULL);
+    lept_context_init(&c, json, len, a);
+    lept_parse_whitespace(&c);
+    if ((ret = lept_parse_events(&c, h, user)) == LEPT_PARSE_OK) {
+        lept_parse_whitespace(&c);
+        if (c.json != c.end)
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    }
+    if (c.stack)
+        LEPT_FREE(c.alloc, c.stack);
+    return ret;
+}
+
+int lept_parse_insitu(lept_value* v, char* json) {
+    return lept_parse_insitu_ex(v, json, NULL);
+}
+
+int lept_parse_insitu_ex(lept_value* v, char* json, const lept_allocator* a) {
+    lept_context c;
+    assert(v != NULL && json != NULL);
+    lept_context_init(&c, json, strlen(json), a);
+    c.insitu = 1;
+    return lept_parse_once(&c, v);
+}
+
+/*
+ * Lazy parsing validates the whole text first, so decoding a lazy node later
+ * cannot fail. The root, and every child of a decoded array or object, becomes
+ * a lazy node holding its text; literals are decoded at once as they cost
+ * nothing to store.
+ */
+static const lept_handler lept_validate_handler = {
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+/*
+ * Steps over one value without decoding it: only quotes, backslashes and
+ * brackets are looked at, so a malformed number, literal, escape or separator
+ * inside goes unnoticed. Unterminated strings and unbalanced brackets are
+ * still errors, and nesting is limited by max_depth.
+ */
+static int lept_skip_value(lept_context* c) {
+    unsigned long nest[(LEPT_PARSE_MAX_DEPTH + LEPT_NEST_BITS - 1) / LEPT_NEST_BITS + 1];
+    const char *p = c->json, *end = c->end;
+    size_t depth = 0;
+    switch (CHAR_AT(p, end)) {
+        case '"':
+        case '[':
+        case '{':
+            break;
+        case '-': case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+        case 't': case 'f': case 'n': /* a number or literal runs to the next delimiter */
+            for (p++; p != end && *p != ',' && *p != ']' && *p != '}' && !ISWHITESPACE(*p); p++)
+                ;
+            c->json = p;
+            return LEPT_PARSE_OK;
+        case '\0':
+            if (p == end)
+                return LEPT_PARSE_EXPECT_VALUE;
+            /* fall through */
+        default:
+            return LEPT_PARSE_INVALID_VALUE;
+    }
+    for (;;) {
+        switch (*p) {
+            case '"':
+                for (p = lept_scan_string(p + 1, end); p != end && *p != '"'; p = lept_scan_string(p, end))
+                    p += *p == '\\' && p + 1 != end ? 2 : 1; /* a backslash and the character after it */
+                if (p == end)
+                    return LEPT_PARSE_MISS_QUOTATION_MARK;
+                p++;
+                break;
+            case '[':
+            case '{':
+                if (depth == c->max_depth)
+                    return LEPT_PARSE_TOO_DEEP;
+                if (*p == '{')
+                    nest[depth / LEPT_NEST_BITS] |= 1UL << depth % LEPT_NEST_BITS;
+                else
+                    nest[depth / LEPT_NEST_BITS] &= ~(1UL << depth % LEPT_NEST_BITS);
+                depth++;
+                p++;
+                break;
+            default: /* ']' or '}' */
+                depth--;
+                if ((int)((nest[depth / LEPT_NEST_BITS] >> depth % LEPT_NEST_BITS) & 1) != (*p == '}'))
+                    return *p == '}' ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                p++;
+                break;
+        }
+        if (depth == 0)
+            break;
+        while (p != end && *p != '"' && *p != '[' && *p != ']' && *p != '{' && *p != '}')
+            p++;
+        if (p == end)
+            return (nest[(depth - 1) / LEPT_NEST_BITS] >> (depth - 1) % LEPT_NEST_BITS) & 1 ?
+                LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+    }
+    c->json = p;
+    return LEPT_PARSE_OK;
+}
+
+/* Makes e the literal of the valid value text [p, end), or a lazy node over it. */
+static void lept_lazy_node(lept_value* e, const char* p, const char* end) {
+    e->flags = 0;
+    switch (*p) {
+        case 'n': e->type = LEPT_NULL; return;
+        case 't': e->type = LEPT_TRUE; return;
+        case 'f': e->type = LEPT_FALSE; return;
+        case '"': e->type = LEPT_STRING; break;
+        case '[': e->type = LEPT_ARRAY; break;
+        case '{': e->type = LEPT_OBJECT; break;
+        default:  e->type = LEPT_NUMBER; break;
+    }
+    e->flags = LEPT_LAZY;
+    e->u.s.s = (char*)p; /* never written through */
+    e->u.s.len = (lept_length)(end - p);
+}
+
+/* Decodes a lazy node in place; the children of an array or object stay lazy. */
+static void lept_lazy_expand(lept_value* v) {
+    lept_context c;
+    lept_value e;
+    lept_member m;
+    const char* p;
+    char* s;
+    size_t len;
+    int ret;
+    lept_context_init(&c, v->u.s.s, v->u.s.len, NULL);
+    switch (v->type) {
+        case LEPT_NUMBER:
+            ret = lept_parse_number(&c, &e);
+            v->u.n = e.u.n;
+            v->flags = 0;
+            break;
+        case LEPT_STRING:
+            ret = lept_parse_string(&c, &s, &len);
+            if (!lept_string_inline(v, s, len)) {
+                v->u.s.s = lept_context_strdup(&c, s, len);
+                v->u.s.len = (lept_length)len;
+                v->flags = 0;
+            }
+            break;
+        default:
+            ret = LEPT_PARSE_OK;
+            c.json++;
+            lept_parse_whitespace(&c);
+            while (PEEK(&c) != ']' && PEEK(&c) != '}') {
+                if (v->type == LEPT_OBJECT) {
+                    ret |= lept_parse_string(&c, &s, &len);
+                    if (!lept_key_inline((char*)&m.k, &m.klen, s, len)) {
+                        m.k = lept_context_strdup(&c, s, len);
+                        m.klen = (lept_length)len;
+                    }
+                    lept_parse_whitespace(&c);
+                    c.json++; /* ':' */
+                    lept_parse_whitespace(&c);
+                }
+                p = c.json;
+                ret |= lept_skip_value(&c);
+                if (v->type == LEPT_OBJECT) {
+                    lept_lazy_node(&m.v, p, c.json);
+                    memcpy(lept_context_push(&c, sizeof(lept_member)), &m, sizeof(lept_member));
+                }
+                else
+                    lept_lazy_node((lept_value*)lept_context_push(&c, sizeof(lept_value)), p, c.json);
+                lept_parse_whitespace(&c);
+                if (PEEK(&c) == ',') {
+                    c.json++;
+                    lept_parse_whitespace(&c);
+                }
+            }
+            len = c.top;
+            if (v->type == LEPT_ARRAY) {
+                v->u.a.size = (lept_length)(len / sizeof(lept_value));
+                v->u.a.e = len ? (lept_value*)lept_context_alloc(&c, len) : NULL;
+            }
+            else {
+                v->u.o.size = (lept_length)(len / sizeof(lept_member));
+                v->u.o.m = len ? lept_context_alloc_members(&c, v->u.o.size) : NULL;
+            }
+            if (len)
+                memcpy(v->type == LEPT_ARRAY ? (void*)v->u.a.e : (void*)v->u.o.m, lept_context_pop(&c, len), len);
+            v->flags = 0;
+            break;
+    }
+    assert(ret == LEPT_PARSE_OK);
+    (void)ret;
+    if (c.stack)
+        LEPT_FREE(c.alloc, c.stack);
+}
+
+#define LEPT_LAZY_LOAD(v) do { if ((v)->flags & LEPT_LAZY) lept_lazy_expand((lept_value*)(v)); } while(0)
+
+int lept_parse_lazy(lept_value* v, const char* json) {
+    lept_context c;
+    const char* start;
+    int ret;
+    assert(v != NULL && json != NULL);
+    lept_init(v);
+    lept_context_init(&c, json, strlen(json), NULL);
+    c.validate = 1;
+    lept_parse_whitespace(&c);
+    start = c.json;
+    if ((ret = lept_parse_events(&c, &lept_validate_handler, NULL)) == LEPT_PARSE_OK) {
+        const char* stop = c.json;
+        lept_parse_whitespace(&c);
+        if (c.json != c.end)
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+        else
+            lept_lazy_node(v, start, stop);
+    }
+    if (c.stack)
+        LEPT_FREE(c.alloc, c.stack);
+    return ret;
+}
+
+/*
+ * A projection is a trie over path segments. The children of a node are the
+ * edges [edges, edges + edge_count) plus the wildcard node, 0 if none: the root
+ * is node 0 and never a child. A wildcard path is merged into every literal
+ * sibling when compiling, so one lookup finds the only node to follow.
+ */
+typedef struct {
+    size_t key, klen;   /* segment text, in keys */
+    size_t child;
+}lept_projection_edge;
+
+typedef struct {
+    size_t edges, edge_count, wildcard;
+    int leaf;           /* a path ends here: the whole value is kept */
+}lept_projection_node;
+
+struct lept_projection {
+    lept_projection_node* nodes;
+    size_t node_count, node_capacity;
+    lept_projection_edge* edges;
+    size_t edge_count, edge_capacity;
+    char* keys;         /* every path segment, with ~0 and ~1 decoded */
+    const lept_allocator* alloc;
+};
+
+typedef struct {
+    size_t key, klen;
+    int wildcard;
+}lept_projection_segment;
+
+typedef struct {
+    size_t first, count; /* segments of one path */
+}lept_projection_path;
+
+/* Splits a JSON Pointer into segments appended to segs and keys; returns 0 if it is malformed. */
+static int lept_projection_split(const char* path, lept_projection_segment* segs, size_t* count, char* keys, size_t* size) {
+    lept_projection_segment* seg;
+    while (*path) {
+        if (*path++ != '/')
+            return 0;
+        seg = &segs[(*count)++];
+        seg->key = *size;
+        for (; *path && *path != '/'; path++) {
+            if (*path == '~') {
+                if (path[1] != '0' && path[1] != '1')
+                    return 0;
+                keys[(*size)++] = *++path == '0' ? '~' : '/';
+            }
+            else
+                keys[(*size)++] = *path;
+        }
+        seg->klen = *size - seg->key;
+        seg->wildcard = seg->klen == 1 && keys[seg->key] == '*';
+    }
+    return 1;
+}
+
+static size_t lept_projection_build(lept_projection* p, const lept_projection_path* paths,
+    const lept_projection_segment* segs, const size_t* set, size_t n, size_t depth) {
+    const lept_projection_segment *s, *t;
+    size_t node = p->node_count, first, i, j, m, *sub;
+    if (p->node_count == p->node_capacity) {
+        p->node_capacity += p->node_capacity >> 1;
+        p->nodes = (lept_projection_node*)LEPT_REALLOC(p->alloc, p->nodes, p->node_capacity * sizeof(lept_projection_node));
+    }
+    p->node_count++;
+    p->nodes[node].edges = p->nodes[node].edge_count = p->nodes[node].wildcard = 0;
+    p->nodes[node].leaf = 0;
+    if (n == 0)
+        return node; /* no paths at all */
+    for (i = 0; i < n; i++)
+        if (paths[set[i]].count == depth) {
+            p->nodes[node].leaf = 1;
+            return node;
+        }
+
+    /* one edge per distinct literal segment at this depth */
+    for (i = m = 0; i < n; i++) {
+        s = &segs[paths[set[i]].first + depth];
+        for (j = 0; j < i; j++) {
+            t = &segs[paths[set[j]].first + depth];
+            if (!t->wildcard && t->klen == s->klen && memcmp(p->keys + t->key, p->keys + s->key, s->klen) == 0)
+                break;
+        }
+        if (!s->wildcard && j == i)
+            m++;
+    }
+    first = p->edge_count;
+    if (p->edge_count + m > p->edge_capacity) {
+        while (p->edge_count + m > p->edge_capacity)
+            p->edge_capacity += p->edge_capacity >> 1;
+        p->edges = (lept_projection_edge*)LEPT_REALLOC(p->alloc, p->edges, p->edge_capacity * sizeof(lept_projection_edge));
+    }
+    p->edge_count += m;
+    p->nodes[node].edges = first;
+    p->nodes[node].edge_count = m;
+
+    sub = (size_t*)LEPT_MALLOC(p->alloc, n * sizeof(size_t));
+    for (i = 0; i < n; i++) {
+        s = &segs[paths[set[i]].first + depth];
+        for (j = 0; j < n; j++) {
+            t = &segs[paths[set[j]].first + depth];
+            if (!t->wildcard && t->klen == s->klen && memcmp(p->keys + t->key, p->keys + s->key, s->klen) == 0)
+                break;
+        }
+        if (s->wildcard || j != i)
+            continue; /* a wildcard, or a literal already given its edge */
+        for (j = m = 0; j < n; j++) {
+            t = &segs[paths[set[j]].first + depth];
+            if (t->wildcard || (t->klen == s->klen && memcmp(p->keys + t->key, p->keys + s->key, s->klen) == 0))
+                sub[m++] = set[j];
+        }
+        m = lept_projection_build(p, paths, segs, sub, m, depth + 1); /* may move edges and nodes */
+        p->edges[first].key = s->key;
+        p->edges[first].klen = s->klen;
+        p->edges[first].child = m;
+        first++;
+    }
+    for (i = m = 0; i < n; i++)
+        if (segs[paths[set[i]].first + depth].wildcard)
+            sub[m++] = set[i];
+    if (m) {
+        m = lept_projection_build(p, paths, segs, sub, m, depth + 1);
+        p->nodes[node].wildcard = m;
+    }
+    LEPT_FREE(p->alloc, sub);
+    return node;
+}
+
+lept_projection* lept_projection_new(const char* const* paths, size_t count, const lept_allocator* a) {
+    lept_projection* p;
+    lept_projection_path* split;
+    lept_projection_segment* segs;
+    size_t i, total = 0, nsegs = 0, size = 0, *set;
+    int ok = 1;
+    assert(paths != NULL || count == 0);
+    a = LEPT_ALLOCATOR(a);
+    for (i = 0; i < count; i++)
+        total += strlen(paths[i]);
+    p = (lept_projection*)LEPT_MALLOC(a, sizeof(lept_projection));
+    p->alloc = a;
+    p->keys = (char*)LEPT_MALLOC(a, total + 1);
+    p->nodes = (lept_projection_node*)LEPT_MALLOC(a, (p->node_capacity = 4) * sizeof(lept_projection_node));
+    p->edges = (lept_projection_edge*)LEPT_MALLOC(a, (p->edge_capacity = 4) * sizeof(lept_projection_edge));
+    p->node_count = p->edge_count = 0;
+    split = (lept_projection_path*)LEPT_MALLOC(a, (count + 1) * sizeof(lept_projection_path));
+    segs = (lept_projection_segment*)LEPT_MALLOC(a, (total + 1) * sizeof(lept_projection_segment)); /* a '/' each */
+    set = (size_t*)LEPT_MALLOC(a, (count + 1) * sizeof(size_t));
+    for (i = 0; i < count && ok; i++) {
+        split[i].first = nsegs;
+        ok = lept_projection_split(paths[i], segs, &nsegs, p->keys, &size);
+        split[i].count = nsegs - split[i].first;
+        ok = ok && split[i].count <= LEPT_PARSE_MAX_DEPTH;
+        set[i] = i;
+    }
+    if (ok)
+        lept_projection_build(p, split, segs, set, count, 0);
+    LEPT_FREE(a, set);
+    LEPT_FREE(a, segs);
+    LEPT_FREE(a, split);
+    if (!ok) {
+        lept_projection_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void lept_projection_free(lept_projection* p) {
+    assert(p != NULL);
+    LEPT_FREE(p->alloc, p->nodes);
+    LEPT_FREE(p->alloc, p->edges);
+    LEPT_FREE(p->alloc, p->keys);
+    LEPT_FREE(p->alloc, p);
+}
+
+/* The node to follow into the member or element named key, or 0 to skip it. */
+static size_t lept_projection_child(const lept_projection* p, size_t node, const char* key, size_t klen) {
+    const lept_projection_node* n = &p->nodes[node];
+    size_t i;
+    for (i = n->edges; i < n->edges + n->edge_count; i++)
+        if (p->edges[i].klen == klen && memcmp(p->keys + p->edges[i].key, key, klen) == 0)
+            return p->edges[i].child;
+    return n->wildcard;
+}
+
+/* Whether the value at c->json is kept when following node: a path ends there, or goes on into a container. */
+#define LEPT_PROJECTION_KEEPS(p, node, c) \
+    ((node) && ((p)->nodes[node].leaf || PEEK(c) == '[' || PEEK(c) == '{'))
+
+/* Feeds b the parts of the container at c->json that node selects, skipping the rest. */
+static int lept_project_value(lept_context* c, lept_builder* b, const lept_projection* p, size_t node) {
+    size_t index = 0, child, len;
+    char num[24], *s;
+    int ret = LEPT_PARSE_OK, object;
+    if (p->nodes[node].leaf)
+        return lept_parse_events(c, &lept_builder_handler, b);
+    if (c->max_depth == 0)
+        return LEPT_PARSE_TOO_DEEP;
+    if ((object = *c->json++ == '{') != 0)
+        lept_build_start_object(b);
+    else
+        lept_build_start_array(b);
+    c->max_depth--;
+    lept_parse_whitespace(c);
+    if (PEEK(c) == (object ? '}' : ']'))
+        c->json++;
+    else for (;;) {
+        if (object) {
+            if (PEEK(c) != '"') {
+                ret = LEPT_PARSE_MISS_KEY;
+                break;
+            }
+            if ((ret = lept_parse_string(c, &s, &len)) != LEPT_PARSE_OK)
+                break;
+            lept_parse_whitespace(c);
+            if (PEEK(c) != ':') {
+                ret = LEPT_PARSE_MISS_COLON;
+                break;
+            }
+            c->json++;
+            lept_parse_whitespace(c);
+            child = lept_projection_child(p, node, s, len);
+            if (LEPT_PROJECTION_KEEPS(p, child, c))
+                lept_build_key(b, s, len); /* s is above the stack top, not yet overwritten */
+        }
+        else {
+            child = p->nodes[node].wildcard;
+            if (p->nodes[node].edge_count) {
+                len = (size_t)sprintf(num, "%lu", (unsigned long)index);
+                child = lept_projection_child(p, node, num, len);
+            }
+            index++;
+        }
+        if (LEPT_PROJECTION_KEEPS(p, child, c))
+            ret = lept_project_value(c, b, p, child);
+        else
+            ret = lept_skip_value(c);
+        if (ret != LEPT_PARSE_OK)
+            break;
+        lept_parse_whitespace(c);
+        if (PEEK(c) == ',') {
+            c->json++;
+            lept_parse_whitespace(c);
+        }
+        else if (PEEK(c) == (object ? '}' : ']')) {
+            c->json++;
+            break;
+        }
+        else {
+            ret = object ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            break;
+        }
+    }
+    c->max_depth++;
+    if (ret == LEPT_PARSE_OK)
+        lept_build_end(b);
+    return ret;
+}
+
+int lept_parse_projection(lept_value* v, const char* json, const lept_projection* p) {
+    lept_context c;
+    lept_builder b;
+    int ret;
+    assert(v != NULL && json != NULL && p != NULL);
+    lept_init(v);
+    lept_context_init(&c, json, strlen(json), p->alloc);
+    b.c = &c;
+    b.root = v;
+    b.frame = b.depth = 0;
+    lept_parse_whitespace(&c);
+    if (p->nodes[0].leaf || ((p->nodes[0].edge_count || p->nodes[0].wildcard) && (PEEK(&c) == '[' || PEEK(&c) == '{')))
+        ret = lept_project_value(&c, &b, p, 0);
+    else
+        ret = lept_skip_value(&c);
+    if (ret == LEPT_PARSE_OK) {
+        lept_parse_whitespace(&c);
+        if (c.json != c.end) {
+            lept_context_free(&c, v);
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+        }
+    }
+    else
+        lept_builder_unwind(&b);
+    if (c.stack)
+        LEPT_FREE(c.alloc, c.stack);
+    return ret;
+}
+
+void lept_parser_init(lept_parser* p, const lept_allocator* a) {
+    assert(p != NULL);
+    p->stack = NULL;
+    p->size = p->peak = 0;
+    p->parses = 0;
+    p->trim_interval = LEPT_PARSER_TRIM_INTERVAL;
+    p->max_depth = LEPT_PARSE_MAX_DEPTH;
+    p->intern = NULL;
+    p->allocator = a;
+}
+
+/* Every trim_interval parses, give back stack capacity the recent peak did not need. */
+static void lept_parser_trim(lept_parser* p) {
+    size_t keep;
+    if (++p->parses < p->trim_interval)
+        return;
+    keep = p->peak == 0 ? 0 : p->peak + (p->peak >> 1);
+    if (keep != 0 && keep < LEPT_PARSE_STACK_INIT_SIZE)
+        keep = LEPT_PARSE_STACK_INIT_SIZE;
+    if (p->size > keep * 2) {
+        const lept_allocator* a = LEPT_ALLOCATOR(p->allocator);
+        if (keep == 0) {
+            LEPT_FREE(a, p->stack);
+            p->stack = NULL;
+        }
+        else
+            p->stack = (char*)LEPT_REALLOC(a, p->stack, keep);
+        p->size = keep;
+    }
+    p->parses = 0;
+    p->peak = 0;
+}
+
+int lept_parser_parse(lept_parser* p, lept_value* v, const char* json) {
+    lept_context c;
+    int ret;
+    assert(p != NULL && v != NULL && json != NULL);
+    lept_context_init(&c, json, strlen(json), p->allocator);
+    c.stack = p->stack;
+    c.size = p->size;
+    if (p->max_depth < c.max_depth)
+        c.max_depth = p->max_depth;
+    c.intern = p->intern;
+    ret = lept_parse_root(&c, v);
+    p->stack = c.stack;
+    p->size = c.size;
+    if (c.peak > p->peak)
+        p->peak = c.peak;
+    lept_parser_trim(p);
+    return ret;
+}
+
+void lept_parser_free(lept_parser* p) {
+    assert(p != NULL);
+    if (p->stack)
+        LEPT_FREE(LEPT_ALLOCATOR(p->allocator), p->stack);
+    p->stack = NULL;
+    p->size = p->peak = 0;
+}
+
+/*
+ * Push parsing runs the grammar of lept_parse_events() as explicit states,
+ * so it can stop at the end of any chunk. A token (string, key, number or
+ * literal) that straddles chunks is collected in token[] and decoded once
+ * complete; a token inside one chunk is decoded where it lies.
+ */
+enum {
+    LEPT_PUSH_VALUE,            /* before a value */
+    LEPT_PUSH_VALUE_OR_CLOSE,   /* after '[' */
+    LEPT_PUSH_KEY,              /* after ',' in an object */
+    LEPT_PUSH_KEY_OR_CLOSE,     /* after '{' */
+    LEPT_PUSH_COLON,
+    LEPT_PUSH_NEXT,             /* after a value inside a container */
+    LEPT_PUSH_DONE,             /* after the root value */
+    LEPT_PUSH_STRING,           /* inside a token from here on */
+    LEPT_PUSH_KEY_STRING,
+    LEPT_PUSH_NUMBER,
+    LEPT_PUSH_LITERAL
+};
+
+#define ISNUMBERCHAR(ch)    (ISDIGIT(ch) || (ch) == '-' || (ch) == '+' || (ch) == '.' || (ch) == 'e' || (ch) == 'E')
+#define ISLITERALCHAR(ch)   ((ch) >= 'a' && (ch) <= 'z')
+
+struct lept_push_parser {
+    lept_context c;             /* parse stack; json/end span the token being decoded */
+    const lept_handler* h;
+    void* user;
+    lept_builder b;             /* tree mode: the user of lept_builder_handler */
+    char* token;                /* bytes of a token split across chunks */
+    size_t tlen, tsize;
+    size_t depth;
+    unsigned long nest[(LEPT_PARSE_MAX_DEPTH + LEPT_NEST_BITS - 1) / LEPT_NEST_BITS + 1];
+    int state;
+    int escape;                 /* the last chunk ended right after a backslash */
+    int ret;                    /* first error, sticky */
+    int finished;
+};
+
+#define LEPT_PUSH_EVENT(p, fn, args) \
+    do { if ((p)->h->fn && !(p)->h->fn args) return lept_push_fail(p, LEPT_PARSE_STOPPED); } while(0)
+
+static lept_push_parser* lept_push_parser_create(const lept_handler* h, void* user, const lept_allocator* a) {
+    lept_push_parser* p;
+    a = LEPT_ALLOCATOR(a);
+    p = (lept_push_parser*)LEPT_MALLOC(a, sizeof(lept_push_parser));
+    lept_context_init(&p->c, "", 0, a);
+    p->h = h;
+    p->user = user;
+    p->b.c = &p->c;
+    p->b.root = NULL;
+    p->b.frame = p->b.depth = 0;
+    p->token = NULL;
+    p->tlen = p->tsize = 0;
+    p->depth = 0;
+    p->state = LEPT_PUSH_VALUE;
+    p->escape = 0;
+    p->ret = LEPT_PARSE_OK;
+    p->finished = 0;
+    return p;
+}
+
+lept_push_parser* lept_push_parser_new(lept_value* v, const lept_allocator* a) {
+    lept_push_parser* p;
+    assert(v != NULL);
+    lept_init(v);
+    p = lept_push_parser_create(&lept_builder_handler, NULL, a);
+    p->user = &p->b;
+    p->b.root = v;
+    return p;
+}
+
+lept_push_parser* lept_push_parser_new_sax(const lept_handler* h, void* user, const lept_allocator* a) {
+    assert(h != NULL);
+    return lept_push_parser_create(h, user, a);
+}
+
+/* Records the first error; in tree mode the partial tree is released at once. */
+static int lept_push_fail(lept_push_parser* p, int ret) {
+    if (p->b.root) {
+        lept_builder_unwind(&p->b);
+        lept_context_free(&p->c, p->b.root);
+    }
+    p->c.top = 0;
+    return p->ret = ret;
+}
+
+static void lept_push_token_append(lept_push_parser* p, const char* s, size_t len) {
+    if (p->tlen + len > p->tsize) {
+        while (p->tlen + len > p->tsize)
+            p->tsize = p->tsize ? p->tsize + (p->tsize >> 1) : LEPT_PARSE_STACK_INIT_SIZE;
+        p->token = (char*)LEPT_REALLOC(p->c.alloc, p->token, p->tsize);
+    }
+    memcpy(p->token + p->tlen, s, len);
+    p->tlen += len;
+}
+
+static void lept_push_value_done(lept_push_parser* p) {
+    p->state = p->depth ? LEPT_PUSH_NEXT : LEPT_PUSH_DONE;
+}
+
+/* Decodes the complete token [s, end) and reports it; *used is where decoding stopped. */
+static int lept_push_token(lept_push_parser* p, const char* s, const char* end, const char** used) {
+    lept_context* c = &p->c;
+    lept_value e;
+    char* str;
+    size_t len;
+    int ret;
+    c->json = s;
+    c->end = end;
+    switch (p->state) {
+        case LEPT_PUSH_STRING:
+        case LEPT_PUSH_KEY_STRING:
+            if ((ret = lept_parse_string(c, &str, &len)) != LEPT_PARSE_OK)
+                return lept_push_fail(p, ret);
+            if (p->state == LEPT_PUSH_KEY_STRING) {
+                LEPT_PUSH_EVENT(p, on_key, (p->user, str, len));
+                p->state = LEPT_PUSH_COLON;
+                break;
+            }
+            LEPT_PUSH_EVENT(p, on_string, (p->user, str, len));
+            lept_push_value_done(p);
+            break;
+        case LEPT_PUSH_NUMBER:
+            if ((ret = lept_parse_number(c, &e)) != LEPT_PARSE_OK)
+                return lept_push_fail(p, ret);
+            LEPT_PUSH_EVENT(p, on_number, (p->user, e.u.n));
+            lept_push_value_done(p);
+            break;
+        default:
+            if ((ret = lept_parse_literal(c, &e, *s == 't' ? "true" : *s == 'f' ? "false" : "null", LEPT_NULL)) != LEPT_PARSE_OK)
+                return lept_push_fail(p, ret);
+            if (*s == 'n')
+                LEPT_PUSH_EVENT(p, on_null, (p->user));
+            else
+                LEPT_PUSH_EVENT(p, on_bool, (p->user, *s == 't'));
+            lept_push_value_done(p);
+            break;
+    }
+    *used = c->json;
+    return LEPT_PARSE_OK;
+}
+
+static int lept_push_run(lept_push_parser* p, const char* s, const char* end);
+
+/* Decodes the token collected in token[]; what follows it must be rejected by the new state. */
+static int lept_push_token_flush(lept_push_parser* p) {
+    const char* used;
+    size_t len = p->tlen;
+    p->tlen = 0;
+    if (lept_push_token(p, p->token, p->token + len, &used) != LEPT_PARSE_OK)
+        return p->ret;
+    return used != p->token + len ? lept_push_run(p, used, p->token + len) : LEPT_PARSE_OK;
+}
+
+/*
+ * Continues the token that began at begin, or in an earlier chunk, with
+ * the bytes from q on. Returns where the machine resumes, or NULL once the
+ * chunk is used up or an error is recorded.
+ */
+static const char* lept_push_scan_token(lept_push_parser* p, const char* begin, const char* q, const char* end) {
+    const char* used;
+    int complete = 0;
+    if (p->state <= LEPT_PUSH_KEY_STRING) {
+        if (p->escape && q < end) {
+            q++;
+            p->escape = 0;
+        }
+        while (q < end) {
+            q = lept_scan_string(q, end);
+            if (q == end)
+                break;
+            if (*q == '\"') {
+                q++;
+                complete = 1;
+                break;
+            }
+            if (*q++ == '\\') {
+                if (q == end) {
+                    p->escape = 1;
+                    break;
+                }
+                q++;
+            }
+            /* control bytes are left for the decoder to reject */
+        }
+    }
+    else {
+        while (q < end && (p->state == LEPT_PUSH_NUMBER ? ISNUMBERCHAR(*q) : ISLITERALCHAR(*q)))
+            q++;
+        complete = q < end;
+    }
+    if (complete && p->tlen == 0)
+        return lept_push_token(p, begin, q, &used) == LEPT_PARSE_OK ? used : NULL;
+    lept_push_token_append(p, begin, (size_t)(q - begin));
+    if (complete)
+        return lept_push_token_flush(p) == LEPT_PARSE_OK ? q : NULL;
+    return NULL;
+}
+
+static int lept_push_run(lept_push_parser* p, const char* s, const char* end) {
+    char ch;
+    int object;
+    while (s < end) {
+        if (p->state >= LEPT_PUSH_STRING) {
+            if (!(s = lept_push_scan_token(p, s, s, end)))
+                return p->ret;
+            continue;
+        }
+        if (ISWHITESPACE(*s)) {
+            s = lept_skip_whitespace(s + 1, end);
+            continue;
+        }
+        ch = *s;
+        switch (p->state) {
+            case LEPT_PUSH_VALUE_OR_CLOSE:
+                if (ch == ']')
+                    goto close;
+                /* fall through */
+            case LEPT_PUSH_VALUE:
+                if (ch == '[' || ch == '{') {
+                    if (p->depth == p->c.max_depth)
+                        return lept_push_fail(p, LEPT_PARSE_TOO_DEEP);
+                    if (ch == '{') {
+                        p->nest[p->depth / LEPT_NEST_BITS] |= 1UL << p->depth % LEPT_NEST_BITS;
+                        LEPT_PUSH_EVENT(p, on_start_object, (p->user));
+                        p->state = LEPT_PUSH_KEY_OR_CLOSE;
+                    }
+                    else {
+                        p->nest[p->depth / LEPT_NEST_BITS] &= ~(1UL << p->depth % LEPT_NEST_BITS);
+                        LEPT_PUSH_EVENT(p, on_start_array, (p->user));
+                        p->state = LEPT_PUSH_VALUE_OR_CLOSE;
+                    }
+                    p->depth++;
+                    s++;
+                    continue;
+                }
+                if (ch == '"')
+                    p->state = LEPT_PUSH_STRING;
+                else if (ch == '-' || ISDIGIT(ch))
+                    p->state = LEPT_PUSH_NUMBER;
+                else if (ch == 't' || ch == 'f' || ch == 'n')
+                    p->state = LEPT_PUSH_LITERAL;
+                else
+                    return lept_push_fail(p, LEPT_PARSE_INVALID_VALUE);
+                if (!(s = lept_push_scan_token(p, s, ch == '"' ? s + 1 : s, end)))
+                    return p->ret;
+                continue;
+            case LEPT_PUSH_KEY_OR_CLOSE:
+                if (ch == '}')
+                    goto close;
+                /* fall through */
+            case LEPT_PUSH_KEY:
+                if (ch != '"')
+                    return lept_push_fail(p, LEPT_PARSE_MISS_KEY);
+                p->state = LEPT_PUSH_KEY_STRING;
+                if (!(s = lept_push_scan_token(p, s, s + 1, end)))
+                    return p->ret;
+                continue;
+            case LEPT_PUSH_COLON:
+                if (ch != ':')
+                    return lept_push_fail(p, LEPT_PARSE_MISS_COLON);
+                p->state = LEPT_PUSH_VALUE;
+                s++;
+                continue;
+            case LEPT_PUSH_NEXT:
+                object = (p->nest[(p->depth - 1) / LEPT_NEST_BITS] >> (p->depth - 1) % LEPT_NEST_BITS) & 1;
+                if (ch == ',') {
+                    p->state = object ? LEPT_PUSH_KEY : LEPT_PUSH_VALUE;
+                    s++;
+                    continue;
+                }
+                if (ch == (object ? '}' : ']'))
+                    goto close;
+                return lept_push_fail(p, object ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET);
+            default:
+                return lept_push_fail(p, LEPT_PARSE_ROOT_NOT_SINGULAR);
+        }
+    close:
+        s++;
+        p->depth--;
+        if ((p->nest[p->depth / LEPT_NEST_BITS] >> p->depth % LEPT_NEST_BITS) & 1)
+            LEPT_PUSH_EVENT(p, on_end_object, (p->user));
+        else
+            LEPT_PUSH_EVENT(p, on_end_array, (p->user));
+        lept_push_value_done(p);
+    }
+    return LEPT_PARSE_OK;
+}
+
+int lept_push_parser_feed(lept_push_parser* p, const char* chunk, size_t len) {
+    assert(p != NULL && !p->finished && (chunk != NULL || len == 0));
+    if (p->ret != LEPT_PARSE_OK || len == 0)
+        return p->ret;
+    return lept_push_run(p, chunk, chunk + len);
+}
+
+int lept_push_parser_finish(lept_push_parser* p) {
+    int ret;
+    assert(p != NULL && !p->finished);
+    p->finished = 1;
+    if (p->ret != LEPT_PARSE_OK)
+        return p->ret;
+    if (p->state >= LEPT_PUSH_STRING && lept_push_token_flush(p) != LEPT_PARSE_OK)
+        return p->ret;
+    switch (p->state) {
+        case LEPT_PUSH_DONE:
+            return LEPT_PARSE_OK;
+        case LEPT_PUSH_VALUE:
+        case LEPT_PUSH_VALUE_OR_CLOSE:
+            ret = LEPT_PARSE_EXPECT_VALUE;
+            break;
+        case LEPT_PUSH_KEY:
+        case LEPT_PUSH_KEY_OR_CLOSE:
+            ret = LEPT_PARSE_MISS_KEY;
+            break;
+        case LEPT_PUSH_COLON:
+            ret = LEPT_PARSE_MISS_COLON;
+            break;
+        default:
+            ret = (p->nest[(p->depth - 1) / LEPT_NEST_BITS] >> (p->depth - 1) % LEPT_NEST_BITS) & 1 ?
+                LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            break;
+    }
+    return lept_push_fail(p, ret);
+}
+
+void lept_push_parser_free(lept_push_parser* p) {
+    const lept_allocator* a;
+    assert(p != NULL);
+    if (!p->finished && p->ret == LEPT_PARSE_OK)
+        lept_push_fail(p, LEPT_PARSE_STOPPED); /* abandoned: release the partial tree */
+    a = p->c.alloc;
+    if (p->c.stack)
+        LEPT_FREE(a, p->c.stack);
+    if (p->token)
+        LEPT_FREE(a, p->token);
+    LEPT_FREE(a, p);
+}
+
+void lept_document_init(lept_document* d) {
+    lept_document_init_ex(d, NULL);
+}
+
+void lept_document_init_ex(lept_document* d, const lept_allocator* a) {
+    assert(d != NULL);
+    lept_init(&d->root);
+    d->arena = NULL;
+    d->allocator = a;
+}
+
+int lept_document_parse(lept_document* d, const char* json) {
+    lept_context c;
+    assert(d != NULL && json != NULL);
+    lept_document_free(d);
+    lept_context_init(&c, json, strlen(json), d->allocator);
+    c.arena = &d->arena;
+    return lept_parse_once(&c, &d->root);
+}
+
+void lept_document_free(lept_document* d) {
+    lept_arena_block* b;
+    assert(d != NULL);
+    while ((b = d->arena) != NULL) {
+        d->arena = b->next;
+        LEPT_FREE(LEPT_ALLOCATOR(d->allocator), b);
+    }
+    lept_init(&d->root);
+}
+
+
+/*
+ * Tape: words in document order, each a tag in the top byte and a payload
+ * below it. Numbers are followed by their bits and strings and keys by their
+ * length; the payload of a string or key is its offset in the string buffer.
+ * An array or object start holds the index of its end, and the end holds the
+ * element or member count.
+ */
+enum { LEPT_TAPE_END = LEPT_OBJECT + 1, LEPT_TAPE_KEY };
+
+#define LEPT_TAPE_WORD(tag, payload) ((lept_u64)(tag) << 56 | (lept_u64)(payload))
+#define LEPT_TAPE_TAG(w)             ((int)((w) >> 56))
+#define LEPT_TAPE_PAYLOAD(w)         ((size_t)((w) & ((LEPT_U64(1) << 56) - 1)))
+
+struct lept_tape {
+    lept_u64* words;
+    size_t size, capacity;
+    char* strings;                  /* every string and key, NUL-terminated */
+    size_t strings_size, strings_capacity;
+    char* stack;                    /* parse stack kept for the next parse */
+    size_t stack_size;
+    const lept_allocator* alloc;
+};
+
+typedef struct {
+    size_t start, count;            /* tape index of an open array or object, values in it so far */
+}lept_tape_open;
+
+typedef struct {
+    lept_tape* t;
+    lept_context* c;                /* its stack holds the lept_tape_open records */
+}lept_tape_builder;
+
+/* Grown as needed: how many words the input takes depends too much on its content to reserve well. */
+static lept_u64* lept_tape_push(lept_tape* t, size_t n) {
+    if (t->size + n > t->capacity) {
+        if (t->capacity == 0)
+            t->capacity = LEPT_PARSE_STACK_INIT_SIZE / sizeof(lept_u64);
+        while (t->size + n > t->capacity)
+            t->capacity += t->capacity >> 1;
+        t->words = (lept_u64*)LEPT_REALLOC(t->alloc, t->words, t->capacity * sizeof(lept_u64));
+    }
+    t->size += n;
+    return t->words + t->size - n;
+}
+
+static int lept_tape_value(lept_tape_builder* b, int tag, size_t payload) {
+    if (b->c->top)
+        ((lept_tape_open*)(b->c->stack + b->c->top) - 1)->count++;
+    *lept_tape_push(b->t, 1) = LEPT_TAPE_WORD(tag, payload);
+    return 1;
+}
+
+static int lept_tape_null(void* user) {
+    return lept_tape_value((lept_tape_builder*)user, LEPT_NULL, 0);
+}
+
+static int lept_tape_bool(void* user, int b) {
+    return lept_tape_value((lept_tape_builder*)user, b ? LEPT_TRUE : LEPT_FALSE, 0);
+}
+
+static int lept_tape_number(void* user, double n) {
+    lept_tape_builder* b = (lept_tape_builder*)user;
+    lept_tape_value(b, LEPT_NUMBER, 0);
+    memcpy(lept_tape_push(b->t, 1), &n, sizeof(n));
+    return 1;
+}
+
+/* The string buffer is sized for the whole input up front, and decoding never lengthens text. */
+static size_t lept_tape_text(lept_tape* t, const char* s, size_t len) {
+    size_t offset = t->strings_size;
+    assert(offset + len + 1 <= t->strings_capacity);
+    if (len)
+        memcpy(t->strings + offset, s, len);
+    t->strings[offset + len] = '\0';
+    t->strings_size += len + 1;
+    return offset;
+}
+
+static int lept_tape_string(void* user, const char* s, size_t len) {
+    lept_tape_builder* b = (lept_tape_builder*)user;
+    lept_tape_value(b, LEPT_STRING, lept_tape_text(b->t, s, len));
+    *lept_tape_push(b->t, 1) = (lept_u64)len;
+    return 1;
+}
+
+static int lept_tape_key(void* user, const char* k, size_t klen) {
+    lept_tape* t = ((lept_tape_builder*)user)->t;
+    lept_u64* w = lept_tape_push(t, 2);
+    w[0] = LEPT_TAPE_WORD(LEPT_TAPE_KEY, lept_tape_text(t, k, klen));
+    w[1] = (lept_u64)klen;
+    return 1;
+}
+
+static int lept_tape_start(lept_tape_builder* b, int tag) {
+    lept_tape_open* o;
+    lept_tape_value(b, tag, 0);
+    o = (lept_tape_open*)lept_context_push(b->c, sizeof(lept_tape_open));
+    o->start = b->t->size - 1;
+    o->count = 0;
+    return 1;
+}
+
+static int lept_tape_start_array(void* user) {
+    return lept_tape_start((lept_tape_builder*)user, LEPT_ARRAY);
+}
+
+static int lept_tape_start_object(void* user) {
+    return lept_tape_start((lept_tape_builder*)user, LEPT_OBJECT);
+}
+
+static int lept_tape_end(void* user) {
+    lept_tape_builder* b = (lept_tape_builder*)user;
+    lept_tape_open* o = (lept_tape_open*)lept_context_pop(b->c, sizeof(lept_tape_open));
+    b->t->words[o->start] |= (lept_u64)b->t->size;
+    *lept_tape_push(b->t, 1) = LEPT_TAPE_WORD(LEPT_TAPE_END, o->count);
+    return 1;
+}
+
+static const lept_handler lept_tape_handler = {
+    lept_tape_null, lept_tape_bool, lept_tape_number, lept_tape_string,
+    lept_tape_start_object, lept_tape_key, lept_tape_end,
+    lept_tape_start_array, lept_tape_end
+};
+
+lept_tape* lept_tape_new(const lept_allocator* a) {
+    lept_tape* t;
+    a = LEPT_ALLOCATOR(a);
+    t = (lept_tape*)LEPT_MALLOC(a, sizeof(lept_tape));
+    t->words = NULL;
+    t->size = t->capacity = 0;
+    t->strings = NULL;
+    t->strings_size = t->strings_capacity = 0;
+    t->stack = NULL;
+    t->stack_size = 0;
+    t->alloc = a;
+    return t;
+}
+
+int lept_tape_parse(lept_tape* t, const char* json, size_t len) {
+    lept_context c;
+    lept_tape_builder b;
+    int ret;
+    assert(t != NULL && (json != NULL || len == 0));
+    if (t->strings_capacity < len + 1) {
+        if (t->strings)
+            LEPT_FREE(t->alloc, t->strings);
+        t->strings = (char*)LEPT_MALLOC(t->alloc, t->strings_capacity = len + 1);
+    }
+    t->size = t->strings_size = 0;
+    lept_context_init(&c, json, len, t->alloc);
+    c.stack = t->stack;
+    c.size = t->stack_size;
+    b.t = t;
+    b.c = &c;
+    lept_parse_whitespace(&c);
+    if ((ret = lept_parse_events(&c, &lept_tape_handler, &b)) == LEPT_PARSE_OK) {
+        lept_parse_whitespace(&c);
+        if (c.json != c.end)
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    }
+    if (ret != LEPT_PARSE_OK)
+        t->size = t->strings_size = 0;
+    c.top = 0;
+    t->stack = c.stack;
+    t->stack_size = c.size;
+    return ret;
+}
+
+size_t lept_tape_words(const lept_tape* t) {
+    assert(t != NULL);
+    return t->size;
+}
+
+void lept_tape_free(lept_tape* t) {
+    assert(t != NULL);
+    if (t->words)
+        LEPT_FREE(t->alloc, t->words);
+    if (t->strings)
+        LEPT_FREE(t->alloc, t->strings);
+    if (t->stack)
+        LEPT_FREE(t->alloc, t->stack);
+    LEPT_FREE(t->alloc, t);
+}
+
+#define LEPT_CURSOR_WORD(c, i) ((c)->tape->words[(c)->pos + (i)])
+
+lept_cursor lept_tape_root(const lept_tape* t) {
+    lept_cursor c;
+    assert(t != NULL && t->size > 0);
+    c.tape = t;
+    c.pos = 0;
+    c.key = LEPT_KEY_NOT_EXIST;
+    return c;
+}
+
+lept_type lept_cursor_type(const lept_cursor* c) {
+    assert(c != NULL);
+    return (lept_type)LEPT_TAPE_TAG(LEPT_CURSOR_WORD(c, 0));
+}
+
+int lept_cursor_get_boolean(const lept_cursor* c) {
+    assert(c != NULL && (lept_cursor_type(c) == LEPT_TRUE || lept_cursor_type(c) == LEPT_FALSE));
+    return lept_cursor_type(c) == LEPT_TRUE;
+}
+
+double lept_cursor_get_number(const lept_cursor* c) {
+    double n;
+    assert(c != NULL && lept_cursor_type(c) == LEPT_NUMBER);
+    memcpy(&n, &LEPT_CURSOR_WORD(c, 1), sizeof(n));
+    return n;
+}
+
+const char* lept_cursor_get_string(const lept_cursor* c, size_t* len) {
+    assert(c != NULL && lept_cursor_type(c) == LEPT_STRING);
+    if (len)
+        *len = (size_t)LEPT_CURSOR_WORD(c, 1);
+    return c->tape->strings + LEPT_TAPE_PAYLOAD(LEPT_CURSOR_WORD(c, 0));
+}
+
+const char* lept_cursor_get_key(const lept_cursor* c, size_t* klen) {
+    assert(c != NULL);
+    if (c->key == LEPT_KEY_NOT_EXIST) {
+        if (klen)
+            *klen = 0;
+        return NULL;
+    }
+    if (klen)
+        *klen = (size_t)c->tape->words[c->key + 1];
+    return c->tape->strings + LEPT_TAPE_PAYLOAD(c->tape->words[c->key]);
+}
+
+size_t lept_cursor_size(const lept_cursor* c) {
+    assert(c != NULL && (lept_cursor_type(c) == LEPT_ARRAY || lept_cursor_type(c) == LEPT_OBJECT));
+    return LEPT_TAPE_PAYLOAD(c->tape->words[LEPT_TAPE_PAYLOAD(LEPT_CURSOR_WORD(c, 0))]);
 }
 
-static void lept_encode_utf8(lept_context* c, unsigned u) {
-    if (u <= 0x7F) 
-        PUTC(c, u & 0xFF);
-    else if (u <= 0x7FF) {
-        PUTC(c, 0xC0 | ((u >> 6) & 0xFF));
-        PUTC(c, 0x80 | ( u       & 0x3F));
-    }
-    else if (u <= 0xFFFF) {
-        PUTC(c, 0xE0 | ((u >> 12) & 0xFF));
-        PUTC(c, 0x80 | ((u >>  6) & 0x3F));
-        PUTC(c, 0x80 | ( u        & 0x3F));
+/* Moves to the value starting at word i, which may be a key or the end of the container. */
+static int lept_cursor_enter(lept_cursor* c, size_t i) {
+    int tag = LEPT_TAPE_TAG(c->tape->words[i]);
+    if (tag == LEPT_TAPE_END)
+        return 0;
+    if (tag == LEPT_TAPE_KEY) {
+        c->key = i;
+        c->pos = i + 2;
     }
     else {
-        assert(u <= 0x10FFFF);
-        PUTC(c, 0xF0 | ((u >> 18) & 0xFF));
-        PUTC(c, 0x80 | ((u >> 12) & 0x3F));
-        PUTC(c, 0x80 | ((u >>  6) & 0x3F));
-        PUTC(c, 0x80 | ( u        & 0x3F));
+        c->key = LEPT_KEY_NOT_EXIST;
+        c->pos = i;
     }
+    return 1;
 }
 
-#define STRING_ERROR(ret) do { c->top = head; return ret; } while(0)
+int lept_cursor_down(lept_cursor* c) {
+    assert(c != NULL);
+    if (lept_cursor_type(c) != LEPT_ARRAY && lept_cursor_type(c) != LEPT_OBJECT)
+        return 0;
+    return lept_cursor_enter(c, c->pos + 1);
+}
 
-static int lept_parse_string_raw(lept_context* c, char** str, size_t* len) {
-    size_t head = c->top;
-    unsigned u, u2;
-    const char* p;
-    EXPECT(c, '\"');
-    p = c->json;
-    for (;;) {
-        char ch = *p++;
-        switch (ch) {
-            case '\"':
-                *len = c->top - head;
-                *str = lept_context_pop(c, *len);
-                c->json = p;
-                return LEPT_PARSE_OK;
-            case '\\':
-                switch (*p++) {
-                    case '\"': PUTC(c, '\"'); break;
-                    case '\\': PUTC(c, '\\'); break;
-                    case '/':  PUTC(c, '/' ); break;
-                    case 'b':  PUTC(c, '\b'); break;
-                    case 'f':  PUTC(c, '\f'); break;
-                    case 'n':  PUTC(c, '\n'); break;
-                    case 'r':  PUTC(c, '\r'); break;
-                    case 't':  PUTC(c, '\t'); break;
-                    case 'u':
-                        if (!(p = lept_parse_hex4(p, &u)))
-                            STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
-                        if (u >= 0xD800 && u <= 0xDBFF) { /* surrogate pair */
-                            if (*p++ != '\\')
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-                            if (*p++ != 'u')
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-                            if (!(p = lept_parse_hex4(p, &u2)))
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
-                            if (u2 < 0xDC00 || u2 > 0xDFFF)
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-                            u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
-                        }
-                        lept_encode_utf8(c, u);
-                        break;
-                    default:
-                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
-                }
-                break;
-            case '\0':
-                STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
-            default:
-                if ((unsigned char)ch < 0x20)
-                    STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
-                PUTC(c, ch);
-        }
+int lept_cursor_next(lept_cursor* c) {
+    size_t next;
+    assert(c != NULL);
+    if (c->pos == 0)
+        return 0; /* the root has no siblings */
+    switch (lept_cursor_type(c)) {
+        case LEPT_NUMBER:
+        case LEPT_STRING: next = c->pos + 2; break;
+        case LEPT_ARRAY:
+        case LEPT_OBJECT: next = LEPT_TAPE_PAYLOAD(LEPT_CURSOR_WORD(c, 0)) + 1; break;
+        default:          next = c->pos + 1; break;
     }
+    return lept_cursor_enter(c, next);
 }
 
-static int lept_parse_string(lept_context* c, lept_value* v) {
-    int ret;
-    char* s;
+int lept_cursor_find(lept_cursor* c, const char* key, size_t klen) {
+    lept_cursor m;
+    const char* k;
     size_t len;
-    if ((ret = lept_parse_string_raw(c, &s, &len)) == LEPT_PARSE_OK)
-        lept_set_string(v, s, len);
-    return ret;
+    assert(c != NULL && (key != NULL || klen == 0));
+    if (lept_cursor_type(c) != LEPT_OBJECT)
+        return 0;
+    m = *c;
+    if (!lept_cursor_down(&m))
+        return 0;
+    do {
+        k = lept_cursor_get_key(&m, &len);
+        if (len == klen && memcmp(k, key, klen) == 0) {
+            *c = m;
+            return 1;
+        }
+    } while (lept_cursor_next(&m));
+    return 0;
 }
 
-static int lept_parse_value(lept_context* c, lept_value* v);
+/*
+ * Shortest round-trip formatting of doubles (Ryu, Ulf Adams 2018): the fewest
+ * decimal digits that parse back to the same double, nearest one on ties.
+ */
+#define LEPT_POW5_BITCOUNT 125
+#define LEPT_POW5_INV_BITCOUNT 125
 
-static int lept_parse_array(lept_context* c, lept_value* v) {
-    size_t i, size = 0;
-    int ret;
-    EXPECT(c, '[');
-    lept_parse_whitespace(c);
-    if (*c->json == ']') {
-        c->json++;
-        v->type = LEPT_ARRAY;
-        v->u.a.size = 0;
-        v->u.a.e = NULL;
-        return LEPT_PARSE_OK;
-    }
-    for (;;) {
-        lept_value e;
-        lept_init(&e);
-        if ((ret = lept_parse_value(c, &e)) != LEPT_PARSE_OK)
-            break;
-        memcpy(lept_context_push(c, sizeof(lept_value)), &e, sizeof(lept_value));
-        size++;
-        lept_parse_whitespace(c);
-        if (*c->json == ',') {
-            c->json++;
-            lept_parse_whitespace(c);
-        }
-        else if (*c->json == ']') {
-            c->json++;
-            v->type = LEPT_ARRAY;
-            v->u.a.size = size;
-            size *= sizeof(lept_value);
-            memcpy(v->u.a.e = (lept_value*)malloc(size), lept_context_pop(c, size), size);
-            return LEPT_PARSE_OK;
-        }
-        else {
-            ret = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
-            break;
-        }
-    }
-    /* Pop and free values on the stack */
-    for (i = 0; i < size; i++)
-        lept_free((lept_value*)lept_context_pop(c, sizeof(lept_value)));
-    return ret;
+/* 5^i scaled to 125 bits, rounded down: { low, high } */
+LEPT_EXTENSION static const lept_u64 lept_pow5_split[326][2] = {
+    { 0x0000000000000000ULL, 0x1000000000000000ULL }, { 0x0000000000000000ULL, 0x1400000000000000ULL },
+    { 0x0000000000000000ULL, 0x1900000000000000ULL }, { 0x0000000000000000ULL, 0x1F40000000000000ULL },
+    { 0x0000000000000000ULL, 0x1388000000000000ULL }, { 0x0000000000000000ULL, 0x186A000000000000ULL },
+    { 0x0000000000000000ULL, 0x1E84800000000000ULL }, { 0x0000000000000000ULL, 0x1312D00000000000ULL },
+    { 0x0000000000000000ULL, 0x17D7840000000000ULL }, { 0x0000000000000000ULL, 0x1DCD650000000000ULL },
+    { 0x0000000000000000ULL, 0x12A05F2000000000ULL }, { 0x0000000000000000ULL, 0x174876E800000000ULL },
+    { 0x0000000000000000ULL, 0x1D1A94A200000000ULL }, { 0x0000000000000000ULL, 0x12309CE540000000ULL },
+    { 0x0000000000000000ULL, 0x16BCC41E90000000ULL }, { 0x0000000000000000ULL, 0x1C6BF52634000000ULL },
+    { 0x0000000000000000ULL, 0x11C37937E0800000ULL }, { 0x0000000000000000ULL, 0x16345785D8A00000ULL },
+    { 0x0000000000000000ULL, 0x1BC16D674EC80000ULL }, { 0x0000000000000000ULL, 0x1158E460913D0000ULL },
+    { 0x0000000000000000ULL, 0x15AF1D78B58C4000ULL }, { 0x0000000000000000ULL, 0x1B1AE4D6E2EF5000ULL },
+    { 0x0000000000000000ULL, 0x10F0CF064DD59200ULL }, { 0x0000000000000000ULL, 0x152D02C7E14AF680ULL },
+    { 0x0000000000000000ULL, 0x1A784379D99DB420ULL }, { 0x0000000000000000ULL, 0x108B2A2C28029094ULL },
+    { 0x0000000000000000ULL, 0x14ADF4B7320334B9ULL }, { 0x4000000000000000ULL, 0x19D971E4FE8401E7ULL },
+    { 0x8800000000000000ULL, 0x1027E72F1F128130ULL }, { 0xAA00000000000000ULL, 0x1431E0FAE6D7217CULL },
+    { 0xD480000000000000ULL, 0x193E5939A08CE9DBULL }, { 0xC9A0000000000000ULL, 0x1F8DEF8808B02452ULL },
+    { 0xBE04000000000000ULL, 0x13B8B5B5056E16B3ULL }, { 0xAD85000000000000ULL, 0x18A6E32246C99C60ULL },
+    { 0xD8E6400000000000ULL, 0x1ED09BEAD87C0378ULL }, { 0x878FE80000000000ULL, 0x13426172C74D822BULL },
+    { 0x6973E20000000000ULL, 0x1812F9CF7920E2B6ULL }, { 0x03D0DA8000000000ULL, 0x1E17B84357691B64ULL },
+    { 0x8262889000000000ULL, 0x12CED32A16A1B11EULL }, { 0x22FB2AB400000000ULL, 0x178287F49C4A1D66ULL },
+    { 0xABB9F56100000000ULL, 0x1D6329F1C35CA4BFULL }, { 0xCB54395CA0000000ULL, 0x125DFA371A19E6F7ULL },
+    { 0xBE2947B3C8000000ULL, 0x16F578C4E0A060B5ULL }, { 0x2DB399A0BA000000ULL, 0x1CB2D6F618C878E3ULL },
+    { 0xFC90400474400000ULL, 0x11EFC659CF7D4B8DULL }, { 0x7BB4500591500000ULL, 0x166BB7F0435C9E71ULL },
+    { 0xDAA16406F5A40000ULL, 0x1C06A5EC5433C60DULL }, { 0xA8A4DE8459868000ULL, 0x118427B3B4A05BC8ULL },
+    { 0xD2CE16256FE82000ULL, 0x15E531A0A1C872BAULL }, { 0x87819BAECBE22800ULL, 0x1B5E7E08CA3A8F69ULL },
+    { 0xF4B1014D3F6D5900ULL, 0x111B0EC57E6499A1ULL }, { 0x71DD41A08F48AF40ULL, 0x1561D276DDFDC00AULL },
+    { 0x0E549208B31ADB10ULL, 0x1ABA4714957D300DULL }, { 0x28F4DB456FF0C8EAULL, 0x10B46C6CDD6E3E08ULL },
+    { 0x33321216CBECFB24ULL, 0x14E1878814C9CD8AULL }, { 0xBFFE969C7EE839EDULL, 0x1A19E96A19FC40ECULL },
+    { 0xF7FF1E21CF512434ULL, 0x105031E2503DA893ULL }, { 0xF5FEE5AA43256D41ULL, 0x14643E5AE44D12B8ULL },
+    { 0x337E9F14D3EEC892ULL, 0x197D4DF19D605767ULL }, { 0x005E46DA08EA7AB6ULL, 0x1FDCA16E04B86D41ULL },
+    { 0xA03AEC4845928CB2ULL, 0x13E9E4E4C2F34448ULL }, { 0xC849A75A56F72FDEULL, 0x18E45E1DF3B0155AULL },
+    { 0x7A5C1130ECB4FBD6ULL, 0x1F1D75A5709C1AB1ULL }, { 0xEC798ABE93F11D65ULL, 0x13726987666190AEULL },
+    { 0xA797ED6E38ED64BFULL, 0x184F03E93FF9F4DAULL }, { 0x517DE8C9C728BDEFULL, 0x1E62C4E38FF87211ULL },
+    { 0xD2EEB17E1C7976B5ULL, 0x12FDBB0E39FB474AULL }, { 0x87AA5DDDA397D462ULL, 0x17BD29D1C87A191DULL },
+    { 0xE994F5550C7DC97BULL, 0x1DAC74463A989F64ULL }, { 0x11FD195527CE9DEDULL, 0x128BC8ABE49F639FULL },
+    { 0xD67C5FAA71C24568ULL, 0x172EBAD6DDC73C86ULL }, { 0x8C1B77950E32D6C2ULL, 0x1CFA698C95390BA8ULL },
+    { 0x57912ABD28DFC639ULL, 0x121C81F7DD43A749ULL }, { 0xAD75756C7317B7C8ULL, 0x16A3A275D494911BULL },
+    { 0x98D2D2C78FDDA5BAULL, 0x1C4C8B1349B9B562ULL }, { 0x9F83C3BCB9EA8794ULL, 0x11AFD6EC0E14115DULL },
+    { 0x0764B4ABE8652979ULL, 0x161BCCA7119915B5ULL }, { 0x493DE1D6E27E73D7ULL, 0x1BA2BFD0D5FF5B22ULL },
+    { 0x6DC6AD264D8F0866ULL, 0x1145B7E285BF98F5ULL }, { 0xC938586FE0F2CA80ULL, 0x159725DB272F7F32ULL },
+    { 0x7B866E8BD92F7D20ULL, 0x1AFCEF51F0FB5EFFULL }, { 0xAD34051767BDAE34ULL, 0x10DE1593369D1B5FULL },
+    { 0x9881065D41AD19C1ULL, 0x15159AF804446237ULL }, { 0x7EA147F492186032ULL, 0x1A5B01B605557AC5ULL },
+    { 0x6F24CCF8DB4F3C1FULL, 0x1078E111C3556CBBULL }, { 0x4AEE003712230B27ULL, 0x14971956342AC7EAULL },
+    { 0xDDA98044D6ABCDF0ULL, 0x19BCDFABC13579E4ULL }, { 0x0A89F02B062B60B6ULL, 0x10160BCB58C16C2FULL },
+    { 0xCD2C6C35C7B638E4ULL, 0x141B8EBE2EF1C73AULL }, { 0x8077874339A3C71DULL, 0x1922726DBAAE3909ULL },
+    { 0xE0956914080CB8E4ULL, 0x1F6B0F092959C74BULL }, { 0x6C5D61AC8507F38EULL, 0x13A2E965B9D81C8FULL },
+    { 0x4774BA17A649F072ULL, 0x188BA3BF284E23B3ULL }, { 0x1951E89D8FDC6C8FULL, 0x1EAE8CAEF261ACA0ULL },
+    { 0x0FD3316279E9C3D9ULL, 0x132D17ED577D0BE4ULL }, { 0x13C7FDBB186434CFULL, 0x17F85DE8AD5C4EDDULL },
+    { 0x58B9FD29DE7D4203ULL, 0x1DF67562D8B36294ULL }, { 0xB7743E3A2B0E4942ULL, 0x12BA095DC7701D9CULL },
+    { 0xE5514DC8B5D1DB92ULL, 0x17688BB5394C2503ULL }, { 0xDEA5A13AE3465277ULL, 0x1D42AEA2879F2E44ULL },
+    { 0x0B2784C4CE0BF38AULL, 0x1249AD2594C37CEBULL }, { 0xCDF165F6018EF06DULL, 0x16DC186EF9F45C25ULL },
+    { 0x416DBF7381F2AC88ULL, 0x1C931E8AB871732FULL }, { 0x88E497A83137ABD5ULL, 0x11DBF316B346E7FDULL },
+    { 0xEB1DBD923D8596CAULL, 0x1652EFDC6018A1FCULL }, { 0x25E52CF6CCE6FC7DULL, 0x1BE7ABD3781ECA7CULL },
+    { 0x97AF3C1A40105DCEULL, 0x1170CB642B133E8DULL }, { 0xFD9B0B20D0147542ULL, 0x15CCFE3D35D80E30ULL },
+    { 0x3D01CDE904199292ULL, 0x1B403DCC834E11BDULL }, { 0x462120B1A28FFB9BULL, 0x1108269FD210CB16ULL },
+    { 0xD7A968DE0B33FA82ULL, 0x154A3047C694FDDBULL }, { 0xCD93C3158E00F923ULL, 0x1A9CBC59B83A3D52ULL },
+    { 0xC07C59ED78C09BB6ULL, 0x10A1F5B813246653ULL }, { 0xB09B7068D6F0C2A3ULL, 0x14CA732617ED7FE8ULL },
+    { 0xDCC24C830CACF34CULL, 0x19FD0FEF9DE8DFE2ULL }, { 0xC9F96FD1E7EC180FULL, 0x103E29F5C2B18BEDULL },
+    { 0x3C77CBC661E71E13ULL, 0x144DB473335DEEE9ULL }, { 0x8B95BEB7FA60E598ULL, 0x1961219000356AA3ULL },
+    { 0x6E7B2E65F8F91EFEULL, 0x1FB969F40042C54CULL }, { 0xC50CFCFFBB9BB35FULL, 0x13D3E2388029BB4FULL },
+    { 0xB6503C3FAA82A037ULL, 0x18C8DAC6A0342A23ULL }, { 0xA3E44B4F95234844ULL, 0x1EFB1178484134ACULL },
+    { 0xE66EAF11BD360D2BULL, 0x135CEAEB2D28C0EBULL }, { 0xE00A5AD62C839075ULL, 0x183425A5F872F126ULL },
+    { 0x980CF18BB7A47493ULL, 0x1E412F0F768FAD70ULL }, { 0x5F0816F752C6C8DCULL, 0x12E8BD69AA19CC66ULL },
+    { 0xF6CA1CB527787B13ULL, 0x17A2ECC414A03F7FULL }, { 0xF47CA3E2715699D7ULL, 0x1D8BA7F519C84F5FULL },
+    { 0xF8CDE66D86D62026ULL, 0x127748F9301D319BULL }, { 0xF7016008E88BA830ULL, 0x17151B377C247E02ULL },
+    { 0xB4C1B80B22AE923CULL, 0x1CDA62055B2D9D83ULL }, { 0x50F91306F5AD1B65ULL, 0x12087D4358FC8272ULL },
+    { 0xE53757C8B318623FULL, 0x168A9C942F3BA30EULL }, { 0x9E852DBADFDE7ACFULL, 0x1C2D43B93B0A8BD2ULL },
+    { 0xA3133C94CBEB0CC1ULL, 0x119C4A53C4E69763ULL }, { 0x8BD80BB9FEE5CFF1ULL, 0x16035CE8B6203D3CULL },
+    { 0xAECE0EA87E9F43EEULL, 0x1B843422E3A84C8BULL }, { 0x4D40C9294F238A75ULL, 0x1132A095CE492FD7ULL },
+    { 0x2090FB73A2EC6D12ULL, 0x157F48BB41DB7BCDULL }, { 0x68B53A508BA78856ULL, 0x1ADF1AEA12525AC0ULL },
+    { 0x417144725748B536ULL, 0x10CB70D24B7378B8ULL }, { 0x51CD958EED1AE283ULL, 0x14FE4D06DE5056E6ULL },
+    { 0xE640FAF2A8619B24ULL, 0x1A3DE04895E46C9FULL }, { 0xEFE89CD7A93D00F7ULL, 0x1066AC2D5DAEC3E3ULL },
+    { 0xEBE2C40D938C4134ULL, 0x14805738B51A74DCULL }, { 0x26DB7510F86F5181ULL, 0x19A06D06E2611214ULL },
+    { 0x9849292A9B4592F1ULL, 0x100444244D7CAB4CULL }, { 0xBE5B73754216F7ADULL, 0x1405552D60DBD61FULL },
+    { 0xADF25052929CB598ULL, 0x1906AA78B912CBA7ULL }, { 0x996EE4673743E2FFULL, 0x1F485516E7577E91ULL },
+    { 0xFFE54EC0828A6DDFULL, 0x138D352E5096AF1AULL }, { 0xBFDEA270A32D0957ULL, 0x18708279E4BC5AE1ULL },
+    { 0x2FD64B0CCBF84BADULL, 0x1E8CA3185DEB719AULL }, { 0x5DE5EEE7FF7B2F4CULL, 0x1317E5EF3AB32700ULL },
+    { 0x755F6AA1FF59FB1FULL, 0x17DDDF6B095FF0C0ULL }, { 0x92B7454A7F3079E7ULL, 0x1DD55745CBB7ECF0ULL },
+    { 0x5BB28B4E8F7E4C30ULL, 0x12A5568B9F52F416ULL }, { 0xF29F2E22335DDF3CULL, 0x174EAC2E8727B11BULL },
+    { 0xEF46F9AAC035570BULL, 0x1D22573A28F19D62ULL }, { 0xD58C5C0AB8215667ULL, 0x123576845997025DULL },
+    { 0x4AEF730D6629AC01ULL, 0x16C2D4256FFCC2F5ULL }, { 0x9DAB4FD0BFB41701ULL, 0x1C73892ECBFBF3B2ULL },
+    { 0xA28B11E277D08E60ULL, 0x11C835BD3F7D784FULL }, { 0x8B2DD65B15C4B1F9ULL, 0x163A432C8F5CD663ULL },
+    { 0x6DF94BF1DB35DE77ULL, 0x1BC8D3F7B3340BFCULL }, { 0xC4BBCF772901AB0AULL, 0x115D847AD000877DULL },
+    { 0x35EAC354F34215CDULL, 0x15B4E5998400A95DULL }, { 0x8365742A30129B40ULL, 0x1B221EFFE500D3B4ULL },
+    { 0xD21F689A5E0BA108ULL, 0x10F5535FEF208450ULL }, { 0x06A742C0F58E894AULL, 0x1532A837EAE8A565ULL },
+    { 0x4851137132F22B9DULL, 0x1A7F5245E5A2CEBEULL }, { 0xED32AC26BFD75B42ULL, 0x108F936BAF85C136ULL },
+    { 0xA87F57306FCD3212ULL, 0x14B378469B673184ULL }, { 0xD29F2CFC8BC07E97ULL, 0x19E056584240FDE5ULL },
+    { 0xA3A37C1DD7584F1EULL, 0x102C35F729689EAFULL }, { 0x8C8C5B254D2E62E6ULL, 0x14374374F3C2C65BULL },
+    { 0x6FAF71EEA079FB9FULL, 0x1945145230B377F2ULL }, { 0x0B9B4E6A48987A87ULL, 0x1F965966BCE055EFULL },
+    { 0x674111026D5F4C94ULL, 0x13BDF7E0360C35B5ULL }, { 0xC111554308B71FBAULL, 0x18AD75D8438F4322ULL },
+    { 0x7155AA93CAE4E7A8ULL, 0x1ED8D34E547313EBULL }, { 0x26D58A9C5ECF10C9ULL, 0x13478410F4C7EC73ULL },
+    { 0xF08AED437682D4FBULL, 0x1819651531F9E78FULL }, { 0xECADA89454238A3AULL, 0x1E1FBE5A7E786173ULL },
+    { 0x73EC895CB4963664ULL, 0x12D3D6F88F0B3CE8ULL }, { 0x90E7ABB3E1BBC3FDULL, 0x1788CCB6B2CE0C22ULL },
+    { 0x352196A0DA2AB4FDULL, 0x1D6AFFE45F818F2BULL }, { 0x0134FE24885AB11EULL, 0x1262DFEEBBB0F97BULL },
+    { 0xC1823DADAA715D65ULL, 0x16FB97EA6A9D37D9ULL }, { 0x31E2CD19150DB4BFULL, 0x1CBA7DE5054485D0ULL },
+    { 0x1F2DC02FAD2890F7ULL, 0x11F48EAF234AD3A2ULL }, { 0xA6F9303B9872B535ULL, 0x1671B25AEC1D888AULL },
+    { 0x50B77C4A7E8F6282ULL, 0x1C0E1EF1A724EAADULL }, { 0x5272ADAE8F199D91ULL, 0x1188D357087712ACULL },
+    { 0x670F591A32E004F6ULL, 0x15EB082CCA94D757ULL }, { 0x40D32F60BF980633ULL, 0x1B65CA37FD3A0D2DULL },
+    { 0x4883FD9C77BF03E0ULL, 0x111F9E62FE44483CULL }, { 0x5AA4FD0395AEC4D8ULL, 0x156785FBBDD55A4BULL },
+    { 0x314E3C447B1A760EULL, 0x1AC1677AAD4AB0DEULL }, { 0xDED0E5AACCF089C9ULL, 0x10B8E0ACAC4EAE8AULL },
+    { 0x96851F15802CAC3BULL, 0x14E718D7D7625A2DULL }, { 0xFC2666DAE037D74AULL, 0x1A20DF0DCD3AF0B8ULL },
+    { 0x9D980048CC22E68EULL, 0x10548B68A044D673ULL }, { 0x84FE005AFF2BA032ULL, 0x1469AE42C8560C10ULL },
+    { 0xA63D8071BEF6883EULL, 0x198419D37A6B8F14ULL }, { 0xCFCCE08E2EB42A4EULL, 0x1FE52048590672D9ULL },
+    { 0x21E00C58DD309A70ULL, 0x13EF342D37A407C8ULL }, { 0x2A580F6F147CC10DULL, 0x18EB0138858D09BAULL },
+    { 0xB4EE134AD99BF150ULL, 0x1F25C186A6F04C28ULL }, { 0x7114CC0EC80176D2ULL, 0x137798F428562F99ULL },
+    { 0xCD59FF127A01D486ULL, 0x18557F31326BBB7FULL }, { 0xC0B07ED7188249A8ULL, 0x1E6ADEFD7F06AA5FULL },
+    { 0xD86E4F466F516E09ULL, 0x1302CB5E6F642A7BULL }, { 0xCE89E3180B25C98BULL, 0x17C37E360B3D351AULL },
+    { 0x822C5BDE0DEF3BEEULL, 0x1DB45DC38E0C8261ULL }, { 0xF15BB96AC8B58575ULL, 0x1290BA9A38C7D17CULL },
+    { 0x2DB2A7C57AE2E6D2ULL, 0x1734E940C6F9C5DCULL }, { 0x391F51B6D99BA086ULL, 0x1D022390F8B83753ULL },
+    { 0x03B3931248014454ULL, 0x1221563A9B732294ULL }, { 0x04A077D6DA019569ULL, 0x16A9ABC9424FEB39ULL },
+    { 0x45C895CC9081FAC3ULL, 0x1C5416BB92E3E607ULL }, { 0x8B9D5D9FDA513CBAULL, 0x11B48E353BCE6FC4ULL },
+    { 0xAE84B507D0E58BE8ULL, 0x1621B1C28AC20BB5ULL }, { 0x1A25E249C51EEEE3ULL, 0x1BAA1E332D728EA3ULL },
+    { 0xF057AD6E1B33554DULL, 0x114A52DFFC679925ULL }, { 0x6C6D98C9A2002AA1ULL, 0x159CE797FB817F6FULL },
+    { 0x4788FEFC0A803549ULL, 0x1B04217DFA61DF4BULL }, { 0x0CB59F5D8690214EULL, 0x10E294EEBC7D2B8FULL },
+    { 0xCFE30734E83429A1ULL, 0x151B3A2A6B9C7672ULL }, { 0x83DBC9022241340AULL, 0x1A6208B50683940FULL },
+    { 0xB2695DA15568C086ULL, 0x107D457124123C89ULL }, { 0x1F03B509AAC2F0A7ULL, 0x149C96CD6D16CBACULL },
+    { 0x26C4A24C1573ACD1ULL, 0x19C3BC80C85C7E97ULL }, { 0x783AE56F8D684C03ULL, 0x101A55D07D39CF1EULL },
+    { 0x16499ECB70C25F03ULL, 0x1420EB449C8842E6ULL }, { 0x9BDC067E4CF2F6C4ULL, 0x19292615C3AA539FULL },
+    { 0x82D3081DE02FB476ULL, 0x1F736F9B3494E887ULL }, { 0xB1C3E512AC1DD0C9ULL, 0x13A825C100DD1154ULL },
+    { 0xDE34DE57572544FCULL, 0x18922F31411455A9ULL }, { 0x55C215ED2CEE963BULL, 0x1EB6BAFD91596B14ULL },
+    { 0xB5994DB43C151DE5ULL, 0x133234DE7AD7E2ECULL }, { 0xE2FFA1214B1A655EULL, 0x17FEC216198DDBA7ULL },
+    { 0xDBBF89699DE0FEB6ULL, 0x1DFE729B9FF15291ULL }, { 0x2957B5E202AC9F31ULL, 0x12BF07A143F6D39BULL },
+    { 0xF3ADA35A8357C6FEULL, 0x176EC98994F48881ULL }, { 0x70990C31242DB8BDULL, 0x1D4A7BEBFA31AAA2ULL },
+    { 0x865FA79EB69C9376ULL, 0x124E8D737C5F0AA5ULL }, { 0xE7F791866443B854ULL, 0x16E230D05B76CD4EULL },
+    { 0xA1F575E7FD54A669ULL, 0x1C9ABD04725480A2ULL }, { 0xA53969B0FE54E801ULL, 0x11E0B622C774D065ULL },
+    { 0x0E87C41D3DEA2202ULL, 0x1658E3AB7952047FULL }, { 0xD229B5248D64AA82ULL, 0x1BEF1C9657A6859EULL },
+    { 0x435A1136D85EEA91ULL, 0x117571DDF6C81383ULL }, { 0x143095848E76A536ULL, 0x15D2CE55747A1864ULL },
+    { 0x193CBAE5B2144E83ULL, 0x1B4781EAD1989E7DULL }, { 0x2FC5F4CF8F4CB112ULL, 0x110CB132C2FF630EULL },
+    { 0xBBB77203731FDD56ULL, 0x154FDD7F73BF3BD1ULL }, { 0x2AA54E844FE7D4ACULL, 0x1AA3D4DF50AF0AC6ULL },
+    { 0xDAA75112B1F0E4EBULL, 0x10A6650B926D66BBULL }, { 0xD15125575E6D1E26ULL, 0x14CFFE4E7708C06AULL },
+    { 0x85A56EAD360865B0ULL, 0x1A03FDE214CAF085ULL }, { 0x7387652C41C53F8EULL, 0x10427EAD4CFED653ULL },
+    { 0x50693E7752368F71ULL, 0x14531E58A03E8BE8ULL }, { 0x64838E1526C4334EULL, 0x1967E5EEC84E2EE2ULL },
+    { 0xFDA4719A70754022ULL, 0x1FC1DF6A7A61BA9AULL }, { 0xDE86C70086494815ULL, 0x13D92BA28C7D14A0ULL },
+    { 0x162878C0A7DB9A1AULL, 0x18CF768B2F9C59C9ULL }, { 0x5BB296F0D1D280A1ULL, 0x1F03542DFB83703BULL },
+    { 0x194F9E5683239064ULL, 0x1362149CBD322625ULL }, { 0x5FA385EC23EC747EULL, 0x183A99C3EC7EAFAEULL },
+    { 0xF78C67672CE7919DULL, 0x1E494034E79E5B99ULL }, { 0x3AB7C0A07C10BB02ULL, 0x12EDC82110C2F940ULL },
+    { 0x4965B0C89B14E9C3ULL, 0x17A93A2954F3B790ULL }, { 0x5BBF1CFAC1DA2433ULL, 0x1D9388B3AA30A574ULL },
+    { 0xB957721CB92856A0ULL, 0x127C35704A5E6768ULL }, { 0xE7AD4EA3E7726C48ULL, 0x171B42CC5CF60142ULL },
+    { 0xA198A24CE14F075AULL, 0x1CE2137F74338193ULL }, { 0x44FF65700CD16498ULL, 0x120D4C2FA8A030FCULL },
+    { 0x563F3ECC1005BDBEULL, 0x16909F3B92C83D3BULL }, { 0x2BCF0E7F14072D2EULL, 0x1C34C70A777A4C8AULL },
+    { 0x5B61690F6C847C3DULL, 0x11A0FC668AAC6FD6ULL }, { 0xF239C35347A59B4CULL, 0x16093B802D578BCBULL },
+    { 0xEEC83428198F021FULL, 0x1B8B8A6038AD6EBEULL }, { 0x553D20990FF96153ULL, 0x1137367C236C6537ULL },
+    { 0x2A8C68BF53F7B9A8ULL, 0x1585041B2C477E85ULL }, { 0x752F82EF28F5A812ULL, 0x1AE64521F7595E26ULL },
+    { 0x093DB1D57999890BULL, 0x10CFEB353A97DAD8ULL }, { 0x0B8D1E4AD7FFEB4EULL, 0x1503E602893DD18EULL },
+    { 0x8E7065DD8DFFE622ULL, 0x1A44DF832B8D45F1ULL }, { 0xF9063FAA78BFEFD5ULL, 0x106B0BB1FB384BB6ULL },
+    { 0xB747CF9516EFEBCAULL, 0x1485CE9E7A065EA4ULL }, { 0xE519C37A5CABE6BDULL, 0x19A742461887F64DULL },
+    { 0xAF301A2C79EB7036ULL, 0x1008896BCF54F9F0ULL }, { 0xDAFC20B798664C43ULL, 0x140AABC6C32A386CULL },
+    { 0x11BB28E57E7FDF54ULL, 0x190D56B873F4C688ULL }, { 0x1629F31EDE1FD72AULL, 0x1F50AC6690F1F82AULL },
+    { 0x4DDA37F34AD3E67AULL, 0x13926BC01A973B1AULL }, { 0xE150C5F01D88E019ULL, 0x187706B0213D09E0ULL },
+    { 0x19A4F76C24EB181FULL, 0x1E94C85C298C4C59ULL }, { 0xB0071AA39712EF13ULL, 0x131CFD3999F7AFB7ULL },
+    { 0x9C08E14C7CD7AAD8ULL, 0x17E43C8800759BA5ULL }, { 0x030B199F9C0D958EULL, 0x1DDD4BAA0093028FULL },
+    { 0x61E6F003C1887D79ULL, 0x12AA4F4A405BE199ULL }, { 0xBA60AC04B1EA9CD7ULL, 0x1754E31CD072D9FFULL },
+    { 0xA8F8D705DE65440DULL, 0x1D2A1BE4048F907FULL }, { 0xC99B8663AAFF4A88ULL, 0x123A516E82D9BA4FULL },
+    { 0xBC0267FC95BF1D2AULL, 0x16C8E5CA239028E3ULL }, { 0xAB0301FBBB2EE474ULL, 0x1C7B1F3CAC74331CULL },
+    { 0xEAE1E13D54FD4EC9ULL, 0x11CCF385EBC89FF1ULL }, { 0x659A598CAA3CA27BULL, 0x1640306766BAC7EEULL },
+    { 0xFF00EFEFD4CBCB1AULL, 0x1BD03C81406979E9ULL }, { 0x3F6095F5E4FF5EF0ULL, 0x116225D0C841EC32ULL },
+    { 0xCF38BB735E3F36ACULL, 0x15BAAF44FA52673EULL }, { 0x8306EA5035CF0457ULL, 0x1B295B1638E7010EULL },
+    { 0x11E4527221A162B6ULL, 0x10F9D8EDE39060A9ULL }, { 0x565D670EAA09BB64ULL, 0x15384F295C7478D3ULL },
+    { 0x2BF4C0D2548C2A3DULL, 0x1A8662F3B3919708ULL }, { 0x1B78F88374D79A66ULL, 0x1093FDD8503AFE65ULL },
+    { 0x625736A4520D8100ULL, 0x14B8FD4E6449BDFEULL }, { 0xFAED044D6690E140ULL, 0x19E73CA1FD5C2D7DULL },
+    { 0xBCD422B0601A8CC8ULL, 0x103085E53E599C6EULL }, { 0x6C092B5C78212FFAULL, 0x143CA75E8DF0038AULL },
+    { 0x070B763396297BF8ULL, 0x194BD136316C046DULL }, { 0x48CE53C07BB3DAF6ULL, 0x1F9EC583BDC70588ULL },
+    { 0x2D80F4584D5068DAULL, 0x13C33B72569C6375ULL }, { 0x78E1316E60A48310ULL, 0x18B40A4EEC437C52ULL }
+};
+
+/* 2^(bits(5^i) - 1 + 125) / 5^i, rounded up: { low, high } */
+LEPT_EXTENSION static const lept_u64 lept_pow5_inv_split[342][2] = {
+    { 0x0000000000000001ULL, 0x2000000000000000ULL }, { 0x999999999999999AULL, 0x1999999999999999ULL },
+    { 0x47AE147AE147AE15ULL, 0x147AE147AE147AE1ULL }, { 0x6C8B4395810624DEULL, 0x10624DD2F1A9FBE7ULL },
+    { 0x7A786C226809D496ULL, 0x1A36E2EB1C432CA5ULL }, { 0x61F9F01B866E43ABULL, 0x14F8B588E368F084ULL },
+    { 0xB4C7F34938583622ULL, 0x10C6F7A0B5ED8D36ULL }, { 0x87A6520EC08D236AULL, 0x1AD7F29ABCAF4857ULL },
+    { 0x9FB841A566D74F88ULL, 0x15798EE2308C39DFULL }, { 0xE62D01511F12A607ULL, 0x112E0BE826D694B2ULL },
+    { 0xD6AE6881CB5109A4ULL, 0x1B7CDFD9D7BDBAB7ULL }, { 0xDEF1ED34A2A73AEAULL, 0x15FD7FE17964955FULL },
+    { 0x7F27F0F6E885C8BBULL, 0x119799812DEA1119ULL }, { 0x650CB4BE40D60DF8ULL, 0x1C25C268497681C2ULL },
+    { 0xEA70909833DE7193ULL, 0x16849B86A12B9B01ULL }, { 0x21F3A6E0297EC143ULL, 0x1203AF9EE756159BULL },
+    { 0x6985D7CD0F313537ULL, 0x1CD2B297D889BC2BULL }, { 0x2137DFD73F5A90F9ULL, 0x170EF54646D49689ULL },
+    { 0xE75FE645CC4873FAULL, 0x12725DD1D243ABA0ULL }, { 0xA5663D3C7A0D865DULL, 0x1D83C94FB6D2AC34ULL },
+    { 0x511E976394D79EB1ULL, 0x179CA10C9242235DULL }, { 0xDA7EDF82DD794BC1ULL, 0x12E3B40A0E9B4F7DULL },
+    { 0x2A6498D1625BAC68ULL, 0x1E392010175EE596ULL }, { 0xEEB6E0A781E2F053ULL, 0x182DB34012B25144ULL },
+    { 0x58924D52CE4F26A9ULL, 0x1357C299A88EA76AULL }, { 0x27507BB7B07EA441ULL, 0x1EF2D0F5DA7DD8AAULL },
+    { 0x52A6C95FC0655034ULL, 0x18C240C4AECB13BBULL }, { 0x0EEBD44C99EAA690ULL, 0x13CE9A36F23C0FC9ULL },
+    { 0xB17953ADC3110A80ULL, 0x1FB0F6BE50601941ULL }, { 0xC12DDC8B02740867ULL, 0x195A5EFEA6B34767ULL },
+    { 0x3424B06F3529A052ULL, 0x14484BFEEBC29F86ULL }, { 0x901D59F290EE19DBULL, 0x1039D66589687F9EULL },
+    { 0x4CFBC31DB4B0295FULL, 0x19F623D5A8A73297ULL }, { 0x3D9635B15D59BAB2ULL, 0x14C4E977BA1F5BACULL },
+    { 0x97AB5E277DE16228ULL, 0x109D8792FB4C4956ULL }, { 0xF2ABC9D8C9689D0DULL, 0x1A95A5B7F87A0EF0ULL },
+    { 0x5BBCA17A3ABA173EULL, 0x154484932D2E725AULL }, { 0xAFCA1AC82EFB45CBULL, 0x11039D428A8B8EAEULL },
+    { 0xB2DCF7A6B1920945ULL, 0x1B38FB9DAA78E44AULL }, { 0xF57D92EBC141A104ULL, 0x15C72FB1552D836EULL },
+    { 0xC46475896767B403ULL, 0x116C262777579C58ULL }, { 0x6D6D88DBD8A5ECD2ULL, 0x1BE03D0BF225C6F4ULL },
+    { 0x8ABE071646EB23DBULL, 0x164CFDA3281E38C3ULL }, { 0x6EFE6C11D255B649ULL, 0x11D7314F534B609CULL },
+    { 0xB197134FB6EF8A0EULL, 0x1C8B821885456760ULL }, { 0x27AC0F72F8BFA1A5ULL, 0x16D601AD376AB91AULL },
+    { 0xB95672C260994E1EULL, 0x1244CE242C5560E1ULL }, { 0xF5571E03CDC21695ULL, 0x1D3AE36D13BBCE35ULL },
+    { 0x2AAC18030B01ABABULL, 0x17624F8A762FD82BULL }, { 0xBBBCE0026F348956ULL, 0x12B50C6EC4F31355ULL },
+    { 0x92C7CCD0B1EDA889ULL, 0x1DEE7A4AD4B81EEFULL }, { 0xDBD30A408E57BA07ULL, 0x17F1FB6F10934BF2ULL },
+    { 0x7CA8D50071DFC806ULL, 0x1327FC58DA0F6FF5ULL }, { 0xFAA7BB33E9660CD6ULL, 0x1EA6608E29B24CBBULL },
+    { 0x9552FC298784D711ULL, 0x18851A0B548EA3C9ULL }, { 0xAAA8C9BAD2D0AC0EULL, 0x139DAE6F76D88307ULL },
+    { 0xDDDADC5E1E1AACE3ULL, 0x1F62B0B257C0D1A5ULL }, { 0x7E48B04B4B488A4FULL, 0x191BC08EAC9A4151ULL },
+    { 0xCB6D59D5D5D3A1D9ULL, 0x141633A556E1CDDAULL }, { 0x3C577B1177DC817BULL, 0x1011C2EAABE7D7E2ULL },
+    { 0xC6F25E825960CF2AULL, 0x19B604AAACA62636ULL }, { 0x6BF518684780A5BBULL, 0x14919D5556EB51C5ULL },
+    { 0x232A79ED06008496ULL, 0x10747DDDDF22A7D1ULL }, { 0xD1DD8FE1A3340756ULL, 0x1A53FC9631D10C81ULL },
+    { 0xA7E4731AE8F66C45ULL, 0x150FFD44F4A73D34ULL }, { 0x531D28E253F8569EULL, 0x10D9976A5D52975DULL },
+    { 0xEB61DB03B98D5762ULL, 0x1AF5BF109550F22EULL }, { 0xBC4E48CFC7A445E8ULL, 0x159165A6DDDA5B58ULL },
+    { 0x6371D3D96C836B20ULL, 0x11411E1F17E1E2ADULL }, { 0x9F1C8628AD9F11CDULL, 0x1B9B6364F3030448ULL },
+    { 0xE5B06B53BE18DB0BULL, 0x1615E91D8F359D06ULL }, { 0xEAF3890FCB4715A2ULL, 0x11AB20E472914A6BULL },
+    { 0x44B8DB4C7871BC37ULL, 0x1C45016D841BAA46ULL }, { 0x03C715D6C6C1635FULL, 0x169D9ABE03495505ULL },
+    { 0x3638DE456BCDE919ULL, 0x1217AEFE69077737ULL }, { 0x56C163A2461641C1ULL, 0x1CF2B1970E725858ULL },
+    { 0xDF011C81D1AB67CEULL, 0x17288E1271F51379ULL }, { 0x7F3416CE4155ECA5ULL, 0x1286D80EC190DC61ULL },
+    { 0x6520247D3556476EULL, 0x1DA48CE468E7C702ULL }, { 0xEA801D30F7783925ULL, 0x17B6D71D20B96C01ULL },
+    { 0xBB99B0F3F92CFA84ULL, 0x12F8AC174D612334ULL }, { 0x5F5C4E532847F739ULL, 0x1E5AACF215683854ULL },
+    { 0x7F7D0B75B9D32C2EULL, 0x18488A5B44536043ULL }, { 0x9930D5F7C7DC2358ULL, 0x136D3B7C36A919CFULL },
+    { 0x8EB4898C72F9D226ULL, 0x1F152BF9F10E8FB2ULL }, { 0x722A07A38F2E41B8ULL, 0x18DDBCC7F40BA628ULL },
+    { 0xC1BB394FA5BE9AFAULL, 0x13E497065CD61E86ULL }, { 0x9C5EC2190930F7F6ULL, 0x1FD424D6FAF030D7ULL },
+    { 0x49E56814075A5FF8ULL, 0x197683DF2F268D79ULL }, { 0x6E51201005E1E660ULL, 0x145ECFE5BF520AC7ULL },
+    { 0xF1DA800CD181851AULL, 0x104BD984990E6F05ULL }, { 0x4FC400148268D4F5ULL, 0x1A12F5A0F4E3E4D6ULL },
+    { 0xD96999AA01ED772BULL, 0x14DBF7B3F71CB711ULL }, { 0xADEE1488018AC5BCULL, 0x10AFF95CC5B09274ULL },
+    { 0x497CEDA668DE092CULL, 0x1AB328946F80EA54ULL }, { 0x3ACA57B853E4D424ULL, 0x155C2076BF9A5510ULL },
+    { 0x623B7960431D7683ULL, 0x1116805EFFAEAA73ULL }, { 0x9D2BF566D1C8BD9EULL, 0x1B5733CB32B110B8ULL },
+    { 0x7DBCC452416D647FULL, 0x15DF5CA28EF40D60ULL }, { 0xCAFD69DB678AB6CCULL, 0x117F7D4ED8C33DE6ULL },
+    { 0xAB2F0FC572778ADFULL, 0x1BFF2EE48E052FD7ULL }, { 0x88F273045B92D580ULL, 0x1665BF1D3E6A8CACULL },
+    { 0xD3F528D049424466ULL, 0x11EAFF4A98553D56ULL }, { 0xB988414D4203A0A3ULL, 0x1CAB3210F3BB9557ULL },
+    { 0x6139CDD76802E6E9ULL, 0x16EF5B40C2FC7779ULL }, { 0xE761717920025254ULL, 0x125915CD68C9F92DULL },
+    { 0xA568B58E999D5086ULL, 0x1D5B561574765B7CULL }, { 0x5120913EE14AA6D2ULL, 0x177C44DDF6C515FDULL },
+    { 0xA74D40FF1AA21F0EULL, 0x12C9D0B1923744CAULL }, { 0x0BAECE64F769CB4AULL, 0x1E0FB44F50586E11ULL },
+    { 0x3C8BD850C5EE3C3BULL, 0x180C903F7379F1A7ULL }, { 0xCA0979DA37F1C9C9ULL, 0x133D4032C2C7F485ULL },
+    { 0xA9A8C2F6BFE942DBULL, 0x1EC866B79E0CBA6FULL }, { 0x2153CF2BCCBA9BE3ULL, 0x18A0522C7E709526ULL },
+    { 0x1AA9728970954982ULL, 0x13B374F06526DDB8ULL }, { 0xF775840F1A88759DULL, 0x1F8587E7083E2F8CULL },
+    { 0x5F9136727BA05E17ULL, 0x19379FEC0698260AULL }, { 0x1940F85B9619E4DFULL, 0x142C7FF0054684D5ULL },
+    { 0xE100C6AFAB47EA4CULL, 0x1023998CD1053710ULL }, { 0xCE67A44C453FDD47ULL, 0x19D28F47B4D524E7ULL },
+    { 0xD852E9D69DCCB106ULL, 0x14A8729FC3DDB71FULL }, { 0x79DBEE454B0A2738ULL, 0x1086C219697E2C19ULL },
+    { 0x295FE3A211A9D859ULL, 0x1A71368F0F30468FULL }, { 0xBAB31C81A7BB137AULL, 0x15275ED8D8F36BA5ULL },
+    { 0x6228E39AEC95A92FULL, 0x10EC4BE0AD8F8951ULL }, { 0x9D0E38F7E0EF7517ULL, 0x1B13AC9AAF4C0EE8ULL },
+    { 0xB0D82D931A592A79ULL, 0x15A956E225D67253ULL }, { 0x8D79BE0F4847552EULL, 0x11544581B7DEC1DCULL },
+    { 0x158F967EDA0BBB7CULL, 0x1BBA08CF8C979C94ULL }, { 0x77A611FF14D62F97ULL, 0x162E6D72D6DFB076ULL },
+    { 0xF951A7FF43DE8C79ULL, 0x11BEBDF578B2F391ULL }, { 0xC21C3FFED2FDAD8EULL, 0x1C6463225AB7EC1CULL },
+    { 0x01B0333242648AD8ULL, 0x16B6B5B5155FF017ULL }, { 0x0159C28E9B83A246ULL, 0x122BC490DDE659ACULL },
+    { 0xCEF604175F3903A3ULL, 0x1D12D41AFCA3C2ACULL }, { 0x725E69AC4C2D9C83ULL, 0x17424348CA1C9BBDULL },
+    { 0xF5185489D68AE39CULL, 0x129B69070816E2FDULL }, { 0xEE8D540FBDAB05C6ULL, 0x1DC574D80CF16B2FULL },
+    { 0xBED77672FE226B05ULL, 0x17D12A4670C1228CULL }, { 0xFF12C528CB4EBC04ULL, 0x130DBB6B8D674ED6ULL },
+    { 0xCB513B74787DF9A0ULL, 0x1E7C5F127BD87E24ULL }, { 0x090DC929F9FE614DULL, 0x18637F41FCAD31B7ULL },
+    { 0xA0D7D42194CB810AULL, 0x1382CC34CA2427C5ULL }, { 0x67BFB9CF5478CE77ULL, 0x1F37AD21436D0C6FULL },
+    { 0x1FCC94A5DD2D71F9ULL, 0x18F9574DCF8A7059ULL }, { 0x7FD6DD517DBDF4C7ULL, 0x13FAAC3E3FA1F37AULL },
+    { 0xFFBE2EE8C92FEE0BULL, 0x1FF779FD329CB8C3ULL }, { 0x6631BF20A0F324D6ULL, 0x1992C7FDC216FA36ULL },
+    { 0xB827CC1A1A5C1D78ULL, 0x14756CCB01ABFB5EULL }, { 0x935309AE7B7CE460ULL, 0x105DF0A267BCC918ULL },
+    { 0x1EEB42B0C594A099ULL, 0x1A2FE76A3F9474F4ULL }, { 0xE58902270476E6E1ULL, 0x14F31F8832DD2A5CULL },
+    { 0xB7A0CE859D2BEBE7ULL, 0x10C27FA028B0EEB0ULL }, { 0x59014A6F61DFDFD8ULL, 0x1AD0CC33744E4AB4ULL },
+    { 0xE0CDD525E7E64CADULL, 0x1573D68F903EA229ULL }, { 0x4D7177518651D6F1ULL, 0x11297872D9CBB4EEULL },
+    { 0x7BE8BEE8D6E957E8ULL, 0x1B758D848FAC54B0ULL }, { 0xFCBA3253DF211320ULL, 0x15F7A46A0C89DD59ULL },
+    { 0x63C8284318E74280ULL, 0x1192E9EE706E4AAEULL }, { 0x060D0D3827D86A66ULL, 0x1C1E43171A4A1117ULL },
+    { 0x6B3DA42CECAD21EBULL, 0x167E9C127B6E7412ULL }, { 0x88FE1CF0BD574E56ULL, 0x11FEE341FC585CDBULL },
+    { 0x419694B462254A23ULL, 0x1CCB0536608D615FULL }, { 0x67ABAA29E81DD4E9ULL, 0x1708D0F84D3DE77FULL },
+    { 0xB95621BB2017DD87ULL, 0x126D73F9D764B932ULL }, { 0xC223692B668C95A5ULL, 0x1D7BECC2F23AC1EAULL },
+    { 0xCE82BA891ED6DE1DULL, 0x179657025B6234BBULL }, { 0xA53562074BDF1818ULL, 0x12DEAC01E2B4F6FCULL },
+    { 0x3B889CD87964F359ULL, 0x1E3113363787F194ULL }, { 0xFC6D4A46C783F5E1ULL, 0x18274291C6065ADCULL },
+    { 0x30576E9F06032B1AULL, 0x13529BA7D19EAF17ULL }, { 0x1A257DCB3CD1DE90ULL, 0x1EEA92A61C311825ULL },
+    { 0x481DFE3C30A7E540ULL, 0x18BBA884E35A79B7ULL }, { 0xD34B31C9C0865100ULL, 0x13C9539D82AEC7C5ULL },
+    { 0x5211E942CDA3B4CDULL, 0x1FA885C8D117A609ULL }, { 0x74DB21023E1C90A4ULL, 0x19539E3A40DFB807ULL },
+    { 0xF715B401CB4A0D50ULL, 0x1442E4FB67196005ULL }, { 0xF8DE299B09080AA7ULL, 0x103583FC527AB337ULL },
+    { 0x8E304291A80CDDD7ULL, 0x19EF3993B72AB859ULL }, { 0x3E8D020E200A4B13ULL, 0x14BF6142F8EEF9E1ULL },
+    { 0x653D9B3E80083C0FULL, 0x10991A9BFA58C7E7ULL }, { 0x6EC8F864000D2CE4ULL, 0x1A8E90F9908E0CA5ULL },
+    { 0x8BD3F9E999A423EAULL, 0x153EDA614071A3B7ULL }, { 0x3CA994BAE1501CBBULL, 0x10FF151A99F482F9ULL },
+    { 0xC775BAC49BB3612BULL, 0x1B31BB5DC320D18EULL }, { 0xD2C4956A16291A89ULL, 0x15C162B168E70E0BULL },
+    { 0xDBD0778811BA7BA1ULL, 0x11678227871F3E6FULL }, { 0x2C80BF401C5D929BULL, 0x1BD8D03F3E9863E6ULL },
+    { 0xBD33CC3349E47549ULL, 0x16470CFF6546B651ULL }, { 0xCA8FD68F6E505DD4ULL, 0x11D270CC51055EA7ULL },
+    { 0x4419574BE3B3C953ULL, 0x1C83E7AD4E6EFDD9ULL }, { 0x0347790982F63AA9ULL, 0x16CFEC8AA52597E1ULL },
+    { 0xCF6C60D468C4FBBAULL, 0x123FF06EEA847980ULL }, { 0xE57A34870E07F92AULL, 0x1D331A4B10D3F59AULL },
+    { 0x512E906C0B399422ULL, 0x175C1508DA432AE2ULL }, { 0xDA8BA6BCD5C7A9B5ULL, 0x12B010D3E1CF5581ULL },
+    { 0x90DF712E22D90F87ULL, 0x1DE6815302E5559CULL }, { 0xDA4C5A8B4F140C6CULL, 0x17EB9AA8CF1DDE16ULL },
+    { 0xAEA37BA2A5A9A38AULL, 0x1322E220A5B17E78ULL }, { 0x7DD25F6AA2A905A9ULL, 0x1E9E369AA2B59727ULL },
+    { 0x97DB7F888220D154ULL, 0x187E92154EF7AC1FULL }, { 0x797C6606CE80A777ULL, 0x139874DDD8C6234CULL },
+    { 0x8F2D700AE4010BF1ULL, 0x1F5A549627A36BADULL }, { 0x0C2459A25000D65AULL, 0x191510781FB5EFBEULL },
+    { 0x701D1481D99A4515ULL, 0x1410D9F9B2F7F2FEULL }, { 0xC017439B147B6A77ULL, 0x100D7B2E28C65BFEULL },
+    { 0xCCF205C4ED9243F2ULL, 0x19AF2B7D0E0A2CCAULL }, { 0x0A5B37D0BE0E9CC2ULL, 0x148C22CA71A1BD6FULL },
+    { 0x0848F973CB3EE3CEULL, 0x10701BD527B4978CULL }, { 0xDA0E5BEC78649FB0ULL, 0x1A4CF9550C5425ACULL },
+    { 0x7B3EAFF060507FC0ULL, 0x150A6110D6A9B7BDULL }, { 0x95CBBFF380406633ULL, 0x10D51A73DEEE2C97ULL },
+    { 0xEFAC665266CD7052ULL, 0x1AEE90B964B04758ULL }, { 0x2623850EB8A459DBULL, 0x158BA6FAB6F36C47ULL },
+    { 0x1E82D0D893B6AE49ULL, 0x113C85955F29236CULL }, { 0xFD9E1AF41F8AB075ULL, 0x1B9408EEFEA838ACULL },
+    { 0x97B1AF29B2D559F7ULL, 0x16100725988693BDULL }, { 0xAC8E25BAF5777B2CULL, 0x11A66C1E139EDC97ULL },
+    { 0x7A7D092B2258C513ULL, 0x1C3D79C9B8FE2DBFULL }, { 0x61FDA0EF4EAD6A76ULL, 0x169794A160CB57CCULL },
+    { 0xE7FE1A590BBDEEC5ULL, 0x1212DD4DE7091309ULL }, { 0xA6635D5B45FCB13AULL, 0x1CEAFBAFD80E84DCULL },
+    { 0x851C4AAF6B308DC8ULL, 0x172262F3133ED0B0ULL }, { 0xD0E36EF2BC26D7D4ULL, 0x1281E8C275CBDA26ULL },
+    { 0xB49F17EAC6A48C86ULL, 0x1D9CA79D894629D7ULL }, { 0x2A18DFEF0550706BULL, 0x17B08617A104EE46ULL },
+    { 0x54E0B3259DD9F389ULL, 0x12F39E794D9D8B6BULL }, { 0x87CDEB6F62F65274ULL, 0x1E5297287C2F4578ULL },
+    { 0xD30B22BF825EA85DULL, 0x18421286C9BF6AC6ULL }, { 0x0F3C1BCC684BB9E4ULL, 0x13680ED23AFF889FULL },
+    { 0x18602C7A4079296DULL, 0x1F0CE4839198DA98ULL }, { 0x46B356C833942124ULL, 0x18D71D360E13E213ULL },
+    { 0x388F78A029434DB6ULL, 0x13DF4A91A4DCB4DCULL }, { 0x5A7F2766A86BAF8AULL, 0x1FCBAA82A1612160ULL },
+    { 0x153285EBB9EFBFA2ULL, 0x196FBB9BB44DB44DULL }, { 0xAA8ED189618C994EULL, 0x145962E2F6A4903DULL },
+    { 0xEED8A7A11AD6E10CULL, 0x1047824F2BB6D9CAULL }, { 0x7E27729B5E249B45ULL, 0x1A0C03B1DF8AF611ULL },
+    { 0xFE85F549181D4904ULL, 0x14D6695B193BF80DULL }, { 0xCB9E5DD4134AA0D0ULL, 0x10AB877C142FF9A4ULL },
+    { 0xDF63C9535211014DULL, 0x1AAC0BF9B9E65C3AULL }, { 0x191CA10F74DA6771ULL, 0x15566FFAFB1EB02FULL },
+    { 0xADB080D92A4852C1ULL, 0x1111F32F2F4BC025ULL }, { 0x15E7348EAA0D5134ULL, 0x1B4FEB7EB212CD09ULL },
+    { 0xAB1F5D3EEE710DC4ULL, 0x15D98932280F0A6DULL }, { 0xBC1917658B8DA49DULL, 0x117AD428200C0857ULL },
+    { 0x2CF4F23C127C3A94ULL, 0x1BF7B9D9CCE00D59ULL }, { 0xF0C3F4FCDB969543ULL, 0x165FC7E170B33DE0ULL },
+    { 0x5A365D9716121103ULL, 0x11E6398126F5CB1AULL }, { 0x9056FC24F01CE804ULL, 0x1CA38F350B22DE90ULL },
+    { 0xD9DF301D8CE3ECD0ULL, 0x16E93F5DA2824BA6ULL }, { 0xE17F59B13D8323DAULL, 0x125432B14ECEA2EBULL },
+    { 0x68CBC2B52F38395CULL, 0x1D53844EE47DD179ULL }, { 0x53D6355DBF602DE3ULL, 0x177603725064A794ULL },
+    { 0xA9782AB165E68B1CULL, 0x12C4CF8EA6B6EC76ULL }, { 0x0F26AAB56FD744FAULL, 0x1E07B27DD78B13F1ULL },
+    { 0x3F52222ABFDF6A62ULL, 0x18062864AC6F4327ULL }, { 0x65DB4E88997F884EULL, 0x1338205089F29C1FULL },
+    { 0x6FC54A7428CC0D4AULL, 0x1EC033B40FEA9365ULL }, { 0x596AA1F68709A43BULL, 0x1899C2F673220F84ULL },
+    { 0xADEEE7F86C07B696ULL, 0x13AE3591F5B4D936ULL }, { 0x497E3FF3E00C5756ULL, 0x1F7D228322BAF524ULL },
+    { 0xD464FFF64CD6AC45ULL, 0x1930E868E89590E9ULL }, { 0x4383FFF83D7889D1ULL, 0x14272053ED4473EEULL },
+    { 0xCF9CCCC69793A174ULL, 0x101F4D0FF1038FF1ULL }, { 0x7F6147A425B90252ULL, 0x19CBAE7FE805B31CULL },
+    { 0xCC4DD2E9B7C7350FULL, 0x14A2F1FFECD15C16ULL }, { 0x3D0B0F215FD290D9ULL, 0x10825B3323DAB012ULL },
+    { 0x61AB4B689950E7C1ULL, 0x1A6A2B85062AB350ULL }, { 0x4E22A2BA1440B967ULL, 0x1521BC6A6B555C40ULL },
+    { 0x0B4EE894DD009453ULL, 0x10E7C9EEBC4449CDULL }, { 0x1217DA87C800ED51ULL, 0x1B0C764AC6D3A948ULL },
+    { 0xDB46486CA000BDDAULL, 0x15A391D56BDC876CULL }, { 0x490506BD4CCD64AFULL, 0x114FA7DDEFE39F8AULL },
+    { 0xA8080AC87AE23AB1ULL, 0x1BB2A62FE638FF43ULL }, { 0x5339A239FBE82EF4ULL, 0x162884F31E93FF69ULL },
+    { 0x75C7B4FB2FECF25DULL, 0x11BA03F5B20FFF87ULL }, { 0x22D92191E647EA2EULL, 0x1C5CD322B67FFF3FULL },
+    { 0xB57A8141850654F2ULL, 0x16B0A8E891FFFF65ULL }, { 0xC4620101373843F5ULL, 0x1226ED86DB3332B7ULL },
+    { 0x3A366801F1F39FEEULL, 0x1D0B15A491EB8459ULL }, { 0xFB5EB99B27F6198BULL, 0x173C115074BC69E0ULL },
+    { 0x2F7EFAE2865E7AD6ULL, 0x129674405D6387E7ULL }, { 0xE597F7D0D6FD9156ULL, 0x1DBD86CD6238D971ULL },
+    { 0x8479930D78CADAABULL, 0x17CAD23DE82D7AC1ULL }, { 0xD06142712D6F1556ULL, 0x1308A831868AC89AULL },
+    { 0x4D686A4EAF182222ULL, 0x1E74404F3DAADA91ULL }, { 0xA453883EF279B4E8ULL, 0x185D003F6488AEDAULL },
+    { 0xE9DC6CFF28615D87ULL, 0x137D99CC506D58AEULL }, { 0xA960AE650D6895A4ULL, 0x1F2F5C7A1A488DE4ULL },
+    { 0xBAB3BEB73DED4483ULL, 0x18F2B061AEA07183ULL }, { 0x2EF6322C318A9D36ULL, 0x13F559E7BEE6C136ULL },
+    { 0xE4BD1D13827761F0ULL, 0x1FEEF63F97D79B89ULL }, { 0x83CA7DA9352C4E5AULL, 0x198BF832DFDFAFA1ULL },
+    { 0x9CA1FE20F756A515ULL, 0x146FF9C24CB2F2E7ULL }, { 0x4A1B31B3F9121DAAULL, 0x1059949B708F28B9ULL },
+    { 0x435EB5ECC1B695DDULL, 0x1A28EDC580E50DF5ULL }, { 0x35E55E57015EDE4AULL, 0x14ED8B04671DA4C4ULL },
+    { 0xC4B77EAC0118B1D5ULL, 0x10BE08D0527E1D69ULL }, { 0xA12597799B5AB622ULL, 0x1AC9A7B3B7302F0FULL },
+    { 0x4DB7AC6149155E81ULL, 0x156E1FC2F8F358D9ULL }, { 0xD7C6238107444B9BULL, 0x1124E63593F5E0ADULL },
+    { 0x593D059B3ED3AC2BULL, 0x1B6E3D2286563449ULL }, { 0xE0FD9E15CBDC89BCULL, 0x15F1CA820511C36DULL },
+    { 0xB3FE18116FE3A163ULL, 0x118E3B9B37416924ULL }, { 0x866359B57FD29BD1ULL, 0x1C16C5C525357507ULL },
+    { 0xD1E91491330EE30EULL, 0x16789E3750F790D2ULL }, { 0x74BA76DA8F3F1C0BULL, 0x11FA182C40C60D75ULL },
+    { 0xEDF72490E531C678ULL, 0x1CC359E067A348BBULL }, { 0x8B2C1D40B75B052DULL, 0x1702AE4D1FB5D3C9ULL },
+    { 0x6F567DCD5F7C0424ULL, 0x12688B70E62B0FD4ULL }, { 0x7EF0C94898C66D06ULL, 0x1D74124E3D11B2EDULL },
+    { 0x98C0A106E09EBD9FULL, 0x17900EA4FDA7C257ULL }, { 0x470080D24D4BCAE6ULL, 0x12D9A550CAEC9B79ULL },
+    { 0xD800CE1D487944A2ULL, 0x1E29088144ADC58EULL }, { 0x1333D8176D2DD082ULL, 0x1820D39A9D57D13FULL },
+    { 0xA8F646792424A6CEULL, 0x134D76154AACA765ULL }, { 0x74BD3D8EA03AA47DULL, 0x1EE25688777AA56FULL },
+    { 0x5D64313EE6955064ULL, 0x18B51206C5FBB78CULL }, { 0x4AB68DCBEBAAA6B7ULL, 0x13C40E6BD1962C70ULL },
+    { 0x1124161312AAA457ULL, 0x1FA01712E8F0471AULL }, { 0xDA8344DC0EEEE9DFULL, 0x194CDF4253F36C14ULL },
+    { 0xE2029D7CD8BF2180ULL, 0x143D7F6843292343ULL }, { 0x4E687DFD7A328133ULL, 0x103132B9CF541C36ULL },
+    { 0x4A40C9959050CEB8ULL, 0x19E851294BB9C6BDULL }, { 0x0833D477A6A70BC6ULL, 0x14B9DA876FC7D231ULL },
+    { 0xA02976C61EEC096BULL, 0x1094AED2BFD30E8DULL }, { 0x004257A364ACDBDFULL, 0x1A877E1DFFB81749ULL },
+    { 0xCD01DFB5EA23E319ULL, 0x153931B1996012A0ULL }, { 0x70CE4C91881CB5AEULL, 0x10FA8E27ADE6754DULL },
+    { 0x1AE3ADB5A69455E2ULL, 0x1B2A7D0C4970BBAFULL }, { 0x7BE957C4854377E8ULL, 0x15BB973D078D62F2ULL },
+    { 0xC987796A0435F987ULL, 0x1162DF64060AB58EULL }, { 0x75A58F1006BCC271ULL, 0x1BD1656CD67788E4ULL },
+    { 0xF7B7A5A66BCA3527ULL, 0x16411DF0AB92D3E9ULL }, { 0x5FC61E1EBCA1C41FULL, 0x11CDB18D560F0FEEULL },
+    { 0xFFA363646102D365ULL, 0x1C7C4F4889B1B316ULL }, { 0x32E91C504D9BDC51ULL, 0x16C9D906D48E28DFULL },
+    { 0x8F20E37371497D0EULL, 0x123B140576D820B2ULL }, { 0x7E9B0585820F2E7CULL, 0x1D2B533BF159CDEAULL },
+    { 0xCBAF379E01A5BECAULL, 0x1755DC2FF447D7EEULL }, { 0x0958F94B348498A1ULL, 0x12AB168CC36CACBFULL }
+};
+
+#define LEPT_POW5_BITS(e)   ((int)(((unsigned long)(e) * 1217359ul) >> 19) + 1)  /* ceil(log2(5^e)), e > 0 */
+#define LEPT_LOG10_POW2(e)  ((int)(((unsigned long)(e) * 78913ul) >> 18))       /* floor(log10(2^e)) */
+#define LEPT_LOG10_POW5(e)  ((int)(((unsigned long)(e) * 732923ul) >> 20))      /* floor(log10(5^e)) */
+
+/* (m * mul) >> j for a 128-bit mul, 64 < j < 128 */
+static lept_u64 lept_mul_shift64(lept_u64 m, const lept_u64* mul, int j) {
+    lept_u64 lo0, lo2, hi2;
+    lept_u64 hi0 = lept_mul64(m, mul[0], &lo0);
+    hi2 = lept_mul64(m, mul[1], &lo2);
+    lo2 += hi0;
+    hi2 += lo2 < hi0;
+    j -= 64;
+    return (hi2 << (64 - j)) | (lo2 >> j);
 }
 
-static int lept_parse_object(lept_context* c, lept_value* v) {
-    size_t i, size;
-    lept_member m;
-    int ret;
-    EXPECT(c, '{');
-    lept_parse_whitespace(c);
-    if (*c->json == '}') {
-        c->json++;
-        v->type = LEPT_OBJECT;
-        v->u.o.m = 0;
-        v->u.o.size = 0;
-        return LEPT_PARSE_OK;
+static int lept_multiple_of_pow5(lept_u64 v, int p) {
+    for (; p > 0 && v % 5 == 0; p--)
+        v /= 5;
+    return p <= 0;
+}
+
+/* Digits and decimal exponent of the shortest representation of a finite, nonzero double. */
+static lept_u64 lept_ryu(lept_u64 ieee_mantissa, int ieee_exponent, int* exponent) {
+    lept_u64 m2, mv, vr, vp, vm, output;
+    int e2, e10, q, i, k, removed = 0, mm_shift, even;
+    int vm_trailing_zeros = 0, vr_trailing_zeros = 0, last_removed = 0;
+    if (ieee_exponent == 0) {
+        e2 = 1 - 1023 - 52 - 2;
+        m2 = ieee_mantissa;
     }
-    m.k = NULL;
-    size = 0;
-    for (;;) {
-        char* str;
-        lept_init(&m.v);
-        /* parse key */
-        if (*c->json != '"') {
-            ret = LEPT_PARSE_MISS_KEY;
-            break;
-        }
-        if ((ret = lept_parse_string_raw(c, &str, &m.klen)) != LEPT_PARSE_OK)
-            break;
-        memcpy(m.k = (char*)malloc(m.klen + 1), str, m.klen);
-        m.k[m.klen] = '\0';
-        /* parse ws colon ws */
-        lept_parse_whitespace(c);
-        if (*c->json != ':') {
-            ret = LEPT_PARSE_MISS_COLON;
-            break;
+    else {
+        e2 = ieee_exponent - 1023 - 52 - 2;
+        m2 = (LEPT_U64(1) << 52) | ieee_mantissa;
+    }
+    even = (m2 & 1) == 0;
+    /* the interval of representations that round back: (4*m2 - 1 - mm_shift, 4*m2 + 2) * 2^e2 / 4 */
+    mv = 4 * m2;
+    mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+    if (e2 >= 0) {
+        q = LEPT_LOG10_POW2(e2) - (e2 > 3);
+        e10 = q;
+        k = LEPT_POW5_INV_BITCOUNT + LEPT_POW5_BITS(q) - 1;
+        i = -e2 + q + k;
+        vr = lept_mul_shift64(mv, lept_pow5_inv_split[q], i);
+        vp = lept_mul_shift64(mv + 2, lept_pow5_inv_split[q], i);
+        vm = lept_mul_shift64(mv - 1 - mm_shift, lept_pow5_inv_split[q], i);
+        if (q <= 21) {
+            if (mv % 5 == 0)
+                vr_trailing_zeros = lept_multiple_of_pow5(mv, q);
+            else if (even)
+                vm_trailing_zeros = lept_multiple_of_pow5(mv - 1 - mm_shift, q);
+            else
+                vp -= lept_multiple_of_pow5(mv + 2, q);
         }
-        c->json++;
-        lept_parse_whitespace(c);
-        /* parse value */
-        if ((ret = lept_parse_value(c, &m.v)) != LEPT_PARSE_OK)
-            break;
-        memcpy(lept_context_push(c, sizeof(lept_member)), &m, sizeof(lept_member));
-        size++;
-        m.k = NULL; /* ownership is transferred to member on stack */
-        /* parse ws [comma | right-curly-brace] ws */
-        lept_parse_whitespace(c);
-        if (*c->json == ',') {
-            c->json++;
-            lept_parse_whitespace(c);
+    }
+    else {
+        q = LEPT_LOG10_POW5(-e2) - (-e2 > 1);
+        e10 = q + e2;
+        i = -e2 - q;
+        k = LEPT_POW5_BITS(i) - LEPT_POW5_BITCOUNT;
+        vr = lept_mul_shift64(mv, lept_pow5_split[i], q - k);
+        vp = lept_mul_shift64(mv + 2, lept_pow5_split[i], q - k);
+        vm = lept_mul_shift64(mv - 1 - mm_shift, lept_pow5_split[i], q - k);
+        if (q <= 1) {
+            vr_trailing_zeros = 1;
+            if (even)
+                vm_trailing_zeros = mm_shift == 1;
+            else
+                vp--;
         }
-        else if (*c->json == '}') {
-            size_t s = sizeof(lept_member) * size;
-            c->json++;
-            v->type = LEPT_OBJECT;
-            v->u.o.size = size;
-            memcpy(v->u.o.m = (lept_member*)malloc(s), lept_context_pop(c, s), s);
-            return LEPT_PARSE_OK;
+        else if (q < 63)
+            vr_trailing_zeros = (mv & ((LEPT_U64(1) << q) - 1)) == 0;
+    }
+
+    /* drop digits while the interval still contains a shorter candidate */
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = (int)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
         }
-        else {
-            ret = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
-            break;
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = (int)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
         }
+        if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0)
+            last_removed = 4; /* exactly ...50..0: round half to even */
+        output = vr + ((vr == vm && (!even || !vm_trailing_zeros)) || last_removed >= 5);
     }
-    /* Pop and free members on the stack */
-    free(m.k);
-    for (i = 0; i < size; i++) {
-        lept_member* m = (lept_member*)lept_context_pop(c, sizeof(lept_member));
-        free(m->k);
-        lept_free(&m->v);
+    else {
+        int round_up = 0;
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || round_up);
     }
-    v->type = LEPT_NULL;
-    return ret;
+    *exponent = e10 + removed;
+    return output;
 }
 
-static int lept_parse_value(lept_context* c, lept_value* v) {
-    switch (*c->json) {
-        case 't':  return lept_parse_literal(c, v, "true", LEPT_TRUE);
-        case 'f':  return lept_parse_literal(c, v, "false", LEPT_FALSE);
-        case 'n':  return lept_parse_literal(c, v, "null", LEPT_NULL);
-        default:   return lept_parse_number(c, v);
-        case '"':  return lept_parse_string(c, v);
-        case '[':  return lept_parse_array(c, v);
-        case '{':  return lept_parse_object(c, v);
-        case '\0': return LEPT_PARSE_EXPECT_VALUE;
+/* Writes v laid out like printf("%.17g") but with the shortest digits; returns the length. */
+static int lept_format_double(char* buffer, double v) {
+    char digits[20];
+    char* p = buffer;
+    lept_u64 bits, mantissa, output;
+    int exponent, n, i, x;
+    memcpy(&bits, &v, sizeof(bits));
+    mantissa = bits & ((LEPT_U64(1) << 52) - 1);
+    exponent = (int)((bits >> 52) & 0x7FF);
+    if (exponent == 0x7FF) { /* JSON has no Infinity or NaN */
+        memcpy(buffer, "null", 4);
+        return 4;
+    }
+    if (bits >> 63)
+        *p++ = '-';
+    if (exponent == 0 && mantissa == 0) {
+        *p++ = '0';
+        return (int)(p - buffer);
+    }
+    output = lept_ryu(mantissa, exponent, &exponent);
+    for (n = 0; output != 0; output /= 10)
+        digits[n++] = (char)('0' + (int)(output % 10));  /* reversed */
+    x = exponent + n - 1;   /* scientific exponent */
+    if (x < -4 || x >= 17) {
+        *p++ = digits[n - 1];
+        if (n > 1) {
+            *p++ = '.';
+            for (i = n - 2; i >= 0; i--)
+                *p++ = digits[i];
+        }
+        *p++ = 'e';
+        *p++ = x < 0 ? '-' : '+';
+        if (x < 0)
+            x = -x;
+        if (x >= 100)
+            *p++ = (char)('0' + x / 100);
+        *p++ = (char)('0' + x / 10 % 10);
+        *p++ = (char)('0' + x % 10);
+    }
+    else if (x < 0) {
+        *p++ = '0';
+        *p++ = '.';
+        for (i = -1; i > x; i--)
+            *p++ = '0';
+        for (i = n - 1; i >= 0; i--)
+            *p++ = digits[i];
+    }
+    else {
+        for (i = n - 1; i >= 0; i--) {
+            *p++ = digits[i];
+            if (i == n - 1 - x && i > 0)
+                *p++ = '.';
+        }
+        for (i = n - 1; i < x; i++)
+            *p++ = '0';
     }
+    return (int)(p - buffer);
 }
 
-int lept_parse(lept_value* v, const char* json) {
-    lept_context c;
-    int ret;
-    assert(v != NULL);
-    c.json = json;
-    c.stack = NULL;
-    c.size = c.top = 0;
-    lept_init(v);
-    lept_parse_whitespace(&c);
-    if ((ret = lept_parse_value(&c, v)) == LEPT_PARSE_OK) {
-        lept_parse_whitespace(&c);
-        if (*c.json != '\0') {
-            v->type = LEPT_NULL;
-            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
-        }
+/* Length of lept_format_double(v). Integers, the most common JSON numbers, are measured without Ryu. */
+static size_t lept_format_double_size(double v) {
+    char buffer[32];
+    double a = v < 0 ? -v : v;
+    if (a >= 1.0 && a < 9007199254740992.0 && (double)(lept_u64)a == a) { /* below 2^53: printed digit for digit */
+        lept_u64 u = (lept_u64)a;
+        size_t n = v < 0;
+        for (; u != 0; u /= 10)
+            n++;
+        return n;
     }
-    assert(c.top == 0);
-    free(c.stack);
-    return ret;
+    return (size_t)lept_format_double(buffer, v);
 }
 
 #if 0
@@ -375,16 +3709,47 @@ static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
     PUTC(c, '"');
 }
 #else
-static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+/* Hands every full chunk to the writer and keeps the rest; after a writer error output is dropped. */
+static void lept_stringify_flush(lept_context* c) {
+    size_t done = 0;
+    while (c->top - done >= c->chunk && c->status == 0) {
+        c->status = c->write_fn(c->write_user, c->stack + done, c->chunk);
+        done += c->chunk;
+    }
+    if (c->status != 0)
+        c->top = 0;
+    else if (done) {
+        memmove(c->stack, c->stack + done, c->top - done);
+        c->top -= done;
+    }
+}
+
+#define STRINGIFY_FLUSH(c) do { if ((c)->top >= (c)->chunk) lept_stringify_flush(c); } while(0)
+
+/* Escaped length of a string including its quotes; clean runs are skipped by the SIMD scanner. */
+static size_t lept_stringify_string_size(const char* s, size_t len) {
+    const char* end = s + len;
+    size_t n = len + 2;
+    while ((s = lept_scan_string(s, end)) != end) {
+        unsigned char ch = (unsigned char)*s++;
+        if (ch < 0x20)
+            n += (ch == '\b' || ch == '\f' || ch == '\n' || ch == '\r' || ch == '\t') ? 1 : 5;
+        else
+            n++;
+    }
+    return n;
+}
+
+static char* lept_stringify_escape(char* p, const char* s, size_t len) {
     static const char hex_digits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
-    size_t i, size;
-    char* head, *p;
-    assert(s != NULL);
-    p = head = lept_context_push(c, size = len * 6 + 2); /* "\u00xx..." */
-    *p++ = '"';
-    for (i = 0; i < len; i++) {
-        unsigned char ch = (unsigned char)s[i];
-        switch (ch) {
+    const char* end = s + len, *q;
+    for (;;) {
+        q = lept_scan_string(s, end); /* copy the clean run up to the next '"', '\\' or control byte at once */
+        memcpy(p, s, (size_t)(q - s));
+        p += q - s;
+        if (q == end)
+            return p;
+        switch (*q) {
             case '\"': *p++ = '\\'; *p++ = '\"'; break;
             case '\\': *p++ = '\\'; *p++ = '\\'; break;
             case '\b': *p++ = '\\'; *p++ = 'b';  break;
@@ -392,46 +3757,58 @@ static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
             case '\n': *p++ = '\\'; *p++ = 'n';  break;
             case '\r': *p++ = '\\'; *p++ = 'r';  break;
             case '\t': *p++ = '\\'; *p++ = 't';  break;
-            default:
-                if (ch < 0x20) {
-                    *p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
-                    *p++ = hex_digits[ch >> 4];
-                    *p++ = hex_digits[ch & 15];
-                }
-                else
-                    *p++ = s[i];
+            default: /* lept_scan_string() stops on nothing else */
+                *p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
+                *p++ = hex_digits[(unsigned char)*q >> 4];
+                *p++ = hex_digits[*q & 15];
         }
+        s = q + 1;
     }
-    *p++ = '"';
-    c->top -= size - (p - head);
+}
+
+/* Reserves exactly the escaped length, so clean strings no longer claim len * 6 bytes. */
+static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+    char* p;
+    assert(s != NULL);
+    PUTC(c, '"');
+    for (; len > c->chunk; s += c->chunk, len -= c->chunk) { /* streaming: escape a long string piecewise */
+        lept_stringify_escape(lept_context_push(c, lept_stringify_string_size(s, c->chunk) - 2), s, c->chunk);
+        lept_stringify_flush(c);
+    }
+    p = lept_context_push(c, lept_stringify_string_size(s, len) - 1);  /* the closing quote included */
+    p = lept_stringify_escape(p, s, len);
+    *p = '"';
 }
 #endif
 
 static void lept_stringify_value(lept_context* c, const lept_value* v) {
     size_t i;
+    LEPT_LAZY_LOAD(v);
     switch (v->type) {
         case LEPT_NULL:   PUTS(c, "null",  4); break;
         case LEPT_FALSE:  PUTS(c, "false", 5); break;
         case LEPT_TRUE:   PUTS(c, "true",  4); break;
-        case LEPT_NUMBER: c->top -= 32 - sprintf(lept_context_push(c, 32), "%.17g", v->u.n); break;
-        case LEPT_STRING: lept_stringify_string(c, v->u.s.s, v->u.s.len); break;
+        case LEPT_NUMBER: c->top -= 32 - lept_format_double(lept_context_push(c, 32), v->u.n); break;
+        case LEPT_STRING: lept_stringify_string(c, LEPT_STRING_PTR(v), LEPT_STRING_LEN(v)); break;
         case LEPT_ARRAY:
             PUTC(c, '[');
-            for (i = 0; i < v->u.a.size; i++) {
+            for (i = 0; i < v->u.a.size && c->status == 0; i++) {
                 if (i > 0)
                     PUTC(c, ',');
                 lept_stringify_value(c, &v->u.a.e[i]);
+                STRINGIFY_FLUSH(c);
             }
             PUTC(c, ']');
             break;
         case LEPT_OBJECT:
             PUTC(c, '{');
-            for (i = 0; i < v->u.o.size; i++) {
+            for (i = 0; i < v->u.o.size && c->status == 0; i++) {
                 if (i > 0)
                     PUTC(c, ',');
-                lept_stringify_string(c, v->u.o.m[i].k, v->u.o.m[i].klen);
+                lept_stringify_string(c, LEPT_KEY_PTR(&v->u.o.m[i]), LEPT_KEY_LEN(&v->u.o.m[i]));
                 PUTC(c, ':');
                 lept_stringify_value(c, &v->u.o.m[i].v);
+                STRINGIFY_FLUSH(c);
             }
             PUTC(c, '}');
             break;
@@ -439,40 +3816,338 @@ static void lept_stringify_value(lept_context* c, const lept_value* v) {
     }
 }
 
+#if LEPT_STATS
+static size_t lept_stringify_escapes(const char* s, size_t len) {
+    const char* end = s + len;
+    size_t n = 0;
+    for (; (s = lept_scan_string(s, end)) != end; s++)
+        n++;
+    return n;
+}
+#endif
+
+/*
+ * Sizing pass: returns the exact output length. With a context it also records, in tree order,
+ * one byte per string and key telling whether it is free of escapes, so that lept_stringify_write()
+ * copies clean strings with memcpy(). Numbers are formatted again by the write pass: that is
+ * cheaper than caching their text, which would grow the stack to about the size of the output.
+ */
+static size_t lept_stringify_size_value(lept_context* c, const lept_value* v) {
+    size_t i, n;
+    LEPT_LAZY_LOAD(v);
+    switch (v->type) {
+        case LEPT_NULL:   return 4;
+        case LEPT_FALSE:  return 5;
+        case LEPT_TRUE:   return 4;
+        case LEPT_NUMBER: return lept_format_double_size(v->u.n);
+        case LEPT_STRING:
+            n = lept_stringify_string_size(LEPT_STRING_PTR(v), LEPT_STRING_LEN(v));
+            if (c) {
+                LEPT_STAT(c, escapes_out += lept_stringify_escapes(LEPT_STRING_PTR(v), LEPT_STRING_LEN(v)));
+                PUTC(c, (char)(n == LEPT_STRING_LEN(v) + 2));
+            }
+            return n;
+        case LEPT_ARRAY:
+            n = v->u.a.size ? v->u.a.size + 1 : 2;  /* brackets and commas */
+            for (i = 0; i < v->u.a.size; i++)
+                n += lept_stringify_size_value(c, &v->u.a.e[i]);
+            return n;
+        case LEPT_OBJECT:
+            n = v->u.o.size ? v->u.o.size * 2 + 1 : 2;  /* braces, colons and commas */
+            for (i = 0; i < v->u.o.size; i++) {
+                size_t klen = LEPT_KEY_LEN(&v->u.o.m[i]);
+                size_t k = lept_stringify_string_size(LEPT_KEY_PTR(&v->u.o.m[i]), klen);
+                if (c) {
+                    LEPT_STAT(c, escapes_out += lept_stringify_escapes(LEPT_KEY_PTR(&v->u.o.m[i]), klen));
+                    PUTC(c, (char)(k == klen + 2));
+                }
+                n += k + lept_stringify_size_value(c, &v->u.o.m[i].v);
+            }
+            return n;
+        default: assert(0 && "invalid type"); return 0;
+    }
+}
+
+static char* lept_stringify_write_string(char* p, const char* s, size_t len, const char** cache) {
+    *p++ = '"';
+    if (*(*cache)++) {
+        memcpy(p, s, len);
+        p += len;
+    }
+    else
+        p = lept_stringify_escape(p, s, len);
+    *p++ = '"';
+    return p;
+}
+
+static size_t lept_stringify_into_string(char* buf, size_t cap, size_t pos, const char* s, size_t len) {
+    size_t n;
+    if (pos > cap)
+        return pos + lept_stringify_string_size(s, len);
+    if (cap - pos < 2 || (cap - pos - 2) / 6 < len) { /* the worst case may not fit */
+        n = lept_stringify_string_size(s, len);
+        if (n > cap - pos)
+            return pos + n;
+    }
+    buf[pos] = '"';
+    n = (size_t)(lept_stringify_escape(buf + pos + 1, s, len) - buf);
+    buf[n] = '"';
+    return n + 1;
+}
+
+/* Write pass into a buffer sized by lept_stringify_size_value(); no bounds checks. */
+static char* lept_stringify_write(char* p, const lept_value* v, const char** cache) {
+    size_t i;
+    switch (v->type) {
+        case LEPT_NULL:   memcpy(p, "null",  4); return p + 4;
+        case LEPT_FALSE:  memcpy(p, "false", 5); return p + 5;
+        case LEPT_TRUE:   memcpy(p, "true",  4); return p + 4;
+        case LEPT_NUMBER: return p + lept_format_double(p, v->u.n);
+        case LEPT_STRING: return lept_stringify_write_string(p, LEPT_STRING_PTR(v), LEPT_STRING_LEN(v), cache);
+        case LEPT_ARRAY:
+            *p++ = '[';
+            for (i = 0; i < v->u.a.size; i++) {
+                if (i > 0)
+                    *p++ = ',';
+                p = lept_stringify_write(p, &v->u.a.e[i], cache);
+            }
+            *p++ = ']';
+            return p;
+        case LEPT_OBJECT:
+            *p++ = '{';
+            for (i = 0; i < v->u.o.size; i++) {
+                if (i > 0)
+                    *p++ = ',';
+                p = lept_stringify_write_string(p, LEPT_KEY_PTR(&v->u.o.m[i]), LEPT_KEY_LEN(&v->u.o.m[i]), cache);
+                *p++ = ':';
+                p = lept_stringify_write(p, &v->u.o.m[i].v, cache);
+            }
+            *p++ = '}';
+            return p;
+        default: assert(0 && "invalid type"); return p;
+    }
+}
+
+#define PUT_INTO(buf, cap, pos, s, len)\
+    do {\
+        if ((pos) <= (cap) && (cap) - (pos) >= (len))\
+            memcpy((buf) + (pos), s, len);\
+        (pos) += (len);\
+    } while(0)
+
+/* Writes what fits of v at buf[pos] and returns pos advanced by the full length; once a piece
+ * does not fit nothing later does either, and the rest is only measured. */
+static size_t lept_stringify_into_value(char* buf, size_t cap, size_t pos, const lept_value* v) {
+    char buffer[32];
+    size_t i, n;
+    LEPT_LAZY_LOAD(v);
+    switch (v->type) {
+        case LEPT_NULL:   PUT_INTO(buf, cap, pos, "null",  4); return pos;
+        case LEPT_FALSE:  PUT_INTO(buf, cap, pos, "false", 5); return pos;
+        case LEPT_TRUE:   PUT_INTO(buf, cap, pos, "true",  4); return pos;
+        case LEPT_NUMBER:
+            n = (size_t)lept_format_double(buffer, v->u.n);
+            PUT_INTO(buf, cap, pos, buffer, n);
+            return pos;
+        case LEPT_STRING:
+            return lept_stringify_into_string(buf, cap, pos, LEPT_STRING_PTR(v), LEPT_STRING_LEN(v));
+        case LEPT_ARRAY:
+            PUT_INTO(buf, cap, pos, "[", 1);
+            for (i = 0; i < v->u.a.size; i++) {
+                if (i > 0)
+                    PUT_INTO(buf, cap, pos, ",", 1);
+                pos = lept_stringify_into_value(buf, cap, pos, &v->u.a.e[i]);
+            }
+            PUT_INTO(buf, cap, pos, "]", 1);
+            return pos;
+        case LEPT_OBJECT:
+            PUT_INTO(buf, cap, pos, "{", 1);
+            for (i = 0; i < v->u.o.size; i++) {
+                if (i > 0)
+                    PUT_INTO(buf, cap, pos, ",", 1);
+                pos = lept_stringify_into_string(buf, cap, pos, LEPT_KEY_PTR(&v->u.o.m[i]), LEPT_KEY_LEN(&v->u.o.m[i]));
+                PUT_INTO(buf, cap, pos, ":", 1);
+                pos = lept_stringify_into_value(buf, cap, pos, &v->u.o.m[i].v);
+            }
+            PUT_INTO(buf, cap, pos, "}", 1);
+            return pos;
+        default: assert(0 && "invalid type"); return pos;
+    }
+}
+
+size_t lept_stringify_size(const lept_value* v) {
+    assert(v != NULL);
+    return lept_stringify_size_value(NULL, v);
+}
+
+int lept_stringify_into(const lept_value* v, char* buf, size_t cap, size_t* needed) {
+    size_t n;
+    assert(v != NULL && (buf != NULL || cap == 0));
+    n = lept_stringify_into_value(buf, cap, 0, v) + 1;
+    if (needed)
+        *needed = n;
+    if (n > cap)
+        return LEPT_STRINGIFY_BUFFER_TOO_SMALL;
+    buf[n - 1] = '\0';
+    return LEPT_STRINGIFY_OK;
+}
+
 char* lept_stringify(const lept_value* v, size_t* length) {
+    return lept_stringify_ex(v, length, NULL);
+}
+
+static char* lept_stringify_sized(lept_context* c, const lept_value* v, size_t* length) {
+    const char* cache;
+    char* json, *end;
+    size_t size;
+#if LEPT_STATS
+    clock_t start = clock();
+#endif
+    size = lept_stringify_size_value(c, v);
+    json = (char*)LEPT_MALLOC(c->alloc, size + 1);
+    LEPT_STAT(c, size_seconds += (double)(clock() - start) / CLOCKS_PER_SEC);
+#if LEPT_STATS
+    start = clock();
+#endif
+    cache = c->stack;
+    end = lept_stringify_write(json, v, &cache);
+    assert(end == json + size && cache == c->stack + c->top);
+    *end = '\0';
+    LEPT_STAT(c, write_seconds += (double)(clock() - start) / CLOCKS_PER_SEC);
+    LEPT_STAT(c, mallocs++);
+    LEPT_STAT(c, malloc_bytes += size + 1);
+    LEPT_STAT(c, bytes_out += size);
+    LEPT_STAT_MAX(c, stack_peak, c->peak);
+    if (c->stack)
+        LEPT_FREE(c->alloc, c->stack);
+    if (length)
+        *length = size;
+    return json;
+}
+
+/* A context with nothing to parse, for building text on its stack. */
+static void lept_stringify_init(lept_context* c, const lept_allocator* a) {
+    lept_context_init(c, "", 0, a);
+}
+
+char* lept_stringify_ex(const lept_value* v, size_t* length, const lept_allocator* a) {
     lept_context c;
     assert(v != NULL);
-    c.stack = (char*)malloc(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
-    c.top = 0;
+    lept_stringify_init(&c, a);
+    return lept_stringify_sized(&c, v, length);
+}
+
+#if LEPT_STATS
+char* lept_stringify_stats(const lept_value* v, size_t* length, lept_stats* s) {
+    lept_context c;
+    assert(v != NULL && s != NULL);
+    lept_stringify_init(&c, NULL);
+    c.stats = s;
+    return lept_stringify_sized(&c, v, length);
+}
+#endif
+
+int lept_stringify_to(const lept_value* v, lept_write_fn write_fn, void* user, size_t chunk_size) {
+    return lept_stringify_to_ex(v, write_fn, user, chunk_size, NULL);
+}
+
+int lept_stringify_to_ex(const lept_value* v, lept_write_fn write_fn, void* user, size_t chunk_size, const lept_allocator* a) {
+    lept_context c;
+    assert(v != NULL && write_fn != NULL && chunk_size > 0);
+    lept_stringify_init(&c, a);
+    c.stack = (char*)LEPT_MALLOC(c.alloc, c.size = chunk_size + LEPT_PARSE_STRINGIFY_INIT_SIZE);
+    c.write_fn = write_fn;
+    c.write_user = user;
+    c.chunk = chunk_size;
     lept_stringify_value(&c, v);
-    if (length)
-        *length = c.top;
-    PUTC(&c, '\0');
-    return c.stack;
+    lept_stringify_flush(&c);
+    if (c.top && c.status == 0)
+        c.status = write_fn(user, c.stack, c.top);
+    LEPT_FREE(c.alloc, c.stack);
+    return c.status;
+}
+
+static int lept_write_file(void* user, const char* data, size_t len) {
+    return fwrite(data, 1, len, (FILE*)user) == len ? 0 : -1;
+}
+
+static int lept_write_fd(void* user, const char* data, size_t len) {
+    int fd = *(const int*)user;
+    while (len > 0) {
+#ifdef _WIN32
+        int n = _write(fd, data, (unsigned)len);
+#else
+        long n = (long)write(fd, data, len);
+#endif
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int lept_stringify_file(const lept_value* v, FILE* fp) {
+    return lept_stringify_file_ex(v, fp, NULL);
+}
+
+int lept_stringify_file_ex(const lept_value* v, FILE* fp, const lept_allocator* a) {
+    assert(fp != NULL);
+    return lept_stringify_to_ex(v, lept_write_file, fp, LEPT_STRINGIFY_CHUNK_SIZE, a);
+}
+
+int lept_stringify_fd(const lept_value* v, int fd) {
+    return lept_stringify_fd_ex(v, fd, NULL);
+}
+
+int lept_stringify_fd_ex(const lept_value* v, int fd, const lept_allocator* a) {
+    return lept_stringify_to_ex(v, lept_write_fd, &fd, LEPT_STRINGIFY_CHUNK_SIZE, a);
 }
 
 void lept_free(lept_value* v) {
+    lept_free_ex(v, NULL);
+}
+
+void lept_free_ex(lept_value* v, const lept_allocator* a) {
     size_t i;
     assert(v != NULL);
+    a = LEPT_ALLOCATOR(a);
+    if (v->flags & LEPT_LAZY) {
+        lept_init(v); /* owns nothing yet */
+        return;
+    }
     switch (v->type) {
         case LEPT_STRING:
-            free(v->u.s.s);
+            if (!(v->flags & (LEPT_BORROWED | LEPT_INLINE)))
+                LEPT_FREE(a, v->u.s.s);
             break;
         case LEPT_ARRAY:
             for (i = 0; i < v->u.a.size; i++)
-                lept_free(&v->u.a.e[i]);
-            free(v->u.a.e);
+                lept_free_ex(&v->u.a.e[i], a);
+            if (v->u.a.e)
+                LEPT_FREE(a, v->u.a.e);
             break;
         case LEPT_OBJECT:
             for (i = 0; i < v->u.o.size; i++) {
-                free(v->u.o.m[i].k);
-                lept_free(&v->u.o.m[i].v);
+                if (!(v->flags & LEPT_BORROWED) && !(v->u.o.m[i].klen & (LEPT_KEY_INLINE | LEPT_KEY_SHARED)))
+                    LEPT_FREE(a, v->u.o.m[i].k);
+                lept_free_ex(&v->u.o.m[i].v, a);
             }
-            free(v->u.o.m);
+            if (v->u.o.size >= LEPT_OBJECT_INDEX_THRESHOLD) {
+                lept_object_header* h = LEPT_OBJECT_HEADER(v);
+                if (h->index)
+                    LEPT_FREE(&h->alloc, h->index); /* built with the parse's allocator */
+                LEPT_FREE(a, h);
+            }
+            else if (v->u.o.m)
+                LEPT_FREE(a, v->u.o.m);
             break;
         default: break;
     }
-    v->type = LEPT_NULL;
+    lept_init(v);
 }
 
 lept_type lept_get_type(const lept_value* v) {
@@ -492,6 +4167,7 @@ void lept_set_boolean(lept_value* v, int b) {
 
 double lept_get_number(const lept_value* v) {
     assert(v != NULL && v->type == LEPT_NUMBER);
+    LEPT_LAZY_LOAD(v);
     return v->u.n;
 }
 
@@ -503,54 +4179,119 @@ void lept_set_number(lept_value* v, double n) {
 
 const char* lept_get_string(const lept_value* v) {
     assert(v != NULL && v->type == LEPT_STRING);
-    return v->u.s.s;
+    LEPT_LAZY_LOAD(v);
+    return LEPT_STRING_PTR(v);
 }
 
 size_t lept_get_string_length(const lept_value* v) {
     assert(v != NULL && v->type == LEPT_STRING);
-    return v->u.s.len;
+    LEPT_LAZY_LOAD(v);
+    return LEPT_STRING_LEN(v);
 }
 
 void lept_set_string(lept_value* v, const char* s, size_t len) {
+    lept_set_string_ex(v, s, len, NULL);
+}
+
+void lept_set_string_ex(lept_value* v, const char* s, size_t len, const lept_allocator* a) {
     assert(v != NULL && (s != NULL || len == 0));
-    lept_free(v);
-    v->u.s.s = (char*)malloc(len + 1);
-    memcpy(v->u.s.s, s, len);
+    a = LEPT_ALLOCATOR(a);
+    lept_free_ex(v, a);
+    v->type = LEPT_STRING;
+    if (lept_string_inline(v, s, len))
+        return;
+    v->u.s.s = (char*)LEPT_MALLOC(a, len + 1);
+    if (len)
+        memcpy(v->u.s.s, s, len);
     v->u.s.s[len] = '\0';
     v->u.s.len = len;
-    v->type = LEPT_STRING;
 }
 
 size_t lept_get_array_size(const lept_value* v) {
     assert(v != NULL && v->type == LEPT_ARRAY);
+    LEPT_LAZY_LOAD(v);
     return v->u.a.size;
 }
 
 lept_value* lept_get_array_element(const lept_value* v, size_t index) {
     assert(v != NULL && v->type == LEPT_ARRAY);
+    LEPT_LAZY_LOAD(v);
     assert(index < v->u.a.size);
     return &v->u.a.e[index];
 }
 
 size_t lept_get_object_size(const lept_value* v) {
     assert(v != NULL && v->type == LEPT_OBJECT);
+    LEPT_LAZY_LOAD(v);
     return v->u.o.size;
 }
 
 const char* lept_get_object_key(const lept_value* v, size_t index) {
     assert(v != NULL && v->type == LEPT_OBJECT);
+    LEPT_LAZY_LOAD(v);
     assert(index < v->u.o.size);
-    return v->u.o.m[index].k;
+    return LEPT_KEY_PTR(&v->u.o.m[index]);
 }
 
 size_t lept_get_object_key_length(const lept_value* v, size_t index) {
     assert(v != NULL && v->type == LEPT_OBJECT);
+    LEPT_LAZY_LOAD(v);
     assert(index < v->u.o.size);
-    return v->u.o.m[index].klen;
+    return LEPT_KEY_LEN(&v->u.o.m[index]);
 }
 
 lept_value* lept_get_object_value(const lept_value* v, size_t index) {
     assert(v != NULL && v->type == LEPT_OBJECT);
+    LEPT_LAZY_LOAD(v);
     assert(index < v->u.o.size);
     return &v->u.o.m[index].v;
 }
+
+static lept_object_index* lept_build_object_index(const lept_value* v) {
+    lept_object_header* h = LEPT_OBJECT_HEADER(v);
+    lept_object_index* index;
+    size_t i, j, capacity = 1, bytes;
+    while (capacity < v->u.o.size * 2)
+        capacity <<= 1;
+    bytes = sizeof(lept_object_index) + (capacity - 1) * sizeof(size_t);
+    index = (lept_object_index*)(h->arena ? lept_arena_alloc_behind(h->arena, &h->alloc, bytes) : LEPT_MALLOC(&h->alloc, bytes));
+    index->mask = capacity - 1;
+    memset(index->slots, 0, capacity * sizeof(size_t));
+    for (i = 0; i < v->u.o.size; i++) {
+        const lept_member* m = &v->u.o.m[i];
+        for (j = lept_hash_key(LEPT_KEY_PTR(m), LEPT_KEY_LEN(m)) & index->mask; index->slots[j]; j = (j + 1) & index->mask) {
+            const lept_member* o = &v->u.o.m[index->slots[j] - 1];
+            if (LEPT_KEY_LEN(o) == LEPT_KEY_LEN(m) && memcmp(LEPT_KEY_PTR(o), LEPT_KEY_PTR(m), LEPT_KEY_LEN(m)) == 0)
+                break; /* duplicate key: the first one wins, as in a linear scan */
+        }
+        if (!index->slots[j])
+            index->slots[j] = i + 1;
+    }
+    return h->index = index;
+}
+
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen) {
+    size_t i;
+    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+    LEPT_LAZY_LOAD(v);
+    if (v->u.o.size >= LEPT_OBJECT_INDEX_THRESHOLD) {
+        lept_object_index* index = LEPT_OBJECT_HEADER(v)->index;
+        if (!index)
+            index = lept_build_object_index(v);
+        for (i = lept_hash_key(key, klen) & index->mask; index->slots[i]; i = (i + 1) & index->mask) {
+            const lept_member* m = &v->u.o.m[index->slots[i] - 1];
+            if (LEPT_KEY_LEN(m) == klen && memcmp(LEPT_KEY_PTR(m), key, klen) == 0)
+                return index->slots[i] - 1;
+        }
+        return LEPT_KEY_NOT_EXIST;
+    }
+    for (i = 0; i < v->u.o.size; i++)
+        if (LEPT_KEY_LEN(&v->u.o.m[i]) == klen && memcmp(LEPT_KEY_PTR(&v->u.o.m[i]), key, klen) == 0)
+            return i;
+    return LEPT_KEY_NOT_EXIST;
+}
+
+lept_value* lept_find_object_value(const lept_value* v, const char* key, size_t klen) {
+    size_t index = lept_find_object_index(v, key, klen);
+    return index != LEPT_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+}
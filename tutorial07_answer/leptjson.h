@@ -2,27 +2,54 @@
 #define LEPTJSON_H__
 
 #include <stddef.h> /* size_t */
+#include <stdio.h>  /* FILE */
 
 typedef enum { LEPT_NULL, LEPT_FALSE, LEPT_TRUE, LEPT_NUMBER, LEPT_STRING, LEPT_ARRAY, LEPT_OBJECT } lept_type;
 
 typedef struct lept_value lept_value;
 typedef struct lept_member lept_member;
 
+/*
+ * LEPT_COMPACT=1 shrinks lept_value from 24 to 16 bytes and lept_member from 40 to 28 (LP64) by
+ * storing lengths and counts as unsigned, which limits each to UINT_MAX, and packing the type and
+ * flags into a byte each. It changes the layout: build the library and its users with the same value.
+ */
+#ifndef LEPT_COMPACT
+#define LEPT_COMPACT 0
+#endif
+
+#if LEPT_COMPACT
+typedef unsigned lept_length;
+#pragma pack(push, 4)
+#else
+typedef size_t lept_length;
+#endif
+
 struct lept_value {
     union {
-        struct { lept_member* m; size_t size; }o;   /* object: members, member count */
-        struct { lept_value* e; size_t size; }a;    /* array:  elements, element count */
-        struct { char* s; size_t len; }s;           /* string: null-terminated string, string length */
-        double n;                                   /* number */
+        struct { lept_member* m; lept_length size; }o;  /* object: members, member count */
+        struct { lept_value* e; lept_length size; }a;   /* array:  elements, element count */
+        struct { char* s; lept_length len; }s;          /* string: null-terminated string, string length */
+        double n;                                       /* number */
     }u;
+#if LEPT_COMPACT
+    unsigned char type;                                 /* lept_type */
+    unsigned char flags;
+#else
     lept_type type;
+    unsigned flags;                                     /* internal ownership bits, 0 after lept_init() */
+#endif
 };
 
 struct lept_member {
-    char* k; size_t klen;   /* member key string, key string length */
-    lept_value v;           /* member value */
+    char* k; lept_length klen;  /* member key string, key string length */
+    lept_value v;               /* member value */
 };
 
+#if LEPT_COMPACT
+#pragma pack(pop)
+#endif
+
 enum {
     LEPT_PARSE_OK = 0,
     LEPT_PARSE_EXPECT_VALUE,
@@ -37,16 +64,218 @@ enum {
     LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
     LEPT_PARSE_MISS_KEY,
     LEPT_PARSE_MISS_COLON,
-    LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+    LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+    LEPT_PARSE_TOO_DEEP,
+    LEPT_PARSE_STOPPED
 };
 
-#define lept_init(v) do { (v)->type = LEPT_NULL; } while(0)
+enum {
+    LEPT_STRINGIFY_OK = 0,
+    LEPT_STRINGIFY_BUFFER_TOO_SMALL
+};
+
+typedef struct {
+    void* (*malloc_fn)(void* user, size_t size);
+    void* (*realloc_fn)(void* user, void* ptr, size_t size);   /* ptr may be NULL */
+    void  (*free_fn)(void* user, void* ptr);                    /* ptr is never NULL */
+    void* user;
+}lept_allocator;
+
+typedef struct lept_arena_block lept_arena_block;
+
+typedef struct {
+    lept_value root;            /* parsed tree, read-only: do not lept_free() or set its nodes */
+    lept_arena_block* arena;    /* chunked blocks holding every node, key and string */
+    const lept_allocator* allocator;
+}lept_document;
+
+typedef struct {
+    void (*lock_fn)(void* user);
+    void (*unlock_fn)(void* user);
+    void* user;
+}lept_lock;
+
+typedef struct lept_intern_pool lept_intern_pool;
+
+typedef struct {
+    char* stack;                /* parse stack kept alive across lept_parser_parse() calls */
+    size_t size, peak;          /* stack capacity, peak stack use since the last trim */
+    unsigned parses, trim_interval;
+    size_t max_depth;           /* nesting limit, at most LEPT_PARSE_MAX_DEPTH (default 1024) */
+    lept_intern_pool* intern;   /* NULL, or the pool every parsed key is looked up in */
+    const lept_allocator* allocator;
+}lept_parser;
+
+/* Events of lept_parse_sax(), in document order. A NULL member skips its event; a callback
+ * returning 0 stops the parse with LEPT_PARSE_STOPPED. Strings and keys are views that are
+ * not NUL-terminated and stay valid only until the callback returns. */
+typedef struct {
+    int (*on_null)(void* user);
+    int (*on_bool)(void* user, int b);
+    int (*on_number)(void* user, double n);
+    int (*on_string)(void* user, const char* s, size_t len);
+    int (*on_start_object)(void* user);
+    int (*on_key)(void* user, const char* k, size_t klen);
+    int (*on_end_object)(void* user);
+    int (*on_start_array)(void* user);
+    int (*on_end_array)(void* user);
+}lept_handler;
+
+#define lept_init(v) do { (v)->type = LEPT_NULL; (v)->flags = 0; } while(0)
 
 int lept_parse(lept_value* v, const char* json);
 char* lept_stringify(const lept_value* v, size_t* length);
+/* Exact length of the text lept_stringify() produces, excluding the terminating '\0'. */
+size_t lept_stringify_size(const lept_value* v);
+/* Writes the NUL-terminated text into buf without allocating. *needed (may be NULL) receives the
+ * capacity the text takes, terminator included; if that exceeds cap the result is
+ * LEPT_STRINGIFY_BUFFER_TOO_SMALL and buf holds an unterminated prefix. buf may be NULL if cap is 0. */
+int lept_stringify_into(const lept_value* v, char* buf, size_t cap, size_t* needed);
 
 void lept_free(lept_value* v);
 
+/*
+ * LEPT_STATS=1 adds lept_parse_stats() and lept_stringify_stats(), which work like lept_parse()
+ * and lept_stringify() and add what they did to *s (zero it first; maxima stay maxima). With the
+ * default 0 the counters are compiled out. Build the library and its users with the same value.
+ */
+#ifndef LEPT_STATS
+#define LEPT_STATS 0
+#endif
+
+#if LEPT_STATS
+typedef struct {
+    size_t bytes_in, bytes_out;         /* input consumed by parsing, text produced by stringifying */
+    size_t nodes[LEPT_OBJECT + 1];      /* values parsed, per lept_type */
+    size_t stack_reallocs, stack_peak;  /* growths and largest size of the working stack */
+    size_t mallocs, malloc_bytes;       /* blocks for nodes, strings, keys and output text */
+    size_t max_depth;                   /* deepest array/object nesting parsed */
+    size_t escapes_in, escapes_out;     /* escape sequences decoded, written */
+    double parse_seconds;
+    double size_seconds, write_seconds; /* the two passes of lept_stringify() */
+}lept_stats;
+
+int lept_parse_stats(lept_value* v, const char* json, lept_stats* s);
+char* lept_stringify_stats(const lept_value* v, size_t* length, lept_stats* s);
+#endif
+
+/* Receives the stringified text piece by piece; returns 0 to continue. */
+typedef int (*lept_write_fn)(void* user, const char* data, size_t len);
+
+/* Streams the text to write_fn in chunk_size pieces (the last may be shorter) while buffering
+ * about one chunk. Returns 0, or the first non-zero result of write_fn, which ends the output.
+ * The file and fd variants write LEPT_STRINGIFY_CHUNK_SIZE (64 KiB) pieces and return 0 or -1. */
+int lept_stringify_to(const lept_value* v, lept_write_fn write_fn, void* user, size_t chunk_size);
+int lept_stringify_to_ex(const lept_value* v, lept_write_fn write_fn, void* user, size_t chunk_size, const lept_allocator* a);
+int lept_stringify_file(const lept_value* v, FILE* fp);
+int lept_stringify_file_ex(const lept_value* v, FILE* fp, const lept_allocator* a);
+int lept_stringify_fd(const lept_value* v, int fd);
+int lept_stringify_fd_ex(const lept_value* v, int fd, const lept_allocator* a);
+
+/* Parses exactly len bytes: json needs no terminator, and a NUL byte inside it is an error. */
+int lept_parse_n(lept_value* v, const char* json, size_t len);
+int lept_parse_n_ex(lept_value* v, const char* json, size_t len, const lept_allocator* a);
+
+/* Parses without building a tree; errors are reported after the events preceding them. */
+int lept_parse_sax(const char* json, size_t len, const lept_handler* h, void* user);
+int lept_parse_sax_ex(const char* json, size_t len, const lept_handler* h, void* user, const lept_allocator* a);
+
+/* The _ex variants route every allocation through a (NULL: libc malloc/realloc/free).
+ * A tree must be freed, and its strings set, with the allocator that built it. Large objects
+ * keep a copy of *a for their key index, so a itself need not outlive the call. */
+int lept_parse_ex(lept_value* v, const char* json, const lept_allocator* a);
+char* lept_stringify_ex(const lept_value* v, size_t* length, const lept_allocator* a);
+void lept_free_ex(lept_value* v, const lept_allocator* a);
+
+/* In-situ parsing decodes strings and keys inside json itself and points the tree at them:
+ * json must stay alive and untouched until the tree is freed, and is garbage after a failure. */
+int lept_parse_insitu(lept_value* v, char* json);
+int lept_parse_insitu_ex(lept_value* v, char* json, const lept_allocator* a);
+
+/* Lazy parsing only validates json: strings, numbers and the contents of arrays and objects
+ * are decoded, one level at a time, by the first getter (or find, or stringify) that reads
+ * them, so parts never read are never decoded or allocated. json must stay alive and untouched
+ * until the tree is freed. The default allocator is used throughout; as with the object index,
+ * concurrent first reads of a shared tree need a lock. */
+int lept_parse_lazy(lept_value* v, const char* json);
+
+/* Projection parsing builds only the values at the given paths and steps over the rest without
+ * decoding it: there, only quotes and brackets are checked. Paths are JSON Pointers ("" is the
+ * whole document) in which a "*" segment matches every member or element. The tree keeps the
+ * arrays and objects leading to each path, holding only the members and elements some path
+ * goes through (so array indices are not kept), and drops any other value a path stops short
+ * in. A root that no path goes into is null. lept_projection_new() returns NULL if a path is
+ * malformed; trees are built with, and must be freed with, its allocator a. */
+typedef struct lept_projection lept_projection;
+lept_projection* lept_projection_new(const char* const* paths, size_t count, const lept_allocator* a);
+int lept_parse_projection(lept_value* v, const char* json, const lept_projection* p);
+void lept_projection_free(lept_projection* p);
+
+void lept_parser_init(lept_parser* p, const lept_allocator* a);
+int lept_parser_parse(lept_parser* p, lept_value* v, const char* json);
+void lept_parser_free(lept_parser* p);
+
+/*
+ * A tape is a flat parse result: one array of 64-bit words in document order (a tag and a
+ * payload each; numbers and strings take a second word, and every array or object start
+ * holds the index of its end) plus one buffer for all strings and keys. A tape is reusable;
+ * it keeps both buffers, so parsing similar documents again allocates nothing. After a failed
+ * parse it is empty. Cursors read a parsed tape without allocating and stay valid until the
+ * next parse; next() skips a whole subtree in O(1).
+ */
+typedef struct lept_tape lept_tape;
+
+typedef struct {
+    const lept_tape* tape;
+    size_t pos;     /* tape index of the current value */
+    size_t key;     /* tape index of its key, LEPT_KEY_NOT_EXIST outside objects */
+}lept_cursor;
+
+lept_tape* lept_tape_new(const lept_allocator* a);
+int lept_tape_parse(lept_tape* t, const char* json, size_t len);
+size_t lept_tape_words(const lept_tape* t);
+void lept_tape_free(lept_tape* t);
+
+lept_cursor lept_tape_root(const lept_tape* t);
+lept_type lept_cursor_type(const lept_cursor* c);
+int lept_cursor_get_boolean(const lept_cursor* c);
+double lept_cursor_get_number(const lept_cursor* c);
+const char* lept_cursor_get_string(const lept_cursor* c, size_t* len);
+/* The key of the member the cursor is on, or NULL (and a length of 0) outside objects. */
+const char* lept_cursor_get_key(const lept_cursor* c, size_t* klen);
+size_t lept_cursor_size(const lept_cursor* c);
+/* Each returns 1 after moving the cursor, or 0 leaving it alone: down() to the first element
+ * or member of an array or object, next() to the next sibling, find() to a member of an object. */
+int lept_cursor_down(lept_cursor* c);
+int lept_cursor_next(lept_cursor* c);
+int lept_cursor_find(lept_cursor* c, const char* key, size_t klen);
+
+/* A pool of immutable keys that parsers with lept_parser.intern set share: a parsed key found
+ * in (or added to) the pool points at the pooled copy, so equal keys are equal pointers and are
+ * not freed with their tree. The pool must outlive every such tree. Once it holds max_keys keys,
+ * new ones are copied as usual. lock (NULL: one thread only) guards every lookup, so parsers on
+ * several threads may share a pool. lept_intern() returns the pooled copy, or NULL when full. */
+lept_intern_pool* lept_intern_pool_new(size_t max_keys, const lept_lock* lock, const lept_allocator* a);
+const char* lept_intern(lept_intern_pool* p, const char* key, size_t klen);
+size_t lept_intern_pool_size(lept_intern_pool* p);
+void lept_intern_pool_free(lept_intern_pool* p);
+
+/* Incremental parsing of input that arrives in chunks. Tokens may be split anywhere; only
+ * a token split across chunks is buffered. finish() reports the result, and on success
+ * v holds the tree (LEPT_NULL on failure); lept_push_parser_free() must follow either way.
+ * After an error, feed() keeps returning it. */
+typedef struct lept_push_parser lept_push_parser;
+lept_push_parser* lept_push_parser_new(lept_value* v, const lept_allocator* a);
+lept_push_parser* lept_push_parser_new_sax(const lept_handler* h, void* user, const lept_allocator* a);
+int lept_push_parser_feed(lept_push_parser* p, const char* chunk, size_t len);
+int lept_push_parser_finish(lept_push_parser* p);
+void lept_push_parser_free(lept_push_parser* p);
+
+void lept_document_init(lept_document* d);
+void lept_document_init_ex(lept_document* d, const lept_allocator* a);
+int lept_document_parse(lept_document* d, const char* json);
+void lept_document_free(lept_document* d);
+
 lept_type lept_get_type(const lept_value* v);
 
 #define lept_set_null(v) lept_free(v)
@@ -57,9 +286,12 @@ void lept_set_boolean(lept_value* v, int b);
 double lept_get_number(const lept_value* v);
 void lept_set_number(lept_value* v, double n);
 
+/* Short strings and keys are stored inside the node (and keys inside the member), so the
+ * pointers returned for them point into it and move with it. */
 const char* lept_get_string(const lept_value* v);
 size_t lept_get_string_length(const lept_value* v);
 void lept_set_string(lept_value* v, const char* s, size_t len);
+void lept_set_string_ex(lept_value* v, const char* s, size_t len, const lept_allocator* a);
 
 size_t lept_get_array_size(const lept_value* v);
 lept_value* lept_get_array_element(const lept_value* v, size_t index);
@@ -69,4 +301,11 @@ const char* lept_get_object_key(const lept_value* v, size_t index);
 size_t lept_get_object_key_length(const lept_value* v, size_t index);
 lept_value* lept_get_object_value(const lept_value* v, size_t index);
 
+#define LEPT_KEY_NOT_EXIST ((size_t)-1)
+
+/* Objects of LEPT_OBJECT_INDEX_THRESHOLD (default 32) or more members build a hash
+ * index on the first call; concurrent first lookups on a shared tree need a lock. */
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen);
+lept_value* lept_find_object_value(const lept_value* v, const char* key, size_t klen);
+
 #endif /* LEPTJSON_H__ */
@@ -2,11 +2,26 @@
 #define _CRTDBG_MAP_ALLOC
 #include <crtdbg.h>
 #endif
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _WIN32
+#include <fcntl.h>   /* _O_BINARY */
+#include <io.h>      /* _pipe(), _read(), _close() */
+#define TEST_PIPE(fds)          _pipe(fds, 4096, _O_BINARY)
+#define TEST_READ(fd, buf, n)   ((long)_read(fd, buf, (unsigned)(n)))
+#define TEST_CLOSE(fd)          _close(fd)
+#else
+#include <unistd.h>  /* pipe(), read(), close() */
+#define TEST_PIPE(fds)          pipe(fds)
+#define TEST_READ(fd, buf, n)   ((long)read(fd, buf, n))
+#define TEST_CLOSE(fd)          close(fd)
+#endif
 #include "leptjson.h"
 
+#define LEPT_ARENA_TEST_STRING_SIZE 20000
+
 static int main_ret = 0;
 static int test_count = 0;
 static int test_pass = 0;
@@ -102,6 +117,47 @@ static void test_parse_number() {
     TEST_NUMBER(-2.2250738585072014e-308, "-2.2250738585072014e-308");
     TEST_NUMBER( 1.7976931348623157e+308, "1.7976931348623157e+308");  /* Max double */
     TEST_NUMBER(-1.7976931348623157e+308, "-1.7976931348623157e+308");
+
+    /* halfway cases and more than 19 significant digits */
+    TEST_NUMBER(9007199254740992.0, "9007199254740993");   /* 2^53 + 1 rounds to even */
+    TEST_NUMBER(9007199254740996.0, "9007199254740995");
+    TEST_NUMBER(1.0, "1.00000000000000011102230246251565404236316680908203125");   /* exactly halfway */
+    TEST_NUMBER(1.0000000000000002, "1.00000000000000011102230246251565404236316680908203126");
+    TEST_NUMBER(2.2250738585072011e-308, "2.2250738585072011e-308");
+    TEST_NUMBER(1.7976931348623157e+308, "179769313486231580793728971405301e+276"); /* rounds down to max double */
+    TEST_NUMBER(0.1, "0.1000000000000000000000000000000000000000000000000000000001");
+    TEST_NUMBER(123.0, "0.000000000000000000000000000000000000000000000000123e51");
+}
+
+/* Compares against the C library on random inputs, assuming it rounds correctly. */
+static void test_parse_number_random() {
+    unsigned long seed = 12345;
+    char json[64];
+    int i, j;
+    for (i = 0; i < 20000; i++) {
+        int len = 0, nd;
+        double expect;
+        lept_value v;
+        seed = (seed * 1103515245ul + 12345ul) & 0x7FFFFFFFul;
+        nd = (int)(seed % 25) + 1;
+        json[len++] = '1' + (char)(seed % 9);
+        for (j = 1; j < nd; j++) {
+            seed = (seed * 1103515245ul + 12345ul) & 0x7FFFFFFFul;
+            if (j == nd / 2)
+                json[len++] = '.';
+            json[len++] = '0' + (char)((seed >> 8) % 10);
+        }
+        len += sprintf(json + len, "e%d", (int)((seed >> 4) % 640) - 330);
+        expect = strtod(json, NULL);
+        lept_init(&v);
+        if (expect == HUGE_VAL)
+            EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_parse(&v, json));
+        else {
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+            EXPECT_EQ_DOUBLE(expect, lept_get_number(&v));
+        }
+        lept_free(&v);
+    }
 }
 
 #define TEST_STRING(expect, json)\
@@ -236,6 +292,68 @@ static void test_parse_object() {
         lept_free(&v);\
     } while(0)
 
+static void test_parse_whitespace() {
+    static const char ws[] = " \t\n\r";
+    char json[320];
+    size_t i, j, n;
+    lept_value v;
+    /* runs of every length around the 16/32-byte vector widths, at every alignment */
+    for (i = 0; i < 32; i++)
+        for (n = 0; n < 70; n += 3) {
+            char* p = json + i;
+            for (j = 0; j < n; j++)
+                *p++ = ws[j % 4];
+            *p++ = '[';
+            for (j = 0; j < n; j++)
+                *p++ = ws[(j + 1) % 4];
+            *p++ = '1';
+            for (j = 0; j < n; j++)
+                *p++ = ws[(j + 2) % 4];
+            *p++ = ']';
+            *p = '\0';
+            lept_init(&v);
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json + i));
+            EXPECT_EQ_SIZE_T(1, lept_get_array_size(&v));
+            lept_free(&v);
+            p[0] = ' ';
+            p[1] = ' ';
+            p[2] = 'x';
+            p[3] = '\0';
+            TEST_PARSE_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, json + i);
+        }
+}
+
+static void test_parse_string_runs() {
+    char json[160], expect[160];
+    size_t i, n, j, len;
+    lept_value v;
+    /* escapes, terminators and control bytes at every offset of the 16/32-byte scan blocks */
+    for (i = 0; i < 32; i++)
+        for (n = 0; n < 100; n += 7) {
+            char* p = json + i;
+            *p++ = '"';
+            for (j = 0, len = 0; j < n; j++) {
+                if (j % 29 == 28) {
+                    *p++ = '\\'; *p++ = 't';
+                    expect[len++] = '\t';
+                }
+                else
+                    *p++ = expect[len++] = (char)('A' + j % 26);
+            }
+            *p++ = '"';
+            *p = '\0';
+            lept_init(&v);
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json + i));
+            EXPECT_EQ_SIZE_T(len, lept_get_string_length(&v));
+            EXPECT_TRUE(memcmp(expect, lept_get_string(&v), len) == 0);
+            lept_free(&v);
+            p[-1] = '\x1F';
+            TEST_PARSE_ERROR(LEPT_PARSE_INVALID_STRING_CHAR, json + i);
+            p[-1] = '\0';
+            TEST_PARSE_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, json + i);
+        }
+}
+
 static void test_parse_expect_value() {
     TEST_PARSE_ERROR(LEPT_PARSE_EXPECT_VALUE, "");
     TEST_PARSE_ERROR(LEPT_PARSE_EXPECT_VALUE, " ");
@@ -272,6 +390,8 @@ static void test_parse_root_not_singular() {
 static void test_parse_number_too_big() {
     TEST_PARSE_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "1e309");
     TEST_PARSE_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "-1e309");
+    TEST_PARSE_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "17976931348623158079372897140530342e274");
+    TEST_PARSE_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "1e99999999999");
 }
 
 static void test_parse_miss_quotation_mark() {
@@ -345,14 +465,308 @@ static void test_parse_miss_comma_or_curly_bracket() {
     TEST_PARSE_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":{}");
 }
 
+/* depth levels alternating [ and {"k": around "x", left open unless closed is set */
+static char* test_nested_json(size_t depth, int closed) {
+    char* json = (char*)malloc(depth * 6 + 4);
+    size_t i, length = 0;
+    for (i = 0; i < depth; i++)
+        length += sprintf(json + length, i % 2 ? "{\"k\":" : "[");
+    length += sprintf(json + length, "\"x\"");
+    while (closed && i-- > 0)
+        json[length++] = i % 2 ? '}' : ']';
+    json[length] = '\0';
+    return json;
+}
+
+static void test_parse_too_deep() {
+    lept_parser p;
+    lept_value v;
+    const lept_value* e;
+    char* json;
+    size_t i;
+
+    json = test_nested_json(1024, 1);
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    for (e = &v, i = 0; i < 1024; i++)
+        e = i % 2 ? lept_get_object_value(e, 0) : lept_get_array_element(e, 0);
+    EXPECT_EQ_STRING("x", lept_get_string(e), lept_get_string_length(e));
+    lept_free(&v);
+    free(json);
+
+    json = test_nested_json(1025, 1);
+    TEST_PARSE_ERROR(LEPT_PARSE_TOO_DEEP, json);
+    free(json);
+
+    /* a hostile input fails fast instead of exhausting the C stack */
+    json = test_nested_json(1000000, 0);
+    TEST_PARSE_ERROR(LEPT_PARSE_TOO_DEEP, json);
+    free(json);
+
+    /* errors deep inside release every level */
+    json = test_nested_json(999, 0);
+    TEST_PARSE_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, json);
+    free(json);
+
+    lept_parser_init(&p, NULL);
+    p.max_depth = 3;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v, "[{\"a\":1,\"b\":[]}]"));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_parser_parse(&p, &v, "[{\"a\":1,\"b\":[[]]}]"));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v, "1"));
+    p.max_depth = 0;
+    EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_parser_parse(&p, &v, "[]"));
+    lept_parser_free(&p);
+}
+
+#define TEST_PARSE_N(expect, json, len)\
+    do {\
+        lept_value v;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(expect, lept_parse_n(&v, json, len));\
+        lept_free(&v);\
+    } while(0)
+
+static void test_parse_n() {
+    static const char doc[] =
+        "{ \"id\" : 12345 , \"name\" : \"a string long enough for a vector scan \\u00e9\\uD834\\uDD1E\\n\" ,"
+        "\n    \"list\" : [ true, false, null, -1.5e-3, 0 ],\n    \"empty\" : { }\n}                  ";
+    lept_value v;
+    char* prefix;
+    size_t len, n = sizeof(doc) - 1;
+    int ret;
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&v, "123456", 3));
+    EXPECT_EQ_DOUBLE(123.0, lept_get_number(&v));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&v, "\"abc\"def", 5));
+    EXPECT_EQ_STRING("abc", lept_get_string(&v), lept_get_string_length(&v));
+    lept_free(&v);
+    TEST_PARSE_N(LEPT_PARSE_OK, "nullx", 4);
+    TEST_PARSE_N(LEPT_PARSE_OK, "[1,2]]", 5);
+    TEST_PARSE_N(LEPT_PARSE_EXPECT_VALUE, "null", 0);
+    TEST_PARSE_N(LEPT_PARSE_EXPECT_VALUE, "   null", 3);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_VALUE, "true", 3);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_VALUE, "1.5e3", 4);
+    TEST_PARSE_N(LEPT_PARSE_MISS_QUOTATION_MARK, "\"abc\"", 4);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_STRING_ESCAPE, "\"\\n\"", 2);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_UNICODE_HEX, "\"\\u0041\"", 5);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD834\\uDD1E\"", 8);
+    TEST_PARSE_N(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1,2]", 4);
+    TEST_PARSE_N(LEPT_PARSE_MISS_COLON, "{\"a\":1}", 4);
+
+    /* NUL bytes inside the buffer are input, not the end of it */
+    TEST_PARSE_N(LEPT_PARSE_ROOT_NOT_SINGULAR, "1\0", 2);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_VALUE, "[1,\0]", 5);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_STRING_CHAR, "\"a\0b\"", 5);
+
+    /* every prefix of a document fails or succeeds exactly as its terminated copy */
+    prefix = (char*)malloc(n + 1);
+    for (len = 0; len <= n; len++) {
+        memcpy(prefix, doc, len);
+        prefix[len] = '\0';
+        ret = lept_parse(&v, prefix);
+        lept_free(&v);
+        EXPECT_EQ_INT(ret, lept_parse_n(&v, doc, len));
+        lept_free(&v);
+    }
+    free(prefix);
+}
+
+/* SAX events as text, e.g. {k:"a"[1,t]} */
+typedef struct {
+    char buf[256];
+    size_t len;
+    const char* stop_key;   /* stop when this key is seen */
+}sax_trace;
+
+static int sax_append(sax_trace* t, const char* s, size_t len) {
+    if (t->len + len < sizeof(t->buf)) {
+        memcpy(t->buf + t->len, s, len);
+        t->len += len;
+        t->buf[t->len] = '\0';
+    }
+    return 1;
+}
+
+static int sax_null(void* user) { return sax_append((sax_trace*)user, "n,", 2); }
+static int sax_bool(void* user, int b) { return sax_append((sax_trace*)user, b ? "t," : "f,", 2); }
+static int sax_start_object(void* user) { return sax_append((sax_trace*)user, "{", 1); }
+static int sax_end_object(void* user) { return sax_append((sax_trace*)user, "},", 2); }
+static int sax_start_array(void* user) { return sax_append((sax_trace*)user, "[", 1); }
+static int sax_end_array(void* user) { return sax_append((sax_trace*)user, "],", 2); }
+
+static int sax_number(void* user, double n) {
+    char buf[32];
+    sprintf(buf, "%g,", n);
+    return sax_append((sax_trace*)user, buf, strlen(buf));
+}
+
+static int sax_string(void* user, const char* s, size_t len) {
+    sax_trace* t = (sax_trace*)user;
+    return sax_append(t, "\"", 1) && sax_append(t, s, len) && sax_append(t, "\",", 2);
+}
+
+static int sax_key(void* user, const char* k, size_t klen) {
+    sax_trace* t = (sax_trace*)user;
+    if (t->stop_key && strlen(t->stop_key) == klen && memcmp(t->stop_key, k, klen) == 0)
+        return 0;
+    return sax_append(t, k, klen) && sax_append(t, ":", 1);
+}
+
+#define TEST_SAX(expect_ret, expect, json, h, stop)\
+    do {\
+        sax_trace t;\
+        t.len = 0;\
+        t.buf[0] = '\0';\
+        t.stop_key = stop;\
+        EXPECT_EQ_INT(expect_ret, lept_parse_sax(json, strlen(json), h, &t));\
+        EXPECT_EQ_STRING(expect, t.buf, t.len);\
+    } while(0)
+
+static void test_parse_sax() {
+    lept_handler h = {
+        sax_null, sax_bool, sax_number, sax_string,
+        sax_start_object, sax_key, sax_end_object,
+        sax_start_array, sax_end_array
+    };
+    lept_handler strings_only;
+
+    TEST_SAX(LEPT_PARSE_OK, "n,", " null ", &h, NULL);
+    TEST_SAX(LEPT_PARSE_OK, "\"a\\nb\",", "\"a\\\\nb\"", &h, NULL);
+    TEST_SAX(LEPT_PARSE_OK, "[],", "[ ]", &h, NULL);
+    TEST_SAX(LEPT_PARSE_OK, "{},", "{ }", &h, NULL);
+    TEST_SAX(LEPT_PARSE_OK,
+        "{n:n,f:f,t:t,i:123,s:\"abc\",a:[1,2,3,],o:{1:1,2:2,3:3,},},",
+        " { "
+        "\"n\" : null , "
+        "\"f\" : false , "
+        "\"t\" : true , "
+        "\"i\" : 123 , "
+        "\"s\" : \"abc\", "
+        "\"a\" : [ 1, 2, 3 ],"
+        "\"o\" : { \"1\" : 1, \"2\" : 2, \"3\" : 3 }"
+        " } ", &h, NULL);
+
+    /* a handler may stop the parse early */
+    TEST_SAX(LEPT_PARSE_STOPPED, "{a:[1,],", "{\"a\":[1],\"b\":2,\"c\":3}", &h, "b");
+
+    /* events up to the error are delivered */
+    TEST_SAX(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1,[2,", "[1,[2}]", &h, NULL);
+    TEST_SAX(LEPT_PARSE_ROOT_NOT_SINGULAR, "[],", "[] x", &h, NULL);
+
+    /* NULL members skip their events */
+    memset(&strings_only, 0, sizeof(strings_only));
+    strings_only.on_string = sax_string;
+    TEST_SAX(LEPT_PARSE_OK, "\"x\",\"y\",", "{\"a\":[1,\"x\",{\"b\":\"y\"},null]}", &strings_only, NULL);
+}
+
+/* Feeds json in chunks of the given sizes (the last one repeats) and checks against lept_parse_n(). */
+static void test_push_chunks(const char* json, const size_t* sizes, size_t nsizes) {
+    lept_push_parser* p;
+    lept_value expect, v;
+    size_t i = 0, off = 0, len = strlen(json), n;
+    int ret, expect_ret;
+    char *s1, *s2;
+    size_t l1, l2;
+
+    lept_init(&expect);
+    expect_ret = lept_parse_n(&expect, json, len);
+    p = lept_push_parser_new(&v, NULL);
+    ret = LEPT_PARSE_OK;
+    while (off < len && ret == LEPT_PARSE_OK) {
+        n = sizes[i < nsizes - 1 ? i++ : i];
+        if (n > len - off)
+            n = len - off;
+        ret = lept_push_parser_feed(p, json + off, n);
+        off += n;
+    }
+    if (ret == LEPT_PARSE_OK)
+        ret = lept_push_parser_finish(p);
+    lept_push_parser_free(p);
+    EXPECT_EQ_INT(expect_ret, ret);
+    if (expect_ret == LEPT_PARSE_OK && ret == LEPT_PARSE_OK) {
+        s1 = lept_stringify(&expect, &l1);
+        s2 = lept_stringify(&v, &l2);
+        EXPECT_TRUE(l1 == l2 && memcmp(s1, s2, l1) == 0);
+        free(s1);
+        free(s2);
+    }
+    else
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    lept_free(&expect);
+    lept_free(&v);
+}
+
+static void test_push_parser() {
+    static const char* docs[] = {
+        "null", " true ", "false", "0", "-12.5e+3", "123456789012345678901234567890", "\"\"",
+        "\"Hello\\nWorld \\u00e9 \\uD834\\uDD1E \\\\ \\/ \\\"\"",
+        "[ null , false , true , 123 , \"abc\" , [ 1, [] ], {} ]",
+        " { \"n\" : null , \"s\" : \"abc\" , \"a\" : [ 1, 2, 3 ] , \"o\" : { \"1\" : 1, \"2\" : 2 } } ",
+        /* errors: each must fail exactly as lept_parse_n() does */
+        "", " ", "nul", "truex", "?", "+0", "0123", "1.", "1e", "[1,]", "[1 2]", "[", "[1",
+        "{", "{\"a\"", "{\"a\":", "{\"a\":1", "{\"a\":1,}", "{1:1}", "{\"a\" 1}", "{\"a\":1]",
+        "\"abc", "\"\\v\"", "\"\\u12\"", "\"\\uD800\"", "\"\\uD800\\uE000\"", "\"a\x01\"", "\"abc\\",
+        "1e309", "null x", "[1]]", "[[[[[[]]]]]"
+    };
+    static const size_t one[] = { 1 }, twos[] = { 2 }, odd[] = { 3, 7, 1, 5 };
+    size_t i, split, len, sizes[2];
+    sax_trace t;
+    lept_handler h;
+    lept_push_parser* p;
+    lept_value v;
+
+    for (i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+        len = strlen(docs[i]);
+        test_push_chunks(docs[i], one, 1);
+        test_push_chunks(docs[i], twos, 1);
+        test_push_chunks(docs[i], odd, 4);
+        for (split = 0; split <= len; split++) {
+            sizes[0] = split;
+            sizes[1] = len;
+            test_push_chunks(docs[i], sizes, 2);
+        }
+    }
+
+    /* events, as with lept_parse_sax() */
+    memset(&h, 0, sizeof(h));
+    h.on_string = sax_string;
+    h.on_key = sax_key;
+    t.len = 0;
+    t.buf[0] = '\0';
+    t.stop_key = "stop";
+    p = lept_push_parser_new_sax(&h, &t, NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_push_parser_feed(p, "{\"k\":\"v\\u00", 11));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_push_parser_feed(p, "41\", \"st", 8));
+    EXPECT_EQ_STRING("k:\"vA\",", t.buf, t.len);
+    EXPECT_EQ_INT(LEPT_PARSE_STOPPED, lept_push_parser_feed(p, "op\":1}", 6));
+    EXPECT_EQ_INT(LEPT_PARSE_STOPPED, lept_push_parser_feed(p, " ", 1));
+    EXPECT_EQ_INT(LEPT_PARSE_STOPPED, lept_push_parser_finish(p));
+    lept_push_parser_free(p);
+
+    /* an abandoned parse releases its partial tree */
+    p = lept_push_parser_new(&v, NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_push_parser_feed(p, "[\"a\",{\"b\":[\"c\"", 14));
+    lept_push_parser_free(p);
+    p = lept_push_parser_new(&v, NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_push_parser_feed(p, "[\"a\"] ", 6));
+    lept_push_parser_free(p);
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+}
+
 static void test_parse() {
     test_parse_null();
     test_parse_true();
     test_parse_false();
     test_parse_number();
+    test_parse_number_random();
     test_parse_string();
     test_parse_array();
     test_parse_object();
+    test_parse_whitespace();
+    test_parse_string_runs();
 
     test_parse_expect_value();
     test_parse_invalid_value();
@@ -367,6 +781,10 @@ static void test_parse() {
     test_parse_miss_key();
     test_parse_miss_colon();
     test_parse_miss_comma_or_curly_bracket();
+    test_parse_too_deep();
+    test_parse_n();
+    test_parse_sax();
+    test_push_parser();
 }
 
 #define TEST_ROUNDTRIP(json)\
@@ -378,6 +796,7 @@ static void test_parse() {
         EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
         json2 = lept_stringify(&v, &length);\
         EXPECT_EQ_STRING(json, json2, length);\
+        EXPECT_EQ_SIZE_T(length, lept_stringify_size(&v));\
         lept_free(&v);\
         free(json2);\
     } while(0)
@@ -395,16 +814,71 @@ static void test_stringify_number() {
     TEST_ROUNDTRIP("1.234e-20");
 
     TEST_ROUNDTRIP("1.0000000000000002"); /* the smallest number > 1 */
-    TEST_ROUNDTRIP("4.9406564584124654e-324"); /* minimum denormal */
-    TEST_ROUNDTRIP("-4.9406564584124654e-324");
-    TEST_ROUNDTRIP("2.2250738585072009e-308");  /* Max subnormal double */
-    TEST_ROUNDTRIP("-2.2250738585072009e-308");
+    TEST_ROUNDTRIP("5e-324"); /* minimum denormal */
+    TEST_ROUNDTRIP("-5e-324");
+    TEST_ROUNDTRIP("2.225073858507201e-308");  /* Max subnormal double */
+    TEST_ROUNDTRIP("-2.225073858507201e-308");
     TEST_ROUNDTRIP("2.2250738585072014e-308");  /* Min normal positive double */
     TEST_ROUNDTRIP("-2.2250738585072014e-308");
     TEST_ROUNDTRIP("1.7976931348623157e+308");  /* Max double */
     TEST_ROUNDTRIP("-1.7976931348623157e+308");
 }
 
+#define TEST_STRINGIFY_NUMBER(expect, n)\
+    do {\
+        lept_value v;\
+        char* json;\
+        size_t length;\
+        lept_init(&v);\
+        lept_set_number(&v, n);\
+        json = lept_stringify(&v, &length);\
+        EXPECT_EQ_STRING(expect, json, length);\
+        free(json);\
+    } while(0)
+
+static void test_stringify_number_shortest() {
+    TEST_STRINGIFY_NUMBER("0.1", 0.1);
+    TEST_STRINGIFY_NUMBER("0.30000000000000004", 0.1 + 0.2);
+    TEST_STRINGIFY_NUMBER("5e-324", 4.9406564584124654e-324);
+    TEST_STRINGIFY_NUMBER("1e-05", 0.00001);
+    TEST_STRINGIFY_NUMBER("0.0001", 0.0001);
+    TEST_STRINGIFY_NUMBER("10000000000000000", 1e16);
+    TEST_STRINGIFY_NUMBER("1e+17", 1e17);
+    TEST_STRINGIFY_NUMBER("9.007199254740993e+18", 9007199254740993e+3);
+    TEST_STRINGIFY_NUMBER("123456.789", 123456.789);
+}
+
+/* Random bit patterns must survive stringify and parse unchanged. */
+static void test_stringify_number_random() {
+    unsigned long seed = 2016;
+    unsigned char bytes[sizeof(double)];
+    long i, failures = 0;
+    size_t j, length;
+    lept_value v, v2;
+    char* json;
+    lept_init(&v);
+    lept_init(&v2);
+    for (i = 0; i < 1000000; i++) {
+        double n, n2;
+        for (j = 0; j < sizeof(double); j++) {
+            seed = (seed * 1103515245ul + 12345ul) & 0x7FFFFFFFul;
+            bytes[j] = (unsigned char)(seed >> 16);
+        }
+        memcpy(&n, bytes, sizeof(double));
+        if (n != n || n - n != 0.0)
+            continue; /* NaN or infinity */
+        lept_set_number(&v, n);
+        json = lept_stringify(&v, &length);
+        n2 = lept_parse(&v2, json) == LEPT_PARSE_OK ? lept_get_number(&v2) : 0.0;
+        if (memcmp(&n2, &n, sizeof(double)) != 0) {
+            if (failures++ == 0)
+                fprintf(stderr, "%s:%d: %.17g stringified as %s\n", __FILE__, __LINE__, n, json);
+        }
+        free(json);
+    }
+    EXPECT_EQ_INT(0, (int)failures);
+}
+
 static void test_stringify_string() {
     TEST_ROUNDTRIP("\"\"");
     TEST_ROUNDTRIP("\"Hello\"");
@@ -413,6 +887,29 @@ static void test_stringify_string() {
     TEST_ROUNDTRIP("\"Hello\\u0000World\"");
 }
 
+/* Escapes on both sides of every 16- and 32-byte block boundary of the SIMD scanner. */
+static void test_stringify_string_escapes() {
+    static const char* escapes[] = { "\\\"", "\\\\", "\\n", "\\u0001", "\\u001F" };
+    char json[128], *out;
+    size_t i, e, n, length;
+    lept_value v;
+    for (e = 0; e < sizeof(escapes) / sizeof(escapes[0]); e++)
+        for (i = 0; i < 70; i++) {
+            n = strlen(escapes[e]);
+            memset(json, 'a', 80);
+            json[0] = '"';
+            memcpy(json + 1 + i, escapes[e], n);
+            memcpy(json + 80, "\\t\"", 4);
+            lept_init(&v);
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+            out = lept_stringify(&v, &length);
+            EXPECT_TRUE(length == 83 && memcmp(out, json, length) == 0);
+            EXPECT_EQ_SIZE_T(length, lept_stringify_size(&v));
+            free(out);
+            lept_free(&v);
+        }
+}
+
 static void test_stringify_array() {
     TEST_ROUNDTRIP("[]");
     TEST_ROUNDTRIP("[null,false,true,123,\"abc\",[1,2,3]]");
@@ -423,14 +920,127 @@ static void test_stringify_object() {
     TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
 }
 
+typedef struct {
+    char buf[1024];
+    size_t len, chunks, bad_chunks, chunk_size, limit;
+}stringify_sink;
+
+static int sink_write(void* user, const char* data, size_t len) {
+    stringify_sink* k = (stringify_sink*)user;
+    if (k->len + len > k->limit)
+        return -7;
+    if (len != k->chunk_size)
+        k->bad_chunks++; /* only the final piece may be short */
+    memcpy(k->buf + k->len, data, len);
+    k->len += len;
+    k->chunks++;
+    return 0;
+}
+
+/* Stringifies into a pipe and reads the text back; it must fit in the pipe's buffer. */
+static int test_stringify_pipe(const lept_value* v, const lept_allocator* a, stringify_sink* k) {
+    int fds[2], ret;
+    long n;
+    k->len = 0;
+    if (TEST_PIPE(fds) != 0)
+        return -1;
+    ret = lept_stringify_fd_ex(v, fds[1], a);
+    TEST_CLOSE(fds[1]);
+    while ((n = TEST_READ(fds[0], k->buf + k->len, sizeof(k->buf) - k->len)) > 0)
+        k->len += (size_t)n;
+    TEST_CLOSE(fds[0]);
+    return ret;
+}
+
+static void test_stringify_to() {
+    static const char json[] = "{\"s\":\"a long string with escapes \\n\\t\\\" spanning several chunks\\u0001\","
+        "\"a\":[1,2.5,-3e+100,null,true,false,[],{}],\"o\":{\"k\":\"v\"}}";
+    static const size_t chunks[] = { 1, 7, 16, 64, 4096 };
+    lept_value v;
+    stringify_sink k;
+    char* expect;
+    size_t i, length;
+    FILE* fp;
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    expect = lept_stringify(&v, &length);
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        k.len = k.chunks = k.bad_chunks = 0;
+        k.chunk_size = chunks[i];
+        k.limit = sizeof(k.buf);
+        EXPECT_EQ_INT(0, lept_stringify_to(&v, sink_write, &k, chunks[i]));
+        EXPECT_TRUE(k.len == length && memcmp(k.buf, expect, length) == 0);
+        EXPECT_EQ_SIZE_T((length + chunks[i] - 1) / chunks[i], k.chunks);
+        EXPECT_TRUE(k.bad_chunks == (length % chunks[i] != 0));
+    }
+
+    /* the first writer error ends the output and is returned */
+    k.len = k.chunks = k.bad_chunks = 0;
+    k.chunk_size = 8;
+    k.limit = 40;
+    EXPECT_EQ_INT(-7, lept_stringify_to(&v, sink_write, &k, 8));
+    EXPECT_EQ_SIZE_T(40, k.len);
+    EXPECT_EQ_SIZE_T(5, k.chunks);
+
+    if ((fp = tmpfile()) != NULL) {
+        EXPECT_EQ_INT(0, lept_stringify_file(&v, fp));
+        rewind(fp);
+        k.len = fread(k.buf, 1, sizeof(k.buf), fp);
+        EXPECT_TRUE(k.len == length && memcmp(k.buf, expect, length) == 0);
+        fclose(fp);
+    }
+    EXPECT_EQ_INT(0, test_stringify_pipe(&v, NULL, &k));
+    EXPECT_TRUE(k.len == length && memcmp(k.buf, expect, length) == 0);
+    EXPECT_EQ_INT(-1, lept_stringify_fd(&v, -1));
+    free(expect);
+    lept_free(&v);
+}
+
+static void test_stringify_into() {
+    static const char json[] = "{\"s\":\"esc \\n\\u0001\",\"a\":[1,2.5,-3e+100,null,true,false,[],{}],\"o\":{\"k\":\"v\"}}";
+    lept_value v;
+    char buf[128];
+    size_t length, needed, cap;
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    length = lept_stringify_size(&v);
+    EXPECT_TRUE(length + 1 < sizeof(buf));
+
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify_into(&v, buf, sizeof(buf), &needed));
+    EXPECT_EQ_SIZE_T(length + 1, needed);
+    EXPECT_EQ_STRING(json, buf, length);
+
+    /* every smaller capacity fails with the same answer and stays inside the buffer */
+    for (cap = 0; cap <= length; cap++) {
+        memset(buf, '#', sizeof(buf));
+        needed = 0;
+        EXPECT_EQ_INT(LEPT_STRINGIFY_BUFFER_TOO_SMALL, lept_stringify_into(&v, buf, cap, &needed));
+        EXPECT_EQ_SIZE_T(length + 1, needed);
+        EXPECT_TRUE(buf[cap] == '#');
+    }
+    EXPECT_EQ_INT(LEPT_STRINGIFY_BUFFER_TOO_SMALL, lept_stringify_into(&v, NULL, 0, NULL));
+
+    memset(buf, '#', sizeof(buf));
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify_into(&v, buf, length + 1, NULL));
+    EXPECT_EQ_STRING(json, buf, length);
+    EXPECT_TRUE(buf[length] == '\0' && buf[length + 1] == '#');
+    lept_free(&v);
+}
+
 static void test_stringify() {
     TEST_ROUNDTRIP("null");
     TEST_ROUNDTRIP("false");
     TEST_ROUNDTRIP("true");
     test_stringify_number();
+    test_stringify_number_shortest();
+    test_stringify_number_random();
     test_stringify_string();
+    test_stringify_string_escapes();
     test_stringify_array();
     test_stringify_object();
+    test_stringify_to();
+    test_stringify_into();
 }
 
 static void test_access_null() {
@@ -472,20 +1082,882 @@ static void test_access_string() {
     lept_free(&v);
 }
 
+/* Strings and keys on both sides of the inline (small string) limits. */
+static void test_access_string_lengths() {
+    char s[41], json[100];
+    const char* p;
+    lept_value v, *e;
+    size_t len;
+    lept_init(&v);
+    for (len = 0; len <= 40; len++) {
+        memset(s, 'a' + (int)(len % 26), len);
+        if (len > 2)
+            s[len / 2] = '\0';
+        lept_set_string(&v, s, len);
+        p = lept_get_string(&v);
+        EXPECT_TRUE(lept_get_string_length(&v) == len && memcmp(p, s, len) == 0 && p[len] == '\0');
+
+        memset(s, 'a' + (int)(len % 26), len);
+        sprintf(json, "{\"%.*s\":[\"%.*s\"]}", (int)len, s, (int)len, s);
+        lept_free(&v);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+        p = lept_get_object_key(&v, 0);
+        EXPECT_TRUE(lept_get_object_key_length(&v, 0) == len && memcmp(p, s, len) == 0 && p[len] == '\0');
+        e = lept_get_array_element(lept_get_object_value(&v, 0), 0);
+        EXPECT_TRUE(lept_get_string_length(e) == len && memcmp(lept_get_string(e), s, len) == 0);
+        EXPECT_EQ_SIZE_T(0, lept_find_object_index(&v, s, len));
+
+        /* the key survives its value being replaced */
+        lept_set_number(lept_get_object_value(&v, 0), 1.0);
+        p = lept_get_object_key(&v, 0);
+        EXPECT_TRUE(lept_get_object_key_length(&v, 0) == len && memcmp(p, s, len) == 0);
+        lept_free(&v);
+    }
+}
+
 static void test_access() {
     test_access_null();
     test_access_boolean();
     test_access_number();
     test_access_string();
+    test_access_string_lengths();
 }
 
+static void test_document() {
+    lept_document d;
+    lept_value* v;
+    size_t i;
+    char* json;
+    size_t length;
+    char big[LEPT_ARENA_TEST_STRING_SIZE + 3];
+
+    lept_document_init(&d);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_document_parse(&d,
+        " { \"n\" : null , \"s\" : \"abc\" , \"a\" : [ 1, 2, 3 ] , \"o\" : { \"k\" : \"v\" } } "));
+    v = &d.root;
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(v));
+    EXPECT_EQ_SIZE_T(4, lept_get_object_size(v));
+    EXPECT_EQ_STRING("s", lept_get_object_key(v, 1), lept_get_object_key_length(v, 1));
+    EXPECT_EQ_STRING("abc", lept_get_string(lept_get_object_value(v, 1)), lept_get_string_length(lept_get_object_value(v, 1)));
+    EXPECT_EQ_SIZE_T(3, lept_get_array_size(lept_get_object_value(v, 2)));
+    for (i = 0; i < 3; i++)
+        EXPECT_EQ_DOUBLE(i + 1.0, lept_get_number(lept_get_array_element(lept_get_object_value(v, 2), i)));
+    json = lept_stringify(v, &length);
+    EXPECT_EQ_STRING("{\"n\":null,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"k\":\"v\"}}", json, length);
+    free(json);
+
+    /* re-parsing releases the previous tree; strings larger than a block get their own block */
+    big[0] = '"';
+    memset(big + 1, 'x', LEPT_ARENA_TEST_STRING_SIZE);
+    big[LEPT_ARENA_TEST_STRING_SIZE + 1] = '"';
+    big[LEPT_ARENA_TEST_STRING_SIZE + 2] = '\0';
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_document_parse(&d, big));
+    EXPECT_EQ_INT(LEPT_STRING, lept_get_type(&d.root));
+    EXPECT_EQ_SIZE_T(LEPT_ARENA_TEST_STRING_SIZE, lept_get_string_length(&d.root));
+
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_document_parse(&d, "{\"a\":[\"b\",{\"c\":1}]"));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&d.root));
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_document_parse(&d, "[\"a\"] x"));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&d.root));
+    lept_document_free(&d);
+}
+
+typedef struct {
+    size_t mallocs, reallocs, frees, live, bytes;
+    int foreign;    /* frees of blocks this allocator did not hand out */
+}counting_stats;
+
+typedef union { size_t size; double align; } counting_header;
+
+#define COUNTING_MAGIC ((size_t)0x1E97)
+
+static void* counting_malloc(void* user, size_t size) {
+    counting_stats* st = (counting_stats*)user;
+    counting_header* h = (counting_header*)malloc(sizeof(counting_header) * 2 + size);
+    h[0].size = COUNTING_MAGIC;
+    h[1].size = size;
+    st->mallocs++;
+    st->live++;
+    st->bytes += size;
+    return h + 2;
+}
+
+static void counting_free(void* user, void* ptr) {
+    counting_stats* st = (counting_stats*)user;
+    counting_header* h = (counting_header*)ptr - 2;
+    if (h[0].size != COUNTING_MAGIC) {
+        st->foreign++;
+        return;
+    }
+    h[0].size = 0;
+    st->frees++;
+    st->live--;
+    free(h);
+}
+
+static void* counting_realloc(void* user, void* ptr, size_t size) {
+    counting_stats* st = (counting_stats*)user;
+    void* p = counting_malloc(user, size);
+    if (ptr) {
+        size_t old = ((counting_header*)ptr - 1)->size;
+        memcpy(p, ptr, old < size ? old : size);
+        counting_free(user, ptr);
+    }
+    st->reallocs++;
+    return p;
+}
+
+static void test_allocator() {
+    counting_stats st;
+    lept_allocator a;
+    lept_value v;
+    lept_document d;
+    lept_handler no_events;
+    stringify_sink k;
+    FILE* fp;
+    char* json;
+    size_t length, mallocs;
+    size_t i;
+
+    memset(&st, 0, sizeof(st));
+    a.malloc_fn = counting_malloc;
+    a.realloc_fn = counting_realloc;
+    a.free_fn = counting_free;
+    a.user = &st;
+
+    /* stack, 1 element table, 2 member tables; the short keys and strings are stored inline */
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "{\"a\":[\"x\",1],\"b\":{\"c\":\"y\",\"d\":{}}}", &a));
+    EXPECT_EQ_SIZE_T(4, st.mallocs);
+    EXPECT_EQ_SIZE_T(1, st.reallocs);
+    EXPECT_EQ_SIZE_T(3, st.live);
+    json = lept_stringify_ex(&v, &length, &a);
+    EXPECT_EQ_STRING("{\"a\":[\"x\",1],\"b\":{\"c\":\"y\",\"d\":{}}}", json, length);
+    EXPECT_EQ_SIZE_T(4, st.live);
+    counting_free(&st, json);
+    lept_free_ex(&v, &a);
+    EXPECT_EQ_SIZE_T(0, st.live);
+
+    lept_set_string_ex(&v, "Hello", 5, &a);
+    EXPECT_EQ_STRING("Hello", lept_get_string(&v), lept_get_string_length(&v));
+    EXPECT_EQ_SIZE_T(0, st.live);
+    lept_set_string_ex(&v, "Hello, allocator world", 22, &a);
+    EXPECT_EQ_STRING("Hello, allocator world", lept_get_string(&v), lept_get_string_length(&v));
+    EXPECT_EQ_SIZE_T(1, st.live);
+    lept_free_ex(&v, &a);
+
+    /* partially built trees are released through the allocator as well */
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_parse_ex(&v, "{\"a\":[\"x\",{\"b\":\"y\"}]", &a));
+    EXPECT_EQ_SIZE_T(0, st.live);
+
+    /* so does the SAX parse stack, which holds decoded strings */
+    memset(&no_events, 0, sizeof(no_events));
+    mallocs = st.mallocs;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_sax_ex("[\"a\",{\"b\":\"c\"}]", 15, &no_events, NULL, &a));
+    EXPECT_TRUE(st.mallocs > mallocs);
+    EXPECT_EQ_SIZE_T(0, st.live);
+
+    /* and the chunk buffer of streamed output */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "[\"a string too long to store inline\",{\"k\":[1,2]}]", &a));
+    k.len = k.chunks = k.bad_chunks = 0;
+    k.chunk_size = 8;
+    k.limit = sizeof(k.buf);
+    mallocs = st.mallocs;
+    EXPECT_EQ_INT(0, lept_stringify_to_ex(&v, sink_write, &k, 8, &a));
+    EXPECT_TRUE(k.len == 49 && memcmp(k.buf, "[\"a string too long to store inline\",{\"k\":[1,2]}]", 49) == 0);
+    EXPECT_EQ_SIZE_T(mallocs + 1, st.mallocs);
+    if ((fp = tmpfile()) != NULL) {
+        EXPECT_EQ_INT(0, lept_stringify_file_ex(&v, fp, &a));
+        EXPECT_EQ_SIZE_T(mallocs + 2, st.mallocs);
+        fclose(fp);
+    }
+    mallocs = st.mallocs;
+    EXPECT_EQ_INT(0, test_stringify_pipe(&v, &a, &k));
+    EXPECT_TRUE(k.len == 49 && memcmp(k.buf, "[\"a string too long to store inline\",{\"k\":[1,2]}]", 49) == 0);
+    EXPECT_EQ_SIZE_T(mallocs + 1, st.mallocs);
+    lept_free_ex(&v, &a);
+    EXPECT_EQ_SIZE_T(0, st.live);
+
+    /* documents take their blocks from the allocator */
+    lept_document_init_ex(&d, &a);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_document_parse(&d, "[\"a\",\"b\",[\"c\"]]"));
+    EXPECT_TRUE(st.live > 0);
+    lept_document_free(&d);
+    EXPECT_EQ_SIZE_T(0, st.live);
+    EXPECT_EQ_INT(0, st.foreign);
+    EXPECT_EQ_SIZE_T(st.mallocs, st.frees);
+
+    /* a larger document: every allocation seen by the counter is returned to it */
+    json = (char*)malloc(1000 * 16 + 3);
+    length = 0;
+    json[length++] = '[';
+    for (i = 0; i < 1000; i++)
+        length += sprintf(json + length, "%s{\"k%d\":\"v\"}", i ? "," : "", (int)(i % 100));
+    json[length++] = ']';
+    json[length] = '\0';
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, json, &a));
+    EXPECT_EQ_SIZE_T(1000 + 1, st.live);
+    lept_free_ex(&v, &a);
+    free(json);
+    EXPECT_EQ_SIZE_T(0, st.live);
+    EXPECT_EQ_INT(0, st.foreign);
+}
+
+#if LEPT_STATS
+static void test_stats() {
+    static const char json[] = "{\"a\":[1,\"x\\ny\",null,true],\"b\":{\"c\":[[false]]},\"long key with escape\\t\":\"\\u00e9\"}";
+    lept_stats st;
+    lept_value v;
+    char* out;
+    size_t length;
+    memset(&st, 0, sizeof(st));
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_stats(&v, json, &st));
+    EXPECT_EQ_SIZE_T(sizeof(json) - 1, st.bytes_in);
+    EXPECT_EQ_SIZE_T(1, st.nodes[LEPT_NULL]);
+    EXPECT_EQ_SIZE_T(1, st.nodes[LEPT_FALSE]);
+    EXPECT_EQ_SIZE_T(1, st.nodes[LEPT_TRUE]);
+    EXPECT_EQ_SIZE_T(1, st.nodes[LEPT_NUMBER]);
+    EXPECT_EQ_SIZE_T(2, st.nodes[LEPT_STRING]);
+    EXPECT_EQ_SIZE_T(3, st.nodes[LEPT_ARRAY]);
+    EXPECT_EQ_SIZE_T(2, st.nodes[LEPT_OBJECT]);
+    EXPECT_EQ_SIZE_T(4, st.max_depth);
+    EXPECT_EQ_SIZE_T(3, st.escapes_in);
+    EXPECT_TRUE(st.mallocs > 0 && st.malloc_bytes > 0 && st.stack_reallocs > 0 && st.stack_peak > 0);
+    EXPECT_TRUE(st.parse_seconds >= 0.0);
+
+    out = lept_stringify_stats(&v, &length, &st);
+    EXPECT_EQ_SIZE_T(length, st.bytes_out);
+    EXPECT_EQ_SIZE_T(2, st.escapes_out); /* "\u00e9" comes out as UTF-8 */
+    free(out);
+    lept_free(&v);
+
+    /* counters add up over calls; the maximum stays a maximum */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_stats(&v, "[[1]]", &st));
+    EXPECT_EQ_SIZE_T(2, st.nodes[LEPT_NUMBER]);
+    EXPECT_EQ_SIZE_T(4, st.max_depth);
+    lept_free(&v);
+}
+#endif
+
+static void test_parser() {
+    counting_stats st;
+    lept_allocator a;
+    lept_parser p;
+    lept_value v;
+    char* json;
+    size_t i, length, reallocs, size;
+
+    memset(&st, 0, sizeof(st));
+    a.malloc_fn = counting_malloc;
+    a.realloc_fn = counting_realloc;
+    a.free_fn = counting_free;
+    a.user = &st;
+
+    json = (char*)malloc(10000 * 2 + 3);
+    length = 0;
+    json[length++] = '[';
+    for (i = 0; i < 10000; i++) {
+        if (i > 0)
+            json[length++] = ',';
+        json[length++] = '0' + (char)(i % 10);
+    }
+    json[length++] = ']';
+    json[length] = '\0';
+
+    lept_parser_init(&p, &a);
+    p.trim_interval = 4;
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v, json));
+    EXPECT_EQ_SIZE_T(10000, lept_get_array_size(&v));
+    lept_free_ex(&v, &a);
+    reallocs = st.reallocs;
+    size = p.size;
+    EXPECT_TRUE(size >= 10000 * sizeof(lept_value));
+
+    /* steady state: the stack is reused, no scratch allocation at all */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v, json));
+    EXPECT_EQ_SIZE_T(10000, lept_get_array_size(&v));
+    lept_free_ex(&v, &a);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v, "[\"abc\",{\"k\":1}]"));
+    EXPECT_EQ_STRING("abc", lept_get_string(lept_get_array_element(&v, 0)), lept_get_string_length(lept_get_array_element(&v, 0)));
+    lept_free_ex(&v, &a);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parser_parse(&p, &v, "[\"abc\",nul]"));
+    EXPECT_EQ_SIZE_T(reallocs, st.reallocs);
+    EXPECT_EQ_SIZE_T(size, p.size);
+
+    /* a full window of small documents trims the stack back down */
+    for (i = 0; i < 4; i++) {
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v, "[\"abc\",{\"k\":1}]"));
+        lept_free_ex(&v, &a);
+    }
+    EXPECT_TRUE(p.size < size);
+    EXPECT_TRUE(p.size > 0);
+    for (i = 0; i < 4; i++)
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v, "null"));
+    EXPECT_EQ_SIZE_T(0, p.size);
+
+    lept_parser_free(&p);
+    free(json);
+    EXPECT_EQ_SIZE_T(0, st.live);
+}
+
+static void counting_lock(void* user) {
+    int* held = (int*)user;
+    EXPECT_EQ_INT(0, held[0]);
+    held[0] = 1;
+    held[1]++;
+}
+
+static void counting_unlock(void* user) {
+    int* held = (int*)user;
+    EXPECT_EQ_INT(1, held[0]);
+    held[0] = 0;
+}
+
+static void test_intern_pool() {
+    static const char json[] = "[{\"identifier\":1,\"description\":\"x\",\"id\":2},{\"description\":3,\"identifier\":4}]";
+    counting_stats st;
+    lept_allocator a;
+    lept_intern_pool* pool;
+    lept_parser p;
+    lept_lock lock;
+    lept_value v1, v2;
+    const lept_value* o1, *o2;
+    const char* first[200];
+    char key[16];
+    size_t live;
+    int held[2] = { 0, 0 }, i;
+
+    memset(&st, 0, sizeof(st));
+    a.malloc_fn = counting_malloc;
+    a.realloc_fn = counting_realloc;
+    a.free_fn = counting_free;
+    a.user = &st;
+    lock.lock_fn = counting_lock;
+    lock.unlock_fn = counting_unlock;
+    lock.user = held;
+
+    pool = lept_intern_pool_new(3, &lock, &a);
+    lept_parser_init(&p, &a);
+    p.intern = pool;
+    lept_init(&v1);
+    lept_init(&v2);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v1, json));
+    EXPECT_EQ_SIZE_T(3, lept_intern_pool_size(pool));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(&p, &v2, json));
+    EXPECT_EQ_SIZE_T(3, lept_intern_pool_size(pool));
+    EXPECT_EQ_INT(5 * 2 + 2, held[1]);
+
+    /* equal keys share one buffer, across objects and across trees */
+    o1 = lept_get_array_element(&v1, 0);
+    o2 = lept_get_array_element(&v2, 1);
+    EXPECT_TRUE(lept_get_object_key(o1, 0) == lept_get_object_key(o2, 1));
+    EXPECT_TRUE(lept_get_object_key(o1, 1) == lept_get_object_key(o2, 0));
+    EXPECT_TRUE(lept_get_object_key(o1, 0) == lept_intern(pool, "identifier", 10));
+    EXPECT_EQ_SIZE_T(10, lept_get_object_key_length(o1, 0));
+    EXPECT_EQ_SIZE_T(1, lept_find_object_index(o2, "identifier", 10));
+
+    /* the full pool returns NULL for new keys; trees free none of the pooled keys */
+    EXPECT_TRUE(lept_intern(pool, "another key", 11) == NULL);
+    live = st.live;
+    lept_free_ex(&v1, &a);
+    lept_free_ex(&v2, &a);
+    EXPECT_TRUE(st.live < live);
+    EXPECT_EQ_STRING("identifier", lept_intern(pool, "identifier", 10), 10);
+    lept_parser_free(&p);
+    lept_intern_pool_free(pool);
+    EXPECT_EQ_SIZE_T(0, st.live);
+    EXPECT_EQ_INT(0, held[0]);
+
+    /* growing the table keeps every key; no lock needed for a single thread */
+    pool = lept_intern_pool_new((size_t)-1, NULL, NULL);
+    for (i = 0; i < 200; i++) {
+        sprintf(key, "key%d", i);
+        first[i] = lept_intern(pool, key, strlen(key));
+    }
+    for (i = 0; i < 200; i++) {
+        sprintf(key, "key%d", i);
+        EXPECT_TRUE(first[i] == lept_intern(pool, key, strlen(key)));
+    }
+    EXPECT_EQ_SIZE_T(200, lept_intern_pool_size(pool));
+    lept_intern_pool_free(pool);
+}
+
+/* Walks the cursor with next() and the tree by index side by side. */
+static int test_tape_equal(const lept_cursor* c, const lept_value* v) {
+    lept_cursor e;
+    const char* s;
+    size_t i, n, len;
+    if (lept_cursor_type(c) != lept_get_type(v))
+        return 0;
+    switch (lept_get_type(v)) {
+        case LEPT_TRUE:
+        case LEPT_FALSE:  return lept_cursor_get_boolean(c) == lept_get_boolean(v);
+        case LEPT_NUMBER: return lept_cursor_get_number(c) == lept_get_number(v);
+        case LEPT_STRING:
+            s = lept_cursor_get_string(c, &len);
+            return len == lept_get_string_length(v) && memcmp(s, lept_get_string(v), len) == 0 && s[len] == '\0';
+        case LEPT_ARRAY:
+        case LEPT_OBJECT:
+            n = lept_get_type(v) == LEPT_ARRAY ? lept_get_array_size(v) : lept_get_object_size(v);
+            if (lept_cursor_size(c) != n)
+                return 0;
+            e = *c;
+            if (lept_cursor_down(&e) != (n > 0))
+                return 0;
+            for (i = 0; i < n; i++) {
+                if (i > 0 && !lept_cursor_next(&e))
+                    return 0;
+                if (lept_get_type(v) == LEPT_ARRAY) {
+                    if (lept_cursor_get_key(&e, NULL) != NULL || !test_tape_equal(&e, lept_get_array_element(v, i)))
+                        return 0;
+                }
+                else {
+                    s = lept_cursor_get_key(&e, &len);
+                    if (s == NULL || len != lept_get_object_key_length(v, i) || memcmp(s, lept_get_object_key(v, i), len) != 0
+                        || !test_tape_equal(&e, lept_get_object_value(v, i)))
+                        return 0;
+                }
+            }
+            return n == 0 || !lept_cursor_next(&e);
+        default:          return 1;
+    }
+}
+
+static void test_tape() {
+    static const char* const docs[] = {
+        "null", "true", " -1.5e3 ", "\"hello\\u0000\\n\\uD834\\uDD1E\"", "[]", "{}",
+        "[null,false,true,123,\"abc\",[1,2,3]]",
+        "{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}",
+        "[[[[]]],{\"\":{\"\":[]}},\"\",0]"
+    };
+    static const char json[] = "{\"a\":[1,[2,[3]],{\"x\":4}],\"b\":\"text\",\"\":true}";
+    counting_stats st;
+    lept_allocator a;
+    lept_tape* t;
+    lept_cursor c, e;
+    lept_value v;
+    const char* s;
+    size_t i, len, words, mallocs;
+
+    memset(&st, 0, sizeof(st));
+    a.malloc_fn = counting_malloc;
+    a.realloc_fn = counting_realloc;
+    a.free_fn = counting_free;
+    a.user = &st;
+    t = lept_tape_new(&a);
+    for (i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+        lept_init(&v);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, docs[i]));
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_tape_parse(t, docs[i], strlen(docs[i])));
+        c = lept_tape_root(t);
+        len = 1;
+        EXPECT_TRUE(lept_cursor_get_key(&c, &len) == NULL);
+        EXPECT_EQ_SIZE_T(0, len);
+        EXPECT_TRUE(test_tape_equal(&c, &v));
+        EXPECT_FALSE(lept_cursor_next(&c));
+        lept_free(&v);
+    }
+
+    /* next() steps over whole subtrees; find() matches the full key */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_tape_parse(t, json, sizeof(json) - 1));
+    c = lept_tape_root(t);
+    EXPECT_EQ_SIZE_T(3, lept_cursor_size(&c));
+    e = c;
+    EXPECT_TRUE(lept_cursor_down(&e));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_cursor_type(&e));
+    EXPECT_EQ_SIZE_T(3, lept_cursor_size(&e));
+    EXPECT_TRUE(lept_cursor_next(&e));
+    s = lept_cursor_get_key(&e, &len);
+    EXPECT_EQ_STRING("b", s, len);
+    s = lept_cursor_get_string(&e, &len);
+    EXPECT_EQ_STRING("text", s, len);
+    EXPECT_TRUE(lept_cursor_next(&e));
+    s = lept_cursor_get_key(&e, &len);
+    EXPECT_EQ_STRING("", s, len);
+    EXPECT_TRUE(lept_cursor_get_boolean(&e));
+    EXPECT_FALSE(lept_cursor_next(&e));
+    EXPECT_FALSE(lept_cursor_down(&e));
+    e = c;
+    EXPECT_TRUE(lept_cursor_find(&e, "a", 1));
+    EXPECT_TRUE(lept_cursor_down(&e));
+    EXPECT_TRUE(lept_cursor_get_key(&e, NULL) == NULL);
+    EXPECT_TRUE(lept_cursor_next(&e));
+    EXPECT_TRUE(lept_cursor_next(&e));
+    EXPECT_FALSE(lept_cursor_find(&e, "", 0));
+    EXPECT_TRUE(lept_cursor_find(&e, "x", 1));
+    EXPECT_EQ_DOUBLE(4.0, lept_cursor_get_number(&e));
+    e = c;
+    EXPECT_FALSE(lept_cursor_find(&e, "ab", 2));
+    EXPECT_FALSE(lept_cursor_find(&e, "b\0", 2));
+    EXPECT_TRUE(e.pos == c.pos);
+    EXPECT_TRUE(lept_cursor_find(&e, "", 0));
+    EXPECT_EQ_INT(LEPT_TRUE, lept_cursor_type(&e));
+
+    /* parsing again reuses the buffers; a failed parse leaves the tape empty */
+    words = lept_tape_words(t);
+    mallocs = st.mallocs + st.reallocs;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_tape_parse(t, json, sizeof(json) - 1));
+    EXPECT_EQ_SIZE_T(words, lept_tape_words(t));
+    EXPECT_EQ_SIZE_T(mallocs, st.mallocs + st.reallocs);
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_tape_parse(t, "[1,[2}", 6));
+    EXPECT_EQ_SIZE_T(0, lept_tape_words(t));
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_tape_parse(t, "[] x", 4));
+    EXPECT_EQ_SIZE_T(0, lept_tape_words(t));
+    EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_tape_parse(t, "", 0));
+    lept_tape_free(t);
+    EXPECT_EQ_SIZE_T(0, st.live);
+}
+
+static char* test_object_json(size_t n) {
+    char* json = (char*)malloc(n * 24 + 16);
+    size_t i, length = 0;
+    json[length++] = '{';
+    for (i = 0; i < n; i++)
+        length += sprintf(json + length, "%s\"key%d\":%d", i ? "," : "", (int)i, (int)i);
+    /* a duplicate of the first key: lookups return the first occurrence */
+    length += sprintf(json + length, "%s\"key0\":-1}", n ? "," : "");
+    return json;
+}
+
+static void test_find_object_size(size_t n) {
+    lept_value v;
+    char key[32];
+    char* json = test_object_json(n);
+    size_t i;
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    EXPECT_EQ_SIZE_T(n + 1, lept_get_object_size(&v));
+    for (i = 0; i < n; i++) {
+        sprintf(key, "key%d", (int)i);
+        EXPECT_EQ_SIZE_T(i, lept_find_object_index(&v, key, strlen(key)));
+        EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_find_object_value(&v, key, strlen(key))));
+    }
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&v, "key", 3));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&v, "key00", 5));
+    EXPECT_TRUE(lept_find_object_value(&v, "", 0) == NULL);
+    lept_free(&v);
+    free(json);
+}
+
+/* Parses with an allocator struct that is gone once this returns. */
+static void test_parse_with_local_allocator(lept_value* v, const char* json, counting_stats* st) {
+    lept_allocator a;
+    a.malloc_fn = counting_malloc;
+    a.realloc_fn = counting_realloc;
+    a.free_fn = counting_free;
+    a.user = st;
+    lept_init(v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(v, json, &a));
+}
+
+static void test_find_object() {
+    counting_stats st;
+    lept_allocator a;
+    lept_document d, moved;
+    lept_value v;
+    char* json;
+
+    test_find_object_size(0);
+    test_find_object_size(5);
+    test_find_object_size(31);
+    test_find_object_size(32);
+    test_find_object_size(1000);
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\":1,\"a\\u0000b\":2,\"\":3}"));
+    EXPECT_EQ_SIZE_T(1, lept_find_object_index(&v, "a\0b", 3));
+    EXPECT_EQ_SIZE_T(2, lept_find_object_index(&v, "", 0));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&v, "a\0", 2));
+    lept_free(&v);
+
+    /* the index comes from the allocator and is released with the object */
+    memset(&st, 0, sizeof(st));
+    a.malloc_fn = counting_malloc;
+    a.realloc_fn = counting_realloc;
+    a.free_fn = counting_free;
+    a.user = &st;
+    json = test_object_json(100);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, json, &a));
+    EXPECT_EQ_SIZE_T(1, st.live); /* the keys are short enough to be stored inline */
+    EXPECT_EQ_SIZE_T(50, lept_find_object_index(&v, "key50", 5));
+    EXPECT_EQ_SIZE_T(1 + 1, st.live);
+    EXPECT_EQ_SIZE_T(51, lept_find_object_index(&v, "key51", 5));
+    EXPECT_EQ_SIZE_T(1 + 1, st.live);
+    lept_free_ex(&v, &a);
+    EXPECT_EQ_SIZE_T(0, st.live);
+
+    /* the allocator struct may go out of scope before the index is built */
+    test_parse_with_local_allocator(&v, json, &st);
+    EXPECT_EQ_SIZE_T(1, st.live);
+    EXPECT_EQ_SIZE_T(50, lept_find_object_index(&v, "key50", 5));
+    EXPECT_EQ_SIZE_T(1 + 1, st.live);
+    lept_free_ex(&v, &a);
+    EXPECT_EQ_SIZE_T(0, st.live);
+    EXPECT_EQ_INT(0, st.foreign);
+
+    /* inside a document the index lives in the arena, even after the document is moved */
+    lept_document_init_ex(&d, &a);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_document_parse(&d, json));
+    moved = d;
+    lept_document_init(&d);
+    EXPECT_EQ_DOUBLE(99.0, lept_get_number(lept_find_object_value(&moved.root, "key99", 5)));
+    EXPECT_EQ_DOUBLE(0.0, lept_get_number(lept_find_object_value(&moved.root, "key0", 4)));
+    EXPECT_TRUE(d.arena == NULL);
+    lept_document_free(&moved);
+    EXPECT_EQ_SIZE_T(0, st.live);
+    EXPECT_EQ_INT(0, st.foreign);
+    free(json);
+}
+
+static void test_parse_insitu() {
+    counting_stats st;
+    lept_allocator a;
+    lept_value v;
+    const lept_value* e;
+    char json[] = "{ \"a\\tb\" : [ \"Hello\", \"\\u20AC\\uD834\\uDD1E\\n\", \"\" ] , \"k\" : { \"x\" : \"y\\u0000z\" } }";
+    char bad[] = "{\"a\":[\"b\",{\"c\":\"d\\q\"}]}";
+    char* out;
+    size_t length;
+
+    memset(&st, 0, sizeof(st));
+    a.malloc_fn = counting_malloc;
+    a.realloc_fn = counting_realloc;
+    a.free_fn = counting_free;
+    a.user = &st;
+
+    /* stack, 1 element table, 2 member tables: no string or key is allocated */
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_insitu_ex(&v, json, &a));
+    EXPECT_EQ_SIZE_T(4, st.mallocs);
+    EXPECT_EQ_SIZE_T(2, lept_get_object_size(&v));
+    EXPECT_EQ_STRING("a\tb", lept_get_object_key(&v, 0), lept_get_object_key_length(&v, 0));
+    EXPECT_TRUE(lept_get_object_key(&v, 0) > json && lept_get_object_key(&v, 0) < json + sizeof(json));
+    e = lept_get_object_value(&v, 0);
+    EXPECT_EQ_SIZE_T(3, lept_get_array_size(e));
+    EXPECT_EQ_STRING("Hello", lept_get_string(lept_get_array_element(e, 0)), lept_get_string_length(lept_get_array_element(e, 0)));
+    EXPECT_EQ_STRING("\xE2\x82\xAC\xF0\x9D\x84\x9E\n", lept_get_string(lept_get_array_element(e, 1)), lept_get_string_length(lept_get_array_element(e, 1)));
+    EXPECT_EQ_STRING("", lept_get_string(lept_get_array_element(e, 2)), lept_get_string_length(lept_get_array_element(e, 2)));
+    EXPECT_TRUE(lept_get_string(lept_get_array_element(e, 0)) > json && lept_get_string(lept_get_array_element(e, 0)) < json + sizeof(json));
+    e = lept_get_object_value(lept_get_object_value(&v, 1), 0);
+    EXPECT_EQ_STRING("y\0z", lept_get_string(e), lept_get_string_length(e));
+    out = lept_stringify(&v, &length);
+    EXPECT_EQ_STRING("{\"a\\tb\":[\"Hello\",\"\xE2\x82\xAC\xF0\x9D\x84\x9E\\n\",\"\"],\"k\":{\"x\":\"y\\u0000z\"}}", out, length);
+    free(out);
+
+    /* a string set later is owned again */
+    lept_set_string_ex(lept_get_array_element(lept_get_object_value(&v, 0), 0), "owned", 5, &a);
+    lept_free_ex(&v, &a);
+    EXPECT_EQ_SIZE_T(0, st.live);
+
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, lept_parse_insitu_ex(&v, bad, &a));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    EXPECT_EQ_SIZE_T(0, st.live);
+    EXPECT_EQ_INT(0, st.foreign);
+}
+
+static void test_parse_lazy() {
+    static const char* const docs[] = {
+        "null", " true ", "-1.5e-3", "\"a\\\"b\\\\\"", "[]", "{ }",
+        "[ 1 , \"]\" , [ \"[{\\\\\" , { } ] , 2e5 , true ]",
+        "{\"a\\tb\":[\"Hello\",\"\\u20AC\\uD834\\uDD1E\\n\",\"\"],\"k\":{\"x\":\"y\\u0000z\"},\"n\":0,\"\":[[[null]]]}",
+        "[1.7976931348623157e308,-1.7976931348623157e308,0.001e310,1e-400,0e999999]"
+    };
+    static const char* const bad[] = {
+        "", "[1,]", "{\"a\":1,}", "[\"a\\q\"]", "{\"a\" 1}", "[1] x", "[0123]", "[1e309]",
+        "[1.8e308]", "[-10e308]", "[\"\x01\"]"
+    };
+    lept_value v, w;
+    const lept_value* e;
+    char* json;
+    char* out1, *out2;
+    size_t i, len1, len2;
+
+    /* the same tree as lept_parse(), read in any order */
+    for (i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+        lept_init(&v);
+        lept_init(&w);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_lazy(&v, docs[i]));
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&w, docs[i]));
+        EXPECT_EQ_INT(lept_get_type(&w), lept_get_type(&v));
+        out1 = lept_stringify(&v, &len1);
+        out2 = lept_stringify(&w, &len2);
+        EXPECT_TRUE(len1 == len2 && memcmp(out1, out2, len1) == 0);
+        free(out1);
+        free(out2);
+        lept_free(&v);
+        lept_free(&w);
+    }
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        lept_init(&v);
+        lept_init(&w);
+        EXPECT_EQ_INT(lept_parse(&w, bad[i]), lept_parse_lazy(&v, bad[i]));
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    }
+
+    /* only the path read is decoded; freeing a partly decoded tree frees what was */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_lazy(&v, docs[7]));
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&v));
+    e = lept_find_object_value(&v, "k", 1);
+    EXPECT_TRUE(e != NULL);
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(e));
+    e = lept_find_object_value(e, "x", 1);
+    EXPECT_EQ_STRING("y\0z", lept_get_string(e), lept_get_string_length(e));
+    e = lept_get_object_value(&v, 0);
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(e));
+    EXPECT_EQ_STRING("\xE2\x82\xAC\xF0\x9D\x84\x9E\n", lept_get_string(lept_get_array_element(e, 1)), lept_get_string_length(lept_get_array_element(e, 1)));
+    EXPECT_EQ_DOUBLE(0.0, lept_get_number(lept_find_object_value(&v, "n", 1)));
+    lept_set_number(lept_get_array_element(e, 0), 1.0);
+    lept_set_string(lept_find_object_value(&v, "", 0), "text", 4);
+    out1 = lept_stringify(&v, &len1);
+    EXPECT_EQ_STRING("{\"a\\tb\":[1,\"\xE2\x82\xAC\xF0\x9D\x84\x9E\\n\",\"\"],\"k\":{\"x\":\"y\\u0000z\"},\"n\":0,\"\":\"text\"}", out1, len1);
+    free(out1);
+    lept_free(&v);
+
+    /* a large object decodes its members only, then builds its index */
+    json = test_object_json(100);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_lazy(&v, json));
+    EXPECT_EQ_SIZE_T(101, lept_get_object_size(&v));
+    EXPECT_EQ_SIZE_T(57, lept_find_object_index(&v, "key57", 5));
+    EXPECT_EQ_DOUBLE(-1.0, lept_get_number(lept_get_object_value(&v, 100)));
+    lept_free(&v);
+    free(json);
+}
+
+static void test_projection_case(const char* const* paths, size_t count, const char* json, const char* expect) {
+    lept_projection* p = lept_projection_new(paths, count, NULL);
+    lept_value v;
+    char* out;
+    size_t length;
+    EXPECT_TRUE(p != NULL);
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projection(&v, json, p));
+    out = lept_stringify(&v, &length);
+    EXPECT_TRUE(length == strlen(expect) && memcmp(out, expect, length) == 0);
+    free(out);
+    lept_free(&v);
+    lept_projection_free(p);
+}
+
+#define TEST_PROJECTION(expect, json, paths)\
+    test_projection_case(paths, sizeof(paths) / sizeof(paths[0]), json, expect)
+
+#define TEST_PROJECTION_ERROR(error, json, path)\
+    do {\
+        static const char* const paths[] = { path };\
+        lept_projection* p = lept_projection_new(paths, 1, &a);\
+        lept_value v;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(error, lept_parse_projection(&v, json, p));\
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+        lept_projection_free(p);\
+        EXPECT_EQ_SIZE_T(0, st.live);\
+    } while(0)
+
+static void test_parse_projection() {
+    static const char json[] = "{\"user\":{\"id\":7,\"name\":\"x\"},\"items\":[{\"price\":1.5,\"sku\":\"a\"},{},3,{\"price\":2}],\"n\":null}";
+    static const char* const routed[] = { "/user/id", "/items/*/price" };
+    static const char* const indexed[] = { "/items/2", "/items/9" };
+    static const char* const mixed[] = { "/n", "/items/3/price", "/user/id/deeper" };
+    static const char* const nested[] = { "/user/id", "/user" };
+    static const char* const missing[] = { "/missing" };
+    static const char* const deep[] = { "/0/x" };
+    static const char* const whole[] = { "" };
+    static const char* const merged[] = { "/a/*/x", "/a/b/y" };
+    static const char* const escaped[] = { "/a~1b/m~0n", "/" };
+    static const char* const key[] = { "/k" };
+    static const char* const bad[] = { "a", "/a~2", "/~" };
+    counting_stats st;
+    lept_allocator a;
+    lept_projection* p;
+    lept_value v;
+    size_t i;
+
+    TEST_PROJECTION("{\"user\":{\"id\":7},\"items\":[{\"price\":1.5},{},{\"price\":2}]}", json, routed);
+    TEST_PROJECTION("{\"items\":[3]}", json, indexed);
+    TEST_PROJECTION("{\"user\":{},\"items\":[{\"price\":2}],\"n\":null}", json, mixed);
+    TEST_PROJECTION("{\"user\":{\"id\":7,\"name\":\"x\"}}", json, nested);
+    TEST_PROJECTION("{}", json, missing);
+    TEST_PROJECTION("[]", "[1,2]", deep);
+    TEST_PROJECTION("null", " \"text\" ", missing);
+    TEST_PROJECTION("\"text\"", " \"text\" ", whole);
+    test_projection_case(NULL, 0, json, "null");
+
+    /* a wildcard path also applies under its literal siblings */
+    TEST_PROJECTION("{\"a\":{\"b\":{\"x\":1,\"y\":2},\"c\":{\"x\":4}}}",
+        "{\"a\":{\"b\":{\"x\":1,\"y\":2,\"z\":3},\"c\":{\"x\":4,\"y\":5}}}", merged);
+    /* ~1 and ~0 stand for / and ~; keys are compared decoded */
+    TEST_PROJECTION("{\"a/b\":{\"m~n\":1},\"\":[true]}", "{\"a\\/b\":{\"m~n\":1,\"m\":2},\"\":[true]}", escaped);
+    /* whatever is skipped is not decoded, so it may hold bad escapes and numbers */
+    TEST_PROJECTION("{\"k\":1}", "{\"skip\":[\"\\q\\\"]\",01,tru,{\"[\":\"}\"}],\"k\":1, \"z\" : 1e999 }", key);
+
+    memset(&st, 0, sizeof(st));
+    a.malloc_fn = counting_malloc;
+    a.realloc_fn = counting_realloc;
+    a.free_fn = counting_free;
+    a.user = &st;
+    TEST_PROJECTION_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, "{\"k\":{\"a\":1},\"skip\":[\"abc]}", "/k");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "{\"k\":{\"a\":1},\"skip\":[1}", "/k");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"k\":{\"a\":1},\"skip\":{]}", "/k");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"k\":{\"a\":1},\"skip\":{\"a\":[]", "/k");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "{\"k\":{\"a\":1e999}}", "/k");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE, "{\"k\":[\"long enough to be allocated\",\"\\q\"]}", "/k/*");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_MISS_COLON, "{\"k\":{\"a\" 1}}", "/k/a");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_MISS_KEY, "{\"k\":{\"a\":1,}}", "/k/a");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_INVALID_VALUE, "[1,]", "/0");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_EXPECT_VALUE, " ", "/0");
+    TEST_PROJECTION_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "{\"k\":\"a long key value to allocate\"} x", "/k");
+
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        EXPECT_TRUE(lept_projection_new(&bad[i], 1, &a) == NULL);
+    EXPECT_EQ_SIZE_T(0, st.live);
+
+    /* trees come from the projection's allocator */
+    p = lept_projection_new(routed, 2, &a);
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projection(&v, json, p));
+    EXPECT_EQ_SIZE_T(3, lept_get_array_size(lept_find_object_value(&v, "items", 5)));
+    lept_free_ex(&v, &a);
+    lept_projection_free(p);
+    EXPECT_EQ_SIZE_T(0, st.live);
+    EXPECT_EQ_INT(0, st.foreign);
+}
+
+#if LEPT_COMPACT
+/* The packed layout is the point of LEPT_COMPACT: a new field must not quietly undo it. */
+static void test_compact_layout() {
+    if (sizeof(void*) == 8) {
+        EXPECT_EQ_SIZE_T(16, sizeof(lept_value));
+        EXPECT_EQ_SIZE_T(28, sizeof(lept_member));
+    }
+    else
+        EXPECT_TRUE(sizeof(lept_value) <= 16 && sizeof(lept_member) <= 28);
+}
+#endif
+
 int main() {
 #ifdef _WINDOWS
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+#endif
+#if LEPT_COMPACT
+    test_compact_layout();
 #endif
     test_parse();
     test_stringify();
     test_access();
+    test_document();
+    test_allocator();
+    test_parser();
+#if LEPT_STATS
+    test_stats();
+#endif
+    test_intern_pool();
+    test_tape();
+    test_find_object();
+    test_parse_insitu();
+    test_parse_lazy();
+    test_parse_projection();
     printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
     return main_ret;
 }